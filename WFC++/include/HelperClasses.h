@@ -10,6 +10,7 @@
 #include "Helpers/Array2D.hpp"
 #include "Helpers/Array3D.hpp"
 #include "Helpers/Array4D.hpp"
+#include "Helpers/DynamicBitset.hpp"
 #include "Helpers/EnumFlags.h"
 #include "Helpers/xoshiro.hpp"
 
@@ -80,7 +80,7 @@ namespace WFC
             size_t size = (size_t)(GetNumbElements());
 			for (size_t i = 0; i < size; ++i)
 			{
-				WFCPP_ASSERT(i < other.GetNumbElements());
+				WFCPP_ASSERT(i < (size_t)other.GetNumbElements());
 				arrayVals[i] = other.arrayVals[i];
 			}
 
@@ -2,6 +2,7 @@
 
 #include "WFCMath.h"
 #include "Vector3i.h"
+#include "ArrayLayout.h"
 
 #pragma warning(disable: 4018)
 
@@ -15,38 +16,42 @@ namespace WFC
 	//Wraps a contiguous heap-allocated one-dimensional array
 	//    so it can be treated like a three-dimensional array.
 	//The most cache-efficient way to iterate through this array is through
-	//    the Z in the outer loop, Y in the middle loop, and X in the inner loop.
+	//    the Z in the outer loop, Y in the middle loop, and X in the inner loop,
+	//    or with "ForEach()" which also respects the 'Bricked' layout.
 	class Array3D
 	{
 	public:
 
         //Creates an invalid Array3D with 0 elements.
-        Array3D() : width(0), height(0), depth(0), arrayVals(nullptr) { }
+        Array3D() : width(0), height(0), depth(0),
+					layout(ArrayLayouts::RowMajor), nBricksX(0), nBricksXY(0),
+					arrayVals(nullptr) { }
 
 		//Creates a new Array3D without initializing any of the values.
 		Array3D(int aWidth, int aHeight, int aDepth)
+			: Array3D(ArrayLayouts::RowMajor, Vector3i(aWidth, aHeight, aDepth)) { }
+		//Creates a new Array3D without initializing any of the values.
+		Array3D(Vector3i size) : Array3D(ArrayLayouts::RowMajor, size) { }
+		//Creates a new Array3D with the given memory layout, without initializing any of the values.
+		Array3D(ArrayLayouts _layout, Vector3i size)
 		{
-			width = aWidth;
-			height = aHeight;
-            depth = aDepth;
+			width = size.x;
+			height = size.y;
+            depth = size.z;
+			layout = _layout;
+			UpdateBrickCounts();
 
-			arrayVals = new ArrayType[GetNumbElements()];
+			arrayVals = new ArrayType[GetNumbStoredElements()];
 		}
-		//Creates a new Array3D without initializing any of the values.
-		Array3D(Vector3i size) : Array3D(size.x, size.y, size.z) { }
 
 		Array3D(int aWidth, int aHeight, int aDepth, const ArrayType& defaultValue)
+			: Array3D(ArrayLayouts::RowMajor, Vector3i(aWidth, aHeight, aDepth), defaultValue) { }
+		Array3D(Vector3i size, const ArrayType& defaultValue) : Array3D(ArrayLayouts::RowMajor, size, defaultValue) { }
+		Array3D(ArrayLayouts _layout, Vector3i size, const ArrayType& defaultValue)
+			: Array3D(_layout, size)
 		{
-			width = aWidth;
-			height = aHeight;
-            depth = aDepth;
-
-			arrayVals = new ArrayType[GetNumbElements()];
-
-			for (int i = 0; i < GetNumbElements(); ++i)
-				arrayVals[i] = defaultValue;
+			Fill(defaultValue);
 		}
-		Array3D(Vector3i size, const ArrayType& defaultValue) : Array3D(size.x, size.y, size.z, defaultValue) { }
 
 		//Move operator.
 		Array3D(Array3D&& toMove) noexcept : arrayVals(nullptr) { *this = std::move(toMove); }
@@ -61,11 +66,16 @@ namespace WFC
 			width = toMove.width;
 			height = toMove.height;
             depth = toMove.depth;
+			layout = toMove.layout;
+			nBricksX = toMove.nBricksX;
+			nBricksXY = toMove.nBricksXY;
 			arrayVals = toMove.arrayVals;
 
 			toMove.width = 0;
 			toMove.height = 0;
             toMove.depth = 0;
+			toMove.nBricksX = 0;
+			toMove.nBricksXY = 0;
 			toMove.arrayVals = nullptr;
 
 			return *this;
@@ -84,11 +94,14 @@ namespace WFC
             width = other.width;
             height = other.height;
             depth = other.depth;
-            arrayVals = new ArrayType[GetNumbElements()];
+			layout = other.layout;
+			nBricksX = other.nBricksX;
+			nBricksXY = other.nBricksXY;
+            arrayVals = new ArrayType[GetNumbStoredElements()];
 
-            for (size_t i = 0; i < (size_t)GetNumbElements(); ++i)
+            for (size_t i = 0; i < (size_t)GetNumbStoredElements(); ++i)
 			{
-				WFCPP_ASSERT(i < other.GetNumbElements());
+				WFCPP_ASSERT(i < other.GetNumbStoredElements());
 				arrayVals[i] = other.arrayVals[i];
 			}
 
@@ -125,25 +138,30 @@ namespace WFC
 		//Gets the size of this array along each axis.
 		Vector3i GetDimensions() const { return Vector3i(width, height, depth); }
 		bool IsIndexValid(const Vector3i& idx) const { return Region3i(GetDimensions()).Contains(idx); }
+		//Gets the way this array's elements are arranged in memory.
+		ArrayLayouts GetLayout() const { return layout; }
 
 
 		//Resets this array to the given size and leaves its elements uninitialized.
 		//If the total number of elements doesn't change, then nothing is allocated or un-allocated
 		//    and the elements keep their values.
+		//The memory layout is unchanged.
 		void Reset(int _width, int _height, int _depth)
 		{
+			int oldNStoredElements = GetNumbStoredElements();
+			width = _width;
+			height = _height;
+            depth = _depth;
+			UpdateBrickCounts();
+
 			//Only resize if the current array does not have the same number of elements.
-			if (GetNumbElements() != (_width * _height * _depth))
+			if (oldNStoredElements != GetNumbStoredElements())
 			{
 				if (arrayVals != nullptr)
 				    delete[] arrayVals;
 
-				arrayVals = new ArrayType[_width * _height * _depth];
+				arrayVals = new ArrayType[GetNumbStoredElements()];
 			}
-
-			width = _width;
-			height = _height;
-            depth = _depth;
 		}
 		//Resets this array to the given size and initializes all elements to the given value.
 		void Reset(int _width, int _height, int _depth, const ArrayType& newValues)
@@ -156,11 +174,27 @@ namespace WFC
 		//Gets the array index for the given position.
 		int GetIndex(int x, int y, int z) const
 		{
+			if (layout == ArrayLayouts::Bricked)
+				return Bricks::GetIndex(x, y, z, nBricksX, nBricksXY);
 			return x + (y * width) + (z * width * height);
 		}
 		//Gets the location in this array that corresponds to the given array index.
+		//For the 'Bricked' layout, the index of a padding element gives a location outside the array.
 		Vector3i GetLocation(int index) const
 		{
+			if (layout == ArrayLayouts::Bricked)
+			{
+				int brickI = index / Bricks::NElements,
+					innerI = index % Bricks::NElements;
+				Vector3i brickPos(brickI % nBricksX,
+								  (brickI % nBricksXY) / nBricksX,
+								  brickI / nBricksXY);
+				return (brickPos * Bricks::Size) +
+					   Vector3i(innerI & Bricks::Mask,
+								(innerI >> Bricks::SizeLog2) & Bricks::Mask,
+								innerI >> (Bricks::SizeLog2 * 2));
+			}
+
 			return Vector3i(index % width,
                             (index / width) % height,
                             index / (width * height));
@@ -179,23 +213,31 @@ namespace WFC
 
 		//Gets the total number of elements contained by this array.
 		int GetNumbElements() const { return width * height * depth; }
+		//Gets the number of elements actually allocated for this array.
+		//For the 'Bricked' layout this includes padding, to fill out the bricks on the edges.
+		int GetNumbStoredElements() const
+		{
+			if (layout == ArrayLayouts::Bricked)
+				return nBricksXY * Bricks::GetCount(depth) * Bricks::NElements;
+			return GetNumbElements();
+		}
 
 
 		//Fills every element with the given value.
 		void Fill(const ArrayType& value)
 		{
-			for (int i = 0; i < GetNumbElements(); ++i)
+			for (int i = 0; i < GetNumbStoredElements(); ++i)
 				arrayVals[i] = value;
 		}
 		//Copies the given elements to this array.
-		//Assumes that the size of this array matches with the given one.
+		//Assumes that the given elements are in this array's storage order (see "GetArray()").
 		//If "useMemcpy" is true, the whole thing will be copied at once with memcpy().
 		//Otherwise, each element will be set using its assignment operator.
 		void Fill(const ArrayType* values, bool useMemcpy)
 		{
 			if (useMemcpy)
-				memcpy(arrayVals, values, GetNumbElements() * sizeof(ArrayType));
-			else for (int i = 0; i < GetNumbElements(); ++i)
+				memcpy(arrayVals, values, GetNumbStoredElements() * sizeof(ArrayType));
+			else for (int i = 0; i < GetNumbStoredElements(); ++i)
 				arrayVals[i] = values[i];
 		}
 
@@ -204,38 +246,95 @@ namespace WFC
 		//Fills every element using the given function.
 		void FillFunc(Func getValue)
 		{
-			Vector3i loc;
-            for (loc.z = 0; loc.z < depth; ++loc.z)
-                for (loc.y = 0; loc.y < height; ++loc.y)
-				    for (loc.x = 0; loc.x < width; ++loc.x)
-					    getValue(loc, &arrayVals[GetIndex(loc.x, loc.y, loc.z)]);
+			ForEach([&](const Vector3i& loc, ArrayType& value) { getValue(loc, &value); });
+		}
+
+		//A function with signature "void Visit(const Vector3i& index, ArrayType& value)".
+		template<typename Func>
+		//Visits every element in the order they're stored in memory,
+		//    which is the most cache-efficient order for either layout.
+		void ForEach(Func visit)
+		{
+			ForEachIndex([&](const Vector3i& loc, int i) { visit(loc, arrayVals[i]); });
+		}
+		//A function with signature "void Visit(const Vector3i& index, const ArrayType& value)".
+		template<typename Func>
+		//Visits every element in the order they're stored in memory,
+		//    which is the most cache-efficient order for either layout.
+		void ForEach(Func visit) const
+		{
+			ForEachIndex([&](const Vector3i& loc, int i) { visit(loc, (const ArrayType&)arrayVals[i]); });
 		}
 
 		//Copies this array into the given one using "memcpy", which is as fast as possible.
-		//Assumes the given array is the same size as this one.
+		//Assumes the given array has the same size and layout as this one.
 		void MemCopyInto(ArrayType* outValues) const
 		{
-			memcpy(outValues, arrayVals, GetNumbElements() * sizeof(ArrayType));
+			memcpy(outValues, arrayVals, GetNumbStoredElements() * sizeof(ArrayType));
 		}
 		//Copies this array into the given one using the assignment operator for each value.
-		//Assumes it is the same size as this array.
+		//Assumes it has the same size and layout as this array.
 		//Use this instead of "MemCopyInto" if the items are too complex to just copy their byte-data over.
 		void CopyInto(ArrayType* outValues) const
 		{
-			for (int i = 0; i < GetNumbElements(); ++i)
+			for (int i = 0; i < GetNumbStoredElements(); ++i)
 				outValues[i] = arrayVals[i];
 		}
 
 		//Gets a pointer to the first element in this array.
+		//There are "GetNumbStoredElements()" elements, ordered by "GetIndex()".
 		const ArrayType* GetArray() const { return arrayVals; }
 		//Gets a pointer to the first element in this array.
+		//There are "GetNumbStoredElements()" elements, ordered by "GetIndex()".
 		ArrayType* GetArray() { return arrayVals; }
     
 
 	private:
 
 		int width, height, depth;
+		ArrayLayouts layout;
+		int nBricksX, nBricksXY;
 		ArrayType* arrayVals;
+
+		void UpdateBrickCounts()
+		{
+			nBricksX = Bricks::GetCount(width);
+			nBricksXY = nBricksX * Bricks::GetCount(height);
+		}
+
+		//Calls "visit(Vector3i location, int arrayIndex)" for every element, in storage order.
+		//Padding elements are skipped.
+		template<typename Func>
+		void ForEachIndex(Func visit) const
+		{
+			Vector3i loc;
+			if (layout == ArrayLayouts::Bricked)
+			{
+				Vector3i brickMin;
+				int i = 0;
+				for (brickMin.z = 0; brickMin.z < depth; brickMin.z += Bricks::Size)
+					for (brickMin.y = 0; brickMin.y < height; brickMin.y += Bricks::Size)
+						for (brickMin.x = 0; brickMin.x < width; brickMin.x += Bricks::Size)
+						{
+							for (loc.z = brickMin.z; loc.z < brickMin.z + Bricks::Size; ++loc.z)
+								for (loc.y = brickMin.y; loc.y < brickMin.y + Bricks::Size; ++loc.y)
+									for (loc.x = brickMin.x; loc.x < brickMin.x + Bricks::Size; ++loc.x)
+									{
+										if (loc.x < width && loc.y < height && loc.z < depth)
+											visit(loc, i);
+										i += 1;
+									}
+						}
+			}
+			else
+			{
+				int i = 0;
+				for (loc.z = 0; loc.z < depth; ++loc.z)
+					for (loc.y = 0; loc.y < height; ++loc.y)
+						for (loc.x = 0; loc.x < width; ++loc.x)
+							visit(loc, i++);
+			}
+		}
 	};
 }
 
@@ -2,6 +2,7 @@
 
 #include "WFCMath.h"
 #include "Vector4i.h"
+#include "ArrayLayout.h"
 
 #pragma warning(disable: 4018)
 
@@ -15,22 +16,35 @@ namespace WFC
 	//Wraps a contiguous heap-allocated one-dimensional array
 	//    so it can be treated like a four-dimensional array.
 	//The most cache-efficient way to iterate through this array is through
-	//    the W in the outer loop, and the X in the inner loop.
+	//    the W in the outer loop, and the X in the inner loop,
+	//    or with "ForEach()" which also respects the 'Bricked' layout.
+	//
+	//In the 'Bricked' layout, only the Y, Z, and W axes are split into bricks;
+	//    all X values for a given YZW stay contiguous.
 	class Array4D
 	{
 	public:
 
         //Creates an invalid Array4D with 0 elements.
-        Array4D() : size(0, 0, 0, 0), arrayVals(nullptr) { }
+        Array4D() : size(0, 0, 0, 0), layout(ArrayLayouts::RowMajor), nBricksY(0), nBricksYZ(0), arrayVals(nullptr) { }
 
 		//Creates a new Array4D without initializing any of the values.
-		Array4D(const Vector4i& size) : size(size), arrayVals(new ArrayType[(size_t)size.x * size.y * size.z * size.w]) { }
+		Array4D(const Vector4i& size) : Array4D(ArrayLayouts::RowMajor, size) { }
+		//Creates a new Array4D with the given memory layout, without initializing any of the values.
+		Array4D(ArrayLayouts layout, const Vector4i& size)
+			: size(size), layout(layout)
+		{
+			UpdateBrickCounts();
+			arrayVals = new ArrayType[GetNumbStoredElements()];
+		}
 		//Creates a new Array4D and fills it with copies of the given element.
 		Array4D(const Vector4i& size, const ArrayType& defaultValue)
-			: Array4D(size)
+			: Array4D(ArrayLayouts::RowMajor, size, defaultValue) { }
+		//Creates a new Array4D with the given memory layout, and fills it with copies of the given element.
+		Array4D(ArrayLayouts layout, const Vector4i& size, const ArrayType& defaultValue)
+			: Array4D(layout, size)
 		{
-			for (int i = 0; i < GetNumbElements(); ++i)
-				arrayVals[i] = defaultValue;
+			Fill(defaultValue);
 		}
 
 		//Move operator.
@@ -44,9 +58,14 @@ namespace WFC
 				delete[] arrayVals;
 
 			size = toMove.size;
+			layout = toMove.layout;
+			nBricksY = toMove.nBricksY;
+			nBricksYZ = toMove.nBricksYZ;
 			arrayVals = toMove.arrayVals;
 
 			toMove.size = Vector4i{};
+			toMove.nBricksY = 0;
+			toMove.nBricksYZ = 0;
 			toMove.arrayVals = nullptr;
 
 			return *this;
@@ -63,11 +82,14 @@ namespace WFC
                 delete[] arrayVals;
 
 			size = other.size;
-            arrayVals = new ArrayType[GetNumbElements()];
+			layout = other.layout;
+			nBricksY = other.nBricksY;
+			nBricksYZ = other.nBricksYZ;
+            arrayVals = new ArrayType[GetNumbStoredElements()];
 
-            for (size_t i = 0; i < (size_t)GetNumbElements(); ++i)
+            for (size_t i = 0; i < (size_t)GetNumbStoredElements(); ++i)
 			{
-				WFCPP_ASSERT(i < other.GetNumbElements());
+				WFCPP_ASSERT(i < other.GetNumbStoredElements());
 				arrayVals[i] = other.arrayVals[i];
 			}
 
@@ -97,23 +119,28 @@ namespace WFC
 
 		//Gets the size of this array along each axis.
 		Vector4i GetDimensions() const { return size; }
+		//Gets the way this array's elements are arranged in memory.
+		ArrayLayouts GetLayout() const { return layout; }
 
 
 		//Resets this array to the given size and leaves its elements uninitialized.
 		//If the total number of elements doesn't change, then nothing is allocated or un-allocated
 		//    and the elements keep their values.
+		//The memory layout is unchanged.
 		void Reset(const Vector4i& newSize)
 		{
+			int oldNStoredElements = GetNumbStoredElements();
+			size = newSize;
+			UpdateBrickCounts();
+
 			//Only resize if the current array does not have the same number of elements.
-			if (GetNumbElements() != (newSize.x * newSize.y * newSize.z * newSize.w))
+			if (oldNStoredElements != GetNumbStoredElements())
 			{
 				if (arrayVals != nullptr)
 				    delete[] arrayVals;
 
-				arrayVals = new ArrayType[newSize.x * newSize.y * newSize.z * newSize.w];
+				arrayVals = new ArrayType[GetNumbStoredElements()];
 			}
-
-			size = newSize;
 		}
 		//Resets this array to the given size and initializes all elements to the given value.
 		void Reset(const Vector4i& size, const ArrayType& newValues)
@@ -126,11 +153,29 @@ namespace WFC
 		//Gets the array index for the given position.
 		int GetIndex(int x, int y, int z, int w) const
 		{
+			if (layout == ArrayLayouts::Bricked)
+				return x + (size.x * Bricks::GetIndex(y, z, w, nBricksY, nBricksYZ));
 			return x + (y * size.x) + (z * size.x * size.y) + (w * size.x * size.y * size.z);
 		}
 		//Gets the location in this array that corresponds to the given array index.
+		//For the 'Bricked' layout, the index of a padding element gives a location outside the array.
 		Vector4i GetLocation(int index) const
 		{
+			if (layout == ArrayLayouts::Bricked)
+			{
+				int yzwIndex = index / size.x,
+					brickI = yzwIndex / Bricks::NElements,
+					innerI = yzwIndex % Bricks::NElements;
+				Vector3i brickPos(brickI % nBricksY,
+								  (brickI % nBricksYZ) / nBricksY,
+								  brickI / nBricksYZ);
+				Vector3i yzw = (brickPos * Bricks::Size) +
+							   Vector3i(innerI & Bricks::Mask,
+										(innerI >> Bricks::SizeLog2) & Bricks::Mask,
+										innerI >> (Bricks::SizeLog2 * 2));
+				return Vector4i(index % size.x, yzw.x, yzw.y, yzw.z);
+			}
+
 			return Vector4i(index % size.x,
                             (index / size.x) % size.y,
                             (index / (size.x * size.y)) % size.z,
@@ -151,23 +196,31 @@ namespace WFC
 
 		//Gets the total number of elements contained by this array.
 		int GetNumbElements() const { return size.x * size.y * size.z * size.w; }
+		//Gets the number of elements actually allocated for this array.
+		//For the 'Bricked' layout this includes padding, to fill out the bricks on the edges.
+		int GetNumbStoredElements() const
+		{
+			if (layout == ArrayLayouts::Bricked)
+				return size.x * nBricksYZ * Bricks::GetCount(size.w) * Bricks::NElements;
+			return GetNumbElements();
+		}
 
 
 		//Fills every element with the given value.
 		void Fill(const ArrayType& value)
 		{
-			for (int i = 0; i < GetNumbElements(); ++i)
+			for (int i = 0; i < GetNumbStoredElements(); ++i)
 				arrayVals[i] = value;
 		}
 		//Copies the given elements to this array.
-		//Assumes that the size of this array matches with the given one.
+		//Assumes that the given elements are in this array's storage order (see "GetArray()").
 		//If "useMemcpy" is true, the whole thing will be copied at once with memcpy().
 		//Otherwise, each element will be set using its assignment operator.
 		void Fill(const ArrayType* values, bool useMemcpy)
 		{
 			if (useMemcpy)
-				memcpy(arrayVals, values, GetNumbElements() * sizeof(ArrayType));
-			else for (int i = 0; i < GetNumbElements(); ++i)
+				memcpy(arrayVals, values, GetNumbStoredElements() * sizeof(ArrayType));
+			else for (int i = 0; i < GetNumbStoredElements(); ++i)
 				arrayVals[i] = values[i];
 		}
 
@@ -176,37 +229,97 @@ namespace WFC
 		//Fills every element using the given function.
 		void FillFunc(Func getValue)
 		{
-			Vector4i loc;
+			ForEach([&](const Vector4i& loc, ArrayType& value) { getValue(loc, &value); });
+		}
 
-			for (Vector4i p : Region4i(GetDimensions()))
-				getValue(loc, &(*this)[p]);
+		//A function with signature "void Visit(const Vector4i& index, ArrayType& value)".
+		template<typename Func>
+		//Visits every element in the order they're stored in memory,
+		//    which is the most cache-efficient order for either layout.
+		void ForEach(Func visit)
+		{
+			ForEachIndex([&](const Vector4i& loc, int i) { visit(loc, arrayVals[i]); });
+		}
+		//A function with signature "void Visit(const Vector4i& index, const ArrayType& value)".
+		template<typename Func>
+		//Visits every element in the order they're stored in memory,
+		//    which is the most cache-efficient order for either layout.
+		void ForEach(Func visit) const
+		{
+			ForEachIndex([&](const Vector4i& loc, int i) { visit(loc, (const ArrayType&)arrayVals[i]); });
 		}
 
 		//Copies this array into the given one using "memcpy", which is as fast as possible.
-		//Assumes the given array is the same size as this one.
+		//Assumes the given array has the same size and layout as this one.
 		void MemCopyInto(ArrayType* outValues) const
 		{
-			memcpy(outValues, arrayVals, GetNumbElements() * sizeof(ArrayType));
+			memcpy(outValues, arrayVals, GetNumbStoredElements() * sizeof(ArrayType));
 		}
 		//Copies this array into the given one using the assignment operator for each value.
-		//Assumes it is the same size as this array.
+		//Assumes it has the same size and layout as this array.
 		//Use this instead of "MemCopyInto" if the items are too complex to just copy their byte-data over.
 		void CopyInto(ArrayType* outValues) const
 		{
-			for (int i = 0; i < GetNumbElements(); ++i)
+			for (int i = 0; i < GetNumbStoredElements(); ++i)
 				outValues[i] = arrayVals[i];
 		}
 
 		//Gets a pointer to the first element in this array.
+		//There are "GetNumbStoredElements()" elements, ordered by "GetIndex()".
 		const ArrayType* GetArray() const { return arrayVals; }
 		//Gets a pointer to the first element in this array.
+		//There are "GetNumbStoredElements()" elements, ordered by "GetIndex()".
 		ArrayType* GetArray() { return arrayVals; }
     
 
 	private:
 
 		Vector4i size;
+		ArrayLayouts layout;
+		int nBricksY, nBricksYZ;
 		ArrayType* arrayVals;
+
+		void UpdateBrickCounts()
+		{
+			nBricksY = Bricks::GetCount(size.y);
+			nBricksYZ = nBricksY * Bricks::GetCount(size.z);
+		}
+
+		//Calls "visit(Vector4i location, int arrayIndex)" for every element, in storage order.
+		//Padding elements are skipped.
+		template<typename Func>
+		void ForEachIndex(Func visit) const
+		{
+			Vector4i loc;
+			if (layout == ArrayLayouts::Bricked)
+			{
+				Vector3i brickMin;
+				int i = 0;
+				for (brickMin.z = 0; brickMin.z < size.w; brickMin.z += Bricks::Size)
+					for (brickMin.y = 0; brickMin.y < size.z; brickMin.y += Bricks::Size)
+						for (brickMin.x = 0; brickMin.x < size.y; brickMin.x += Bricks::Size)
+						{
+							for (loc.w = brickMin.z; loc.w < brickMin.z + Bricks::Size; ++loc.w)
+								for (loc.z = brickMin.y; loc.z < brickMin.y + Bricks::Size; ++loc.z)
+									for (loc.y = brickMin.x; loc.y < brickMin.x + Bricks::Size; ++loc.y)
+									{
+										if (loc.y < size.y && loc.z < size.z && loc.w < size.w)
+											for (loc.x = 0; loc.x < size.x; ++loc.x)
+												visit(loc, i + loc.x);
+										i += size.x;
+									}
+						}
+			}
+			else
+			{
+				int i = 0;
+				for (loc.w = 0; loc.w < size.w; ++loc.w)
+					for (loc.z = 0; loc.z < size.z; ++loc.z)
+						for (loc.y = 0; loc.y < size.y; ++loc.y)
+							for (loc.x = 0; loc.x < size.x; ++loc.x)
+								visit(loc, i++);
+			}
+		}
 	};
 }
 
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+
+namespace WFC
+{
+	//The different ways a multi-dimensional array can arrange its elements in memory.
+	enum class ArrayLayouts : uint8_t
+	{
+		//Plain row-major order: X is contiguous, then Y, then Z.
+		RowMajor,
+		//The array is split into 4x4x4 "bricks", each of which is contiguous in memory,
+		//    so that neighbors along any axis are usually close together.
+		//Costs some padding if the array size isn't a multiple of 4.
+		Bricked
+	};
+
+	//Helpers for the 'Bricked' array layout.
+	namespace Bricks
+	{
+		constexpr int SizeLog2 = 2,
+					  Size = 1 << SizeLog2,
+					  Mask = Size - 1,
+					  NElements = Size * Size * Size;
+
+		//Gets the number of bricks needed to cover the given number of elements along one axis.
+		inline int GetCount(int size) { return (size + Mask) >> SizeLog2; }
+
+		//Gets the index of an element within its brick.
+		inline int GetInnerIndex(int x, int y, int z)
+		{
+			return (x & Mask) |
+				   ((y & Mask) << SizeLog2) |
+				   ((z & Mask) << (SizeLog2 * 2));
+		}
+		//Gets an element's index in a bricked array, given the number of bricks along X and in an XY slice.
+		inline int GetIndex(int x, int y, int z, int nBricksX, int nBricksXY)
+		{
+			int brickI = (x >> SizeLog2) +
+						 ((y >> SizeLog2) * nBricksX) +
+						 ((z >> SizeLog2) * nBricksXY);
+			return (brickI * NElements) + GetInnerIndex(x, y, z);
+		}
+	}
+}
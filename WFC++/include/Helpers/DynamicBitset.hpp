@@ -0,0 +1,225 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <bit>
+#include <iterator>
+#include <algorithm>
+
+#include "../Platform.h"
+
+
+namespace WFC
+{
+	//A set of integers from 0 to some capacity, stored densely as one bit per possible element.
+	//Unlike std::bitset, the capacity is picked at runtime.
+	//Like 'Tiled3D::TransformSet', the number of elements is cached.
+	//Operations that combine two sets assume they have the same capacity.
+	class DynamicBitset
+	{
+	public:
+
+		using Word = uint64_t;
+		static constexpr size_t BITS_PER_WORD = sizeof(Word) * 8;
+
+
+		DynamicBitset() { }
+		//Creates a set that can hold the elements [0, capacity).
+		//It can start out either empty or full.
+		explicit DynamicBitset(size_t _capacity, bool startFull = false)
+			: words((_capacity + BITS_PER_WORD - 1) / BITS_PER_WORD, 0),
+			  capacity(_capacity)
+		{
+			if (startFull)
+				AddAll();
+		}
+
+
+		size_t GetCapacity() const { return capacity; }
+		size_t Size() const { return count; }
+		bool IsEmpty() const { return count == 0; }
+		const std::vector<Word>& GetWords() const { return words; }
+
+		bool Contains(size_t i) const
+		{
+			WFCPP_ASSERT(i < capacity);
+			return (words[i / BITS_PER_WORD] & GetBit(i)) != 0;
+		}
+		//Gets whether this set has any elements in common with the given one.
+		bool Intersects(const DynamicBitset& set) const
+		{
+			WFCPP_ASSERT(set.capacity == capacity);
+			for (size_t i = 0; i < words.size(); ++i)
+				if ((words[i] & set.words[i]) != 0)
+					return true;
+			return false;
+		}
+		//Returns whether the element was already in the set.
+		bool Add(size_t i)
+		{
+			WFCPP_ASSERT(i < capacity);
+			auto& word = words[i / BITS_PER_WORD];
+			bool contained = (word & GetBit(i)) != 0;
+			word |= GetBit(i);
+			count += contained ? 0 : 1;
+			return contained;
+		}
+		//Returns whether the element was in the set.
+		bool Remove(size_t i)
+		{
+			WFCPP_ASSERT(i < capacity);
+			auto& word = words[i / BITS_PER_WORD];
+			bool contained = (word & GetBit(i)) != 0;
+			word &= ~GetBit(i);
+			count -= contained ? 1 : 0;
+			return contained;
+		}
+
+		//Adds all elements of the given set to this one.
+		//Returns how many elements were added.
+		size_t Add(const DynamicBitset& set)
+		{
+			WFCPP_ASSERT(set.capacity == capacity);
+			size_t prevCount = count;
+			count = 0;
+			for (size_t i = 0; i < words.size(); ++i)
+			{
+				words[i] |= set.words[i];
+				count += std::popcount(words[i]);
+			}
+			return count - prevCount;
+		}
+		//Removes all elements of this set except for those in the given one.
+		//Returns how many elements were removed.
+		size_t Intersect(const DynamicBitset& set)
+		{
+			WFCPP_ASSERT(set.capacity == capacity);
+			size_t prevCount = count;
+			count = 0;
+			for (size_t i = 0; i < words.size(); ++i)
+			{
+				words[i] &= set.words[i];
+				count += std::popcount(words[i]);
+			}
+			return prevCount - count;
+		}
+		//Removes the given elements from this set.
+		//Returns how many elements were removed.
+		size_t Remove(const DynamicBitset& set)
+		{
+			WFCPP_ASSERT(set.capacity == capacity);
+			size_t prevCount = count;
+			count = 0;
+			for (size_t i = 0; i < words.size(); ++i)
+			{
+				words[i] &= ~set.words[i];
+				count += std::popcount(words[i]);
+			}
+			return prevCount - count;
+		}
+
+		void AddAll()
+		{
+			std::fill(words.begin(), words.end(), ~Word{ 0 });
+			//Keep the unused bits of the last word cleared.
+			if (capacity % BITS_PER_WORD != 0)
+				words.back() = (Word{ 1 } << (capacity % BITS_PER_WORD)) - 1;
+			count = capacity;
+		}
+		void Clear()
+		{
+			std::fill(words.begin(), words.end(), Word{ 0 });
+			count = 0;
+		}
+		//Overwrites this set with the given words, in the same layout as 'GetWords()'.
+		//Useful for saving and restoring a set without allocating.
+		void SetWords(const Word* newWords)
+		{
+			count = 0;
+			for (size_t i = 0; i < words.size(); ++i)
+			{
+				words[i] = newWords[i];
+				count += std::popcount(words[i]);
+			}
+		}
+
+		//Gets the smallest element, or the capacity if the set is empty.
+		size_t First() const
+		{
+			for (size_t i = 0; i < words.size(); ++i)
+				if (words[i] != 0)
+					return (i * BITS_PER_WORD) + std::countr_zero(words[i]);
+			return capacity;
+		}
+
+		bool operator==(const DynamicBitset& set) const { return capacity == set.capacity && words == set.words; }
+		bool operator!=(const DynamicBitset& set) const { return !operator==(set); }
+
+
+		//Implement iteration, in increasing order.
+		#pragma region Iterator
+
+		struct ConstIterator
+		{
+			using iterator_category = std::forward_iterator_tag;
+			using difference_type = ptrdiff_t;
+			using value_type = size_t;
+			using pointer = size_t;
+			using reference = size_t;
+
+			const DynamicBitset* Set;
+			size_t WordI;
+			//The bits of the current word that haven't been visited yet.
+			Word RemainingBits;
+
+			//Makes an iterator starting at the first element.
+			ConstIterator(const DynamicBitset& set)
+				: Set(&set), WordI(0), RemainingBits(set.words.empty() ? 0 : set.words[0])
+			{
+				SkipEmptyWords();
+			}
+			//Makes an 'end()' iterator.
+			ConstIterator(const DynamicBitset& set, size_t endWordI)
+				: Set(&set), WordI(endWordI), RemainingBits(0) { }
+
+			ConstIterator& operator++()
+			{
+				//Clear the lowest bit.
+				RemainingBits &= RemainingBits - 1;
+				SkipEmptyWords();
+				return *this;
+			}
+
+			bool operator==(const ConstIterator& iter) const { return (Set == iter.Set) && (WordI == iter.WordI) && (RemainingBits == iter.RemainingBits); }
+			bool operator!=(const ConstIterator& iter) const { return !operator==(iter); }
+
+			size_t operator*() const { return (WordI * BITS_PER_WORD) + std::countr_zero(RemainingBits); }
+
+
+		private:
+			void SkipEmptyWords()
+			{
+				while (RemainingBits == 0 && WordI < Set->words.size())
+				{
+					WordI += 1;
+					if (WordI < Set->words.size())
+						RemainingBits = Set->words[WordI];
+				}
+			}
+		};
+
+		#pragma endregion
+
+		auto begin() const { return ConstIterator(*this); }
+		auto end() const { return ConstIterator(*this, words.size()); }
+
+
+	private:
+
+		std::vector<Word> words;
+		size_t capacity = 0,
+			   count = 0;
+
+		static Word GetBit(size_t i) { return Word{ 1 } << (i % BITS_PER_WORD); }
+	};
+}
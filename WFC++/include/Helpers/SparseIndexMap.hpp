@@ -0,0 +1,161 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+#include "../Platform.h"
+
+
+namespace WFC
+{
+	template<class ValueType>
+	//A hash map from 32-bit indices (e.x. linear array indices) to values,
+	//    for when only a small fraction of the indices ever get a value.
+	//Uses open addressing with linear probing, so lookups touch one contiguous array.
+	//The largest possible index is reserved to mark empty slots.
+	class SparseIndexMap
+	{
+	public:
+
+		using Key = uint32_t;
+		static constexpr Key EMPTY_KEY = std::numeric_limits<Key>::max();
+
+
+		SparseIndexMap() { }
+
+
+		size_t GetSize() const { return count; }
+		bool IsEmpty() const { return count == 0; }
+		//The number of slots in the underlying table.
+		size_t GetCapacity() const { return keys.size(); }
+
+		//Gets the value for the given index, or null if it doesn't have one.
+		const ValueType* Find(Key key) const
+		{
+			if (count == 0)
+				return nullptr;
+			for (size_t i = GetHomeSlot(key); ; i = (i + 1) & mask)
+			{
+				if (keys[i] == key)
+					return &values[i];
+				if (keys[i] == EMPTY_KEY)
+					return nullptr;
+			}
+		}
+		ValueType* Find(Key key) { return const_cast<ValueType*>(const_cast<const SparseIndexMap*>(this)->Find(key)); }
+
+		//Gets the value for the given index, default-constructing it if it doesn't exist yet.
+		ValueType& operator[](Key key)
+		{
+			WFCPP_ASSERT(key != EMPTY_KEY);
+
+			//Grow at 50% load, which keeps probe sequences short.
+			if ((count + 1) * 2 > keys.size())
+				Rehash(keys.empty() ? 16 : (keys.size() * 2));
+
+			size_t i = GetHomeSlot(key);
+			for (; keys[i] != EMPTY_KEY; i = (i + 1) & mask)
+				if (keys[i] == key)
+					return values[i];
+
+			keys[i] = key;
+			values[i] = ValueType();
+			count += 1;
+			return values[i];
+		}
+
+		//Removes every element for which the given predicate (taking the key and value) returns true.
+		//Returns the number of removed elements.
+		template<typename Predicate>
+		size_t EraseIf(Predicate predicate)
+		{
+			//Rebuilding the table is simpler than shifting probe sequences around mid-iteration,
+			//    and it's linear-time either way.
+			size_t oldCount = count;
+			std::vector<Key> oldKeys;
+			std::vector<ValueType> oldValues;
+			oldKeys.swap(keys);
+			oldValues.swap(values);
+
+			keys.assign(oldKeys.size(), EMPTY_KEY);
+			values.resize(oldValues.size());
+			count = 0;
+			for (size_t i = 0; i < oldKeys.size(); ++i)
+				if (oldKeys[i] != EMPTY_KEY && !predicate(oldKeys[i], oldValues[i]))
+					Insert(oldKeys[i], oldValues[i]);
+
+			return oldCount - count;
+		}
+
+		//Iterates over every element, in no particular order.
+		//The function should take the key and a reference to the value.
+		template<typename Func>
+		void ForEach(Func visit)
+		{
+			for (size_t i = 0; i < keys.size(); ++i)
+				if (keys[i] != EMPTY_KEY)
+					visit(keys[i], values[i]);
+		}
+		template<typename Func>
+		void ForEach(Func visit) const
+		{
+			for (size_t i = 0; i < keys.size(); ++i)
+				if (keys[i] != EMPTY_KEY)
+					visit(keys[i], values[i]);
+		}
+
+		//Removes all elements, but keeps the memory around for reuse.
+		void Clear()
+		{
+			std::fill(keys.begin(), keys.end(), EMPTY_KEY);
+			count = 0;
+		}
+
+
+	private:
+
+		std::vector<Key> keys;
+		std::vector<ValueType> values;
+		size_t count = 0,
+			   mask = 0;
+		int hashShift = 64;
+
+
+		size_t GetHomeSlot(Key key) const
+		{
+			//Fibonacci hashing scatters nearby indices, which would otherwise cluster up.
+			return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> hashShift);
+		}
+
+		//Inserts a key that is known to not exist yet, assuming there's room for it.
+		void Insert(Key key, const ValueType& value)
+		{
+			size_t i = GetHomeSlot(key);
+			while (keys[i] != EMPTY_KEY)
+				i = (i + 1) & mask;
+			keys[i] = key;
+			values[i] = value;
+			count += 1;
+		}
+
+		//Changes the table's size, which must be a power of two.
+		void Rehash(size_t newCapacity)
+		{
+			std::vector<Key> oldKeys(newCapacity, EMPTY_KEY);
+			std::vector<ValueType> oldValues(newCapacity);
+			oldKeys.swap(keys);
+			oldValues.swap(values);
+			mask = newCapacity - 1;
+			hashShift = 64;
+			for (size_t c = newCapacity; c > 1; c >>= 1)
+				hashShift -= 1;
+
+			count = 0;
+			for (size_t i = 0; i < oldKeys.size(); ++i)
+				if (oldKeys[i] != EMPTY_KEY)
+					Insert(oldKeys[i], oldValues[i]);
+		}
+	};
+}
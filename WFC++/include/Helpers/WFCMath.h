@@ -2,6 +2,7 @@
 
 #include <numeric>
 #include <limits>
+#include <bit>
 
 #include "../Platform.h"
 
@@ -55,75 +56,18 @@ namespace WFC
             return iBytes[0] == 1;
         }
 
-        //Finds which bit is set, in an integer with 1 bit set.
-        inline uint_fast8_t FindBitIndex(uint32_t u)
-        {
-            //Accomplished by hacking on a 64-bit float.
-            //Reference: http://graphics.stanford.edu/~seander/bithacks.html#IntegerLogIEEE64Float
-
-            static_assert(std::numeric_limits<double>().is_iec559,
-                          "This only works for standard 64-bit floats");
-            
-            //Assemble the double's bit-pattern with a specific exponent.
-            const uint32_t exponent = 0x43300000;
-            uint_fast8_t exponentHalf = IsPlatformLittleEndian() ? 1 : 0,
-                         mantissaHalf = IsPlatformLittleEndian() ? 0 : 1;
-            uint32_t bytes[2];
-            bytes[exponentHalf] = exponent;
-            bytes[mantissaHalf] = u;
-
-            //Manipulate the double.
-            double d;
-            unsigned char* dBytes = (unsigned char*)&d;
-            std::memcpy(dBytes, bytes, sizeof(double));
-            d -= 4503599627370496.0;
-            
-            //Grab the exponent again, and use it to deduce the log
-            std::memcpy(&bytes[exponentHalf],
-                        &dBytes[exponentHalf * sizeof(uint32_t)],
-                        sizeof(uint32_t));
-            return (uint_fast8_t)((bytes[exponentHalf] >> 20) - 0x3FF);
-        }
-        inline uint_fast8_t FindBitIndex(uint64_t u)
-        {
-            uint32_t half1 = u & 0xFFFFFFFF,
-                     half2 = u >> 32;
-            return (half1 == 0) ?
-                       (FindBitIndex(half2) + 32) :
-                       half2;
-            auto resultHalf1 = FindBitIndex(uint32_t{ u & 0xffffffff }),
-                 resultHalf2 = FindBitIndex(uint32_t{ u >> 32 });
-            return resultHalf1;
-        }
+        //Finds the index of the lowest set bit in an integer.
+        //If the integer is 0, returns its bit count.
+        constexpr uint_fast8_t FindBitIndex(uint32_t u) { return static_cast<uint_fast8_t>(std::countr_zero(u)); }
+        constexpr uint_fast8_t FindBitIndex(uint64_t u) { return static_cast<uint_fast8_t>(std::countr_zero(u)); }
         //Forbid implicit conversion from unsupported types.
         template<class T> uint_fast8_t FindBitIndex(T t) = delete;
 
         //Counts the number of '1' bits in an integer.
-        inline uint_fast8_t CountBits(uint8_t u)
-        {
-            //Reference: https://stackoverflow.com/questions/9949935/calculate-number-of-bits-set-in-byte
-            static const uint8_t NIBBLE_LOOKUP[16] =
-            {
-              0, 1, 1, 2, 1, 2, 2, 3,
-              1, 2, 2, 3, 2, 3, 3, 4
-            };
-            return NIBBLE_LOOKUP[u & 0x0F] + NIBBLE_LOOKUP[u >> 4];
-        }
-        inline uint_fast8_t CountBits(uint16_t u)
-        {
-            return CountBits((uint8_t)(u & 0xff)) +
-                   CountBits((uint8_t)(u >> 8));
-        }
-        inline uint_fast8_t CountBits(uint32_t u)
-        {
-            return CountBits((uint16_t)(u & 0xffff)) +
-                   CountBits((uint16_t)(u >> 16));
-        }
-        inline uint_fast8_t CountBits(uint64_t u)
-        {
-            return CountBits((uint32_t)(u & 0xffffffff)) +
-                   CountBits((uint32_t)(u >> 32));
-        }
+        constexpr uint_fast8_t CountBits(uint8_t u) { return static_cast<uint_fast8_t>(std::popcount(u)); }
+        constexpr uint_fast8_t CountBits(uint16_t u) { return static_cast<uint_fast8_t>(std::popcount(u)); }
+        constexpr uint_fast8_t CountBits(uint32_t u) { return static_cast<uint_fast8_t>(std::popcount(u)); }
+        constexpr uint_fast8_t CountBits(uint64_t u) { return static_cast<uint_fast8_t>(std::popcount(u)); }
         //Forbid implicit conversion from unsupported types
         template<class T> uint_fast8_t CountBits(T t) = delete;
 
@@ -8,8 +8,6 @@ namespace WFC
 {
     namespace Simple
     {
-        using PixelFrequencyLookup = std::unordered_map<Pixel, size_t>;
-
         //TODO: Support diagonal reflections.
 
 	    //Input image data for the WFC algorithm.
@@ -45,19 +43,33 @@ namespace WFC
 		    inline const Pixel& GetPixel(Vector2i inputPos, Transformations transform) const
 			    { return pixelDataByTransform[transform][inputPos]; }
 
-		    //Gets the number of times each pixel appears in this input data.
-		    const PixelFrequencyLookup& GetPixelFrequencies() const { return pixelFrequencies; }
+		    //Gets every distinct color in the input data, in the order they first appear.
+		    //A color's position in this list is its "palette index".
+		    const std::vector<Pixel>& GetPalette() const { return palette; }
+		    //Gets the palette index of the given color, which must appear in the input data.
+		    size_t GetPaletteIndex(Pixel color) const { return paletteIndices.at(color); }
+		    //Gets the number of times each color appears in the patterns, by palette index.
+		    const std::vector<size_t>& GetColorFrequencies() const { return colorFrequencies; }
 		    //Gets all patterns contained in this input data.
 		    const std::vector<Pattern>& GetPatterns() const { return patterns; }
+		    //Gets the pixels of every pattern, stored contiguously (see 'Pattern::PixelsStart').
+		    const std::vector<Pixel>& GetPatternPixels() const { return patternPixels; }
+		    //Gets the palette index of every pixel in 'GetPatternPixels()'.
+		    const std::vector<uint32_t>& GetPatternPaletteIndices() const { return patternPaletteIndices; }
 
 
 	    private:
 
 		    //All the patterns this instance contains.
 			std::vector<Pattern> patterns;
-
-		    //The number of times each pixel appears in this input data.
-		    PixelFrequencyLookup pixelFrequencies;
+		    //The pixels of every pattern, one after the other.
+		    std::vector<Pixel> patternPixels;
+		    std::vector<uint32_t> patternPaletteIndices;
+
+		    std::vector<Pixel> palette;
+		    std::unordered_map<Pixel, size_t> paletteIndices;
+		    //The number of times each color appears in the patterns, by palette index.
+		    std::vector<size_t> colorFrequencies;
 
 		    //Different transformed versions of the input pixel data.
 		    Array2D<Pixel> pixelDataByTransform[Transformations::Count];
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <map>
+#include <memory>
+
 #include "../Platform.h"
 #include "../HelperClasses.h"
 #include "InputData.h"
@@ -20,8 +23,10 @@ namespace WFC
 		    public:
 			    //The chosen value for this pixel.
 				std::optional<Pixel> Value;
-			    //The number of ways this pixel can become various colors.
-			    PixelFrequencyLookup ColorFrequencies;
+			    //The total number of ways this pixel can become any color
+			    //    (i.e. the sum of its entries in 'State::GetColorFrequencies()').
+			    //If this is 0, the pixel can't become anything.
+			    size_t Entropy = 0;
 		    };
 
 
@@ -37,15 +42,15 @@ namespace WFC
 		    //If this is set to 0, this generator just fails instead of clearing out the violation.
 		    size_t ViolationClearSize;
 
+		    //The number of threads used to recalculate the pixels around a changed pixel.
+		    //The extra threads are started the first time they're needed, and kept around after that.
+		    //The output is the same no matter how many threads are used.
+		    size_t NThreads = 1;
+
 
 		    State(const InputData& input, Vector2i outputSize,
-			      unsigned int seed, bool periodicX, bool periodicY, size_t violationClearSize)
-			    : Input(input), Output(outputSize), rng(seed),
-                  PeriodicX(periodicX), PeriodicY(periodicY),
-                  ViolationClearSize(violationClearSize)
-		    {
-			    Reset(outputSize);
-		    }
+			      unsigned int seed, bool periodicX, bool periodicY, size_t violationClearSize);
+		    ~State();
 
 
 		    inline const OutputPixel* operator[](Vector2i pos) const
@@ -91,11 +96,75 @@ namespace WFC
             //Returns the range of pixels whose probabilities will be affected by this.
             Region2i ClearArea(Vector2i center);
 
+		    //Copies an area of the output into 'outValues', row by row.
+		    //Each pixel's entry in 'outMasks' has every bit set if the pixel has a value,
+		    //    or is 0 if it's unset or outside the output (so that it matches anything).
+		    //See 'Pattern::DoesFit()'.
+		    void GetNeighborhood(Region2i area, Pixel* outValues, Pixel* outMasks) const;
+
+		    //Gets the number of ways the given pixel can become each color,
+		    //    indexed by palette index (see 'InputData::GetPalette()').
+		    const size_t* GetColorFrequencies(Vector2i pixelPos) const
+		    {
+			    return &colorFrequencies[GetPixelIndex(pixelPos) * Input.GetPalette().size()];
+		    }
+
+		    //Gets all output pixels with the lowest entropy.
+		    //Ignores any pixels whose color is already set.
+		    //The returned list is only valid until the output changes again.
+		    const std::vector<Vector2i>& GetBestPixels() const;
+
 
 	    private:
 
             PRNG rng;
 
+		    //The color frequencies of every pixel, stored contiguously.
+		    //Each pixel gets one entry per palette color.
+		    std::vector<size_t> colorFrequencies;
+
+		    //Every unset pixel is tracked in a "bucket" based on its entropy,
+		    //    so the lowest-entropy pixels can be found without scanning the whole output.
+		    //Entropies are sums of pattern frequencies and can get large,
+		    //    so the buckets are stored sparsely, and empty ones are removed.
+		    std::map<size_t, std::vector<Vector2i>> entropyBuckets;
+		    struct BucketSlot { size_t Entropy = 0; int Index = -1; };
+		    Array2D<BucketSlot> bucketSlots;
+
+		    //Scratch space for recalculating one pixel's color frequencies.
+		    //Each thread gets its own.
+		    struct RecalculationBuffers
+		    {
+			    //Colors which would violate the constraint.
+			    std::vector<bool> BadColors;
+			    //The output around the pixel (see 'GetNeighborhood()').
+			    std::vector<Pixel> NeighborhoodValues, NeighborhoodMasks;
+			    //Every index in the neighborhood which refers to the pixel itself.
+			    //There's more than one if the neighborhood wraps around a small periodic output.
+			    std::vector<size_t> PixelIndices;
+		    };
+		    std::vector<RecalculationBuffers> recalculationBuffers;
+
+		    //The pixels waiting to be recalculated.
+		    std::vector<Vector2i> pixelsToRecalculate;
+		    //When recalculating in parallel, the new frequencies and entropy of each pixel
+		    //    are written here first and copied into the output afterwards,
+		    //    so no thread writes to anything another thread reads.
+		    std::vector<size_t> recalculatedFrequencies, recalculatedEntropies;
+		    //The extra threads used when 'NThreads' is greater than 1.
+		    //They wait in between batches of pixels, instead of being started for each one.
+		    struct RecalculationWorkers;
+		    std::unique_ptr<RecalculationWorkers> recalculationWorkers;
+
+		    inline size_t GetPixelIndex(Vector2i pixelPos) const
+		    {
+			    return pixelPos.x + (pixelPos.y * static_cast<size_t>(Output.GetWidth()));
+		    }
+		    inline size_t* EditColorFrequencies(Vector2i pixelPos)
+		    {
+			    return &colorFrequencies[GetPixelIndex(pixelPos) * Input.GetPalette().size()];
+		    }
+
 
 		    static inline int Wrap(int val, int maxExclusive)
 		    {
@@ -104,13 +173,18 @@ namespace WFC
 			    return (val < 0) ? (val + maxExclusive) : val;
 		    }
 
-		    //Gets all output pixels with the fewest number of possible colors.
-		    //Ignores any pixels whose color is already set.
-		    void GetBestPixels(std::vector<Vector2i>& outValues) const;
-
-		    //If the given output pixel is unset,
-		    //    this function recalculates that pixel's "ColorFrequencies" field.
-		    void RecalculatePixelChances(Vector2i pixelPos);
+		    //Updates the given pixel's entry in 'entropyBuckets' to match its current state.
+		    void UpdateEntropyBucket(Vector2i pixelPos);
+		    void RemoveFromEntropyBucket(Vector2i pixelPos);
+
+		    //Recalculates the color frequencies and entropy of every unset pixel
+		    //    in 'pixelsToRecalculate', then clears that list.
+		    //Uses multiple threads if 'NThreads' is greater than 1.
+		    void RecalculatePixelChances();
+		    //Calculates the color frequencies of the given unset pixel, based only on 'Output's values.
+		    //Writes them into 'outFrequencies' and returns their sum.
+		    size_t CalculatePixelChances(Vector2i pixelPos, RecalculationBuffers& buffers,
+									     size_t* outFrequencies) const;
 	    };
     }
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "../Platform.h"
+#include "../HelperClasses.h"
+#include "InputData.h"
+
+
+namespace WFC
+{
+    namespace Simple
+    {
+        //A set of patterns, by their index in 'InputData::GetPatterns()'.
+        using PatternSet = DynamicBitset;
+
+	    //An alternative to 'State' which tracks patterns instead of colors.
+	    //Each output position (a "cell") has a set of patterns that could still be placed
+	    //    with their min corner at that position.
+	    //Placing a pattern narrows the cells around it using precomputed tables
+	    //    of which patterns can overlap at each offset, and the narrowing spreads outward
+	    //    until nothing else changes.
+	    //This scales far better than 'State', which tests every pattern against the output
+	    //    every time a pixel changes.
+	    class WFC_API WaveState
+	    {
+	    public:
+
+		    const InputData& Input;
+
+		    //The output pixels. A pixel is set once a pattern covering it has been chosen.
+		    Array2D<std::optional<Pixel>> Output;
+
+		    //Whether the output wraps along each axis.
+		    //Changing these only takes effect after calling "Reset()".
+		    bool PeriodicX, PeriodicY;
+
+		    //If a cell runs out of possible patterns,
+		    //    an area surrounding that cell will be cleared out and regenerated.
+		    //The size of that area is [pattern size] * ViolationClearSize,
+		    //    doubling each time the area can't be regenerated
+		    //    until it covers the whole output (at which point the generator fails).
+		    //If this is set to 0, this generator just fails instead of clearing out the violation.
+		    size_t ViolationClearSize;
+
+
+		    WaveState(const InputData& input, Vector2i outputSize,
+			          unsigned int seed, bool periodicX, bool periodicY, size_t violationClearSize);
+
+
+		    void Reset(Vector2i newOutputSize);
+
+            //Runs one iteration. Returns true (success), false (failure), or null (not done yet).
+            //If the algorithm failed, "out_failedAt" will contain
+            //    the cells that the algorithm failed at.
+			std::optional<bool> Iterate(std::vector<Vector2i>& out_failedAt) { Vector2i _; return Iterate(_, out_failedAt); }
+            //Runs one iteration. Returns true (success), false (failure), or null (not done yet).
+            //If the algorithm failed, "out_failedAt" will contain
+            //    the cells that the algorithm failed at.
+            //After running, "out_changedPos" contains the cell whose pattern was chosen,
+            //    assuming the algorithm didn't fail.
+			std::optional<bool> Iterate(Vector2i& out_changedPos, std::vector<Vector2i>& out_failedAt);
+
+		    //Forces the given pixel to have the given value,
+		    //    by removing every pattern that disagrees with it.
+		    //This is remembered, so that clearing out a violation doesn't undo it.
+		    //Returns false if this left some cell with no possible patterns.
+		    bool SetPixel(Vector2i pixelPos, Pixel value);
+
+		    //Gets the patterns that could still be placed with their min corner at the given cell.
+		    const PatternSet& GetPossiblePatterns(Vector2i cellPos) const { return cells[cellPos]; }
+
+
+	    private:
+
+            PRNG rng;
+
+            std::vector<Vector2i> patternSizes;
+
+            //The offsets from one cell to each cell that can hold an overlapping pattern.
+            //If all patterns are the same size, only the four direct neighbors are needed,
+            //    because overlaps further away are enforced through the cells in between.
+            std::vector<Vector2i> neighborOffsets;
+            //The index of each neighbor offset's negative.
+            std::vector<size_t> oppositeOffsets;
+            //For each pattern and neighbor offset (indexed as 'pattern*nOffsets + offset'),
+            //    the patterns that may be placed at that offset from it.
+            std::vector<PatternSet> compatiblePatterns;
+
+            //The patterns that could be placed at each cell,
+            //    given only the size of the output.
+            //Cells where no pattern fits are ignored entirely.
+            Array2D<PatternSet> initialCells;
+            Array2D<PatternSet> cells;
+
+            //The pixels given to "SetPixel()".
+            Array2D<std::optional<Pixel>> fixedPixels;
+            bool anyFixedPixels = false;
+
+            //Cells whose patterns have narrowed, and whose neighbors need to be narrowed in turn.
+            std::vector<Vector2i> propagationQueue;
+            //Whether each cell is already in 'propagationQueue'.
+            Array2D<bool> isQueued;
+            //Scratch space for the patterns allowed next to a cell, or removed from one.
+            PatternSet supportBuffer;
+            //Scratch space for picking a pattern.
+            std::vector<uint64_t> optionWeightSumsBuffer;
+            std::vector<size_t> optionValuesBuffer;
+
+            //Every cell with more than one possible pattern, or with none,
+            //    is tracked in a "bucket" based on its number of possible patterns,
+            //    so the lowest-entropy cells can be found without scanning the whole output.
+            std::vector<std::vector<Vector2i>> entropyBuckets;
+            struct BucketSlot { int Bucket = -1, Index = -1; };
+            Array2D<BucketSlot> bucketSlots;
+            //No bucket below this one has any elements.
+            size_t minEntropyBucket = 0;
+
+
+            inline Pixel GetPatternPixel(size_t patternI, Vector2i patternPos) const
+            {
+                return Input.GetPatternPixels()[Input.GetPatterns()[patternI].PixelsStart +
+                                                patternPos.x + (patternPos.y * patternSizes[patternI].x)];
+            }
+
+            //Applies wrapping to the given position, and returns whether it's inside the output.
+            bool Filter(Vector2i& pos) const;
+
+            void BuildCompatibilityTables();
+
+            //Updates the given cell's entry in 'entropyBuckets' to match its current state.
+            //Also writes its pattern into the output if it has exactly one left.
+            void UpdateCell(Vector2i cellPos);
+            void RemoveFromEntropyBucket(Vector2i cellPos);
+
+            void QueuePropagation(Vector2i cellPos);
+            //Narrows the possibilities of every cell affected by the cells in 'propagationQueue'.
+            //Returns false if some cell ended up with no possible patterns.
+            bool Propagate();
+
+		    //Gets all cells with the fewest number of possible patterns.
+		    //Ignores any cells that are already down to one pattern.
+            //The returned list is only valid until the output changes again.
+		    const std::vector<Vector2i>& GetBestCells();
+
+            //Removes every pattern from the given cell that would put a different value
+            //    at the given position within the pattern.
+            void RemoveDisagreeingPatterns(Vector2i cellPos, Vector2i patternPos, Pixel value);
+
+            //Clears out the cells with no possible patterns, or fails if that's not allowed/possible.
+            //Returns the result for "Iterate()".
+            std::optional<bool> HandleViolations(std::vector<Vector2i>& out_failedAt);
+            //Clears all cells surrounding the given one,
+            //    then narrows them (and their neighbors) again from the cells around them
+            //    and from the pixels given to "SetPixel()".
+		    //The size of the area to clear is [pattern size] * clearScale.
+            //Returns false if that left some cell with no possible patterns.
+            bool ClearArea(Vector2i center, size_t clearScale);
+	    };
+    }
+}
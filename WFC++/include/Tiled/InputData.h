@@ -40,7 +40,8 @@ namespace WFC
     namespace Tiled
     {
         //A collection of tiles, by their ID.
-        using TileIDSet = std::unordered_set<TileID>;
+        //Its capacity is the number of tiles in the InputData.
+        using TileIDSet = DynamicBitset;
 
 
 	    //Tile data for the WFC algorithm to generate from.
@@ -54,28 +55,42 @@ namespace WFC
 
 
             inline const std::vector<Tile>& GetTiles() const { return tiles; }
+            //Gets the largest weight of any tile.
+            inline uint32_t GetMaxWeight() const { return maxWeight; }
 
             //Gets all tiles that have the given edge type on the given side.
             inline const TileIDSet& GetTilesWithEdge(EdgeID type, EdgeDirs side) const
             {
-                auto found = matchingEdges.find({ type, side });
-                if (found == matchingEdges.end())
-                    return EmptyTileSet;
+                auto found = matchingEdgeIndices.find({ type, side });
+                if (found == matchingEdgeIndices.end())
+                    return matchingEdges[emptyMatchingEdgesI];
                 else
-                    return found->second;
+                    return matchingEdges[found->second];
+            }
+            //Gets all tiles that can be placed on the given side of the given tile.
+            //Equivalent to 'GetTilesWithEdge()' for that tile's edge and the opposite side,
+            //    but without any hashing.
+            inline const TileIDSet& GetAllowedNeighbors(TileID tile, EdgeDirs side) const
+            {
+                return matchingEdges[allowedNeighborIndices[(tile * 4) + side]];
             }
 
 	    private:
 
             //All the tiles in the input data, including rotated/reflected permutations.
             std::vector<Tile> tiles;
-
-            //A quick lookup of which tiles have a certain edge type in a certain direction.
-            std::unordered_map<EdgeInstance, TileIDSet> matchingEdges;
-
-
-            //The default response for "GetTilesWithEdge()".
-            static const TileIDSet EmptyTileSet;
+            uint32_t maxWeight = 0;
+
+            //For each edge type and direction that appears in the tileset,
+            //    the tiles which have that edge type in that direction.
+            //The last element is an empty set, for edges that no tile has.
+            std::vector<TileIDSet> matchingEdges;
+            size_t emptyMatchingEdgesI;
+            //A lookup of each edge type and direction's index in 'matchingEdges'.
+            std::unordered_map<EdgeInstance, size_t> matchingEdgeIndices;
+            //For each tile and side (indexed as 'tile*4 + side'),
+            //    the index in 'matchingEdges' of the tiles that can be placed on that side.
+            std::vector<size_t> allowedNeighborIndices;
 	    };
     }
 }
\ No newline at end of file
@@ -44,11 +44,26 @@ namespace WFC
 		    //If this is set to 0, this generator just fails instead of clearing space.
 		    size_t ClearSize;
 
+            //When an output tile has no possible tiles left,
+            //    the most recent tile placements are undone one at a time to try something else,
+            //    before falling back to clearing an area (see "ClearSize").
+            //This is the most placements that can be undone before the algorithm makes new progress.
+            //If this is set to 0, the generator always goes straight to clearing an area.
+            size_t MaxBacktracks = 8;
+
+            //If true, an output tile that could become a high-weight tile
+            //    is considered more certain than one that could become a low-weight tile.
+            //Otherwise, its entropy is just the number of tiles it could become.
+            //Changing this only takes effect after calling "Reset()".
+            bool WeightedEntropy;
+
 
 		    State(const InputData& input, Vector2i outputSize,
-			      unsigned int seed, bool periodicX, bool periodicY, size_t clearSize)
+			      unsigned int seed, bool periodicX, bool periodicY, size_t clearSize,
+                  bool weightedEntropy = false)
 			    : Input(input), Output(outputSize), rng(seed),
-                  PeriodicX(periodicX), PeriodicY(periodicY), ClearSize(clearSize)
+                  PeriodicX(periodicX), PeriodicY(periodicY), ClearSize(clearSize),
+                  WeightedEntropy(weightedEntropy)
 		    {
 			    Reset(outputSize);
 		    }
@@ -64,9 +79,8 @@ namespace WFC
             //    (after taking wrapping into account).
             inline bool IsValidPos(Vector2i tilePos) const
             {
-                //TODO: This is wrong, isn't it?
-                return (PeriodicX | ((tilePos.x >= 0) & (tilePos.y >= 0))) &
-                       (PeriodicY | ((tilePos.x < Output.GetWidth()) & (tilePos.y < Output.GetHeight())));
+                return (PeriodicX | ((tilePos.x >= 0) & (tilePos.x < Output.GetWidth()))) &
+                       (PeriodicY | ((tilePos.y >= 0) & (tilePos.y < Output.GetHeight())));
             }
 
             //Gets the output tile at the given position (after taking wrapping into account).
@@ -97,30 +111,125 @@ namespace WFC
 			std::optional<bool> Iterate(Vector2i& out_changedPos, std::vector<Vector2i>& out_failedAt);
 		
 		    //Sets the given space to use the given tile.
-		    //Re-calculates the status of neighboring tiles to take this into account.
+		    //Propagates the effects of this through the rest of the output.
             //If "permanent" is true, this tile will never get cleared out in the future
             //    (e.x. if the algorithm runs into an unsolvable state and needs to back up).
+            //Placements made before this one can no longer be undone by backtracking.
 		    void SetTile(Vector2i tilePos, TileID value, bool permanent = false);
 
 
 	    private:
 
 
-            TileIDSet allTileIDs, tempTileIdSet;
+            TileIDSet allTileIDs;
             PRNG rng;
 
+            //Scratch space for picking a tile, kept around to avoid heap allocations.
+            std::vector<TileID> optionValuesBuffer;
+            std::vector<uint64_t> optionWeightSumsBuffer;
+
+            //Every unset output tile is tracked in a "bucket" based on its entropy,
+            //    so the lowest-entropy tiles can be found without scanning the whole output.
+            //The entropy is the sum of 'tileEntropies' for each tile it could still become.
+            //Without "WeightedEntropy" that's simply the number of tiles.
+            //With it, each tile contributes "maxWeight + 1 - weight",
+            //    which keeps the entropy an integer (and so usable as a bucket index).
+            //If that would need more than 'MaxEntropyBuckets' buckets,
+            //    the contributions are scaled down to fit.
+            static constexpr size_t MaxEntropyBuckets = size_t{ 1 } << 16;
+            std::vector<size_t> tileEntropies;
+            std::vector<std::vector<Vector2i>> entropyBuckets;
+            //Where each output tile is in 'entropyBuckets'.
+            //Set tiles aren't in any bucket, and have a value of -1 for both.
+            struct BucketSlot { int Bucket = -1, Index = -1; };
+            Array2D<BucketSlot> bucketSlots;
+            //No bucket below this one has any elements.
+            size_t minEntropyBucket = 0;
+
+            size_t GetEntropy(const OutputTile& tile) const;
+            //Updates the given tile's entry in 'entropyBuckets' to match its current state.
+            void UpdateEntropyBucket(Vector2i tilePos);
+            void RemoveFromEntropyBucket(Vector2i tilePos);
+
+            //Output tiles whose possibilities have narrowed,
+            //    and whose neighbors need to be narrowed in turn.
+            std::vector<Vector2i> propagationQueue;
+            //Scratch space for the tiles allowed next to an output tile.
+            TileIDSet supportBuffer;
+            //Scratch space for the unsolvable tiles being cleared around.
+            std::vector<Vector2i> clearCentersBuffer;
+            //Scratch space for the unset tiles being recalculated by "RebuildTileChances()".
+            std::vector<Vector2i> rebuildQueue;
+            //The tiles already in 'rebuildQueue' are marked with the current 'rebuildMark',
+            //    so the marks don't need to be cleared every time.
+            Array2D<uint32_t> rebuildMarks;
+            uint32_t rebuildMark = 0;
+
+            //The "trail" is a log of the previous state of every output tile that changed,
+            //    so that changes can be undone in reverse order.
+            struct TrailEntry
+            {
+                Vector2i Pos;
+                std::optional<TileID> Value;
+            };
+            std::vector<TrailEntry> trail;
+            //The previous 'PossibleTiles' of each trail entry,
+            //    as a fixed number of words per entry (see 'TileIDSet::GetWords()').
+            std::vector<TileIDSet::Word> trailWords;
+
+            //The tile placements made by "Iterate()" which can still be undone.
+            struct Decision
+            {
+                Vector2i Pos;
+                TileID Tile;
+                //The size of the trail right before this placement.
+                size_t TrailStart;
+            };
+            std::vector<Decision> decisions;
+            //The number of placements that were dropped from the front of 'decisions'
+            //    since the last time the history was forgotten entirely.
+            size_t nForgottenDecisions = 0;
+            //The most placements there have been since the history was last forgotten.
+            //Reaching a new maximum counts as progress, and refills 'backtracksLeft'.
+            size_t deepestDecision = 0;
+            size_t backtracksLeft = 0;
+
+            //Saves the given output tile's current state to the trail.
+            void PushTrail(Vector2i tilePos);
+            //Undoes trail entries until the trail has the given size.
+            void UndoTrail(size_t newSize);
+            //Drops all undo history.
+            void ForgetHistory();
+            //Drops the oldest placements if there are more than backtracking could ever use.
+            void TrimHistory();
+
+            //Sets the given output tile, recording the change in the trail.
+            void PlaceTile(Vector2i tilePos, TileID value, bool permanent);
+            //Narrows the possibilities of every output tile affected by the tiles in 'propagationQueue'.
+            //Returns false if some output tile ended up with no possible tiles.
+            bool Propagate();
+            //Undoes the most recent placement and rules it out.
+            //Returns false if there was nothing left to undo.
+            bool Backtrack();
+
             //Clears all output tiles surrounding the given pixel.
 		    //The size of the area to clear is determined by the "ClearSize" field.
-            //Adds the cleared tiles and any adjacent ones to "out_affectedPoses".
 		    //Assumes that ClearSize is greater than 0.
-            void ClearArea(Vector2i center, std::unordered_set<Vector2i>& out_affectedPoses);
+            //Returns the cleared region, which should then be passed to "RebuildTileChances()".
+            Region2i ClearArea(Vector2i center);
+            //Recalculates the possibilities of every unset output tile in and around the given region
+            //    from scratch, along with every unset tile connected to those,
+            //    then propagates them.
+            void RebuildTileChances(Region2i region);
 
 		    //Gets all output tiles with the fewest number of possible states.
 		    //Ignores any tiles whose value is already set.
-		    void GetBestTiles(std::vector<Vector2i>& outValues) const;
+            //The returned list is only valid until the output changes again.
+		    const std::vector<Vector2i>& GetBestTiles();
 
 		    //If the given output tile is unset,
-		    //    this function recalculates that space's "PossibleTiles" field.
+		    //    this function recalculates that space's "PossibleTiles" field
+            //    based on its set neighbors.
 		    void RecalculateTileChances(Vector2i tilePos);
 	    };
     }
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <limits>
 #include <span>
+#include <cmath>
 
 #include "Tile.hpp"
 
@@ -18,6 +19,24 @@ namespace WFC
         using TileIdx = uint16_t;
         constexpr TileIdx TileIdx_INVALID = std::numeric_limits<TileIdx>::max();
 
+        //The linear index of a cell in a Grid, i.e. its index in 'Grid::Cells.GetArray()'.
+        using CellIdx = uint32_t;
+        constexpr CellIdx CellIdx_INVALID = std::numeric_limits<CellIdx>::max();
+
+        //The different ways a Grid can keep track of what may still be placed in each cell.
+        enum class PropagationModes : uint8_t
+        {
+            //Each cell's 'PossiblePermutations' are narrowed down directly whenever a neighbor is set,
+            //    which costs O(tiles) per neighbor.
+            Permutations,
+            //Each cell only remembers the face its set neighbors require along each of its sides.
+            //Its possibility count and weights are looked up from a cache keyed by those faces,
+            //    and its 'PossiblePermutations' are only rebuilt when asked for
+            //    (see 'Grid::GetPossiblePermutations()').
+            //This is cheaper for tilesets with many tiles but few distinct faces.
+            Faces
+        };
+
         //A 3D space which tiles can be placed in.
         class WFC_API Grid
         {
@@ -34,11 +53,17 @@ namespace WFC
                 //Cached count of the data in "PossiblePermutations" at this cell.
                 //A value of 0 means "unsolvable".
                 //A value of 1 means that it's set OR that it only has one possiblity left.
-                uint16_t NPossibilities = 0;
+                uint32_t NPossibilities = 0;
+
+                //Running sums over the cell's possible permutations, of each one's weight (w)
+                //    and of w*log(w).
+                //Kept up to date alongside 'NPossibilities' so that the weighted entropy is O(1) to compute.
+                float WeightSum = 0,
+                      WeightLogWeightSum = 0;
 
                 //Constructors written explicitly so we can insert breakpoints as needed.
                 CellState() { }
-                CellState(TileIdx chosenTile, Transform3D chosenPermutation, uint16_t nPossibilities)
+                CellState(TileIdx chosenTile, Transform3D chosenPermutation, uint32_t nPossibilities)
                     #if !WFCPP_DEBUG
                         : ChosenTile(chosenTile), ChosenPermutation(chosenPermutation), NPossibilities(nPossibilities)
                     #endif
@@ -52,6 +77,15 @@ namespace WFC
 
                 bool IsSet() const { return ChosenTile != TileIdx_INVALID; }
 
+                //The Shannon entropy of this cell's remaining permutations,
+                //    where each permutation's probability is proportional to its tile's weight.
+                float GetWeightedEntropy() const
+                {
+                    if (WeightSum <= 0)
+                        return 0;
+                    return Math::Max(0.0f, std::log(WeightSum) - (WeightLogWeightSum / WeightSum));
+                }
+
                 WFCPP_MEMORY_CHECK_FOOTER(16);
             };
 
@@ -80,13 +114,45 @@ namespace WFC
 
             //The input data:
             std::vector<Tile> InputTiles;
-            int NPermutedTiles;
+            //The number of distinct permuted tiles, i.e. the number of canonical permutations across all tiles.
+            uint32_t NPermutedTiles;
+            //Some permutations of a symmetric tile produce the exact same cube.
+            //Each group of these is tracked as one element (its first permutation, the "canonical" one)
+            //    in 'PossiblePermutations' and 'GetMatchingFaces()',
+            //    and weighted by the size of the group so that probabilities stay the same.
+            //Gets the permutations of a tile that stand in for each group.
+            const TransformSet& GetCanonicalPermutations(TileIdx tile) const { return CanonicalPermutations[tile]; }
+            //Gets every permutation of a tile which produces the same cube as the given one (including itself).
+            //Returns an empty set if the given transform isn't one of the tile's permutations.
+            const TransformSet& GetEquivalentPermutations(TileIdx tile, Transform3D permutation) const
+            {
+                return EquivalentPermutations[tile][TransformSet::ToBitIdx(permutation)];
+            }
+            //Gets the permutation which stands in for the given one in 'PossiblePermutations'.
+            //The given transform must be one of the tile's permutations.
+            Transform3D GetCanonicalPermutation(TileIdx tile, Transform3D permutation) const
+            {
+                WFCPP_ASSERT(InputTiles[tile].Permutations.Contains(permutation));
+                return TransformSet::FromBits(GetEquivalentPermutations(tile, permutation).Bits());
+            }
+            //Gets whether all of a tile's groups of equivalent permutations are the same size,
+            //    meaning each of its canonical permutations has the same weight.
+            bool HasUniformGroups(TileIdx tile) const { return UniformGroupSizes[tile] > 0; }
+            //Gets the total weight of some canonical permutations of a tile.
+            //Each one is weighted by the tile's own weight times the size of the group it stands in for.
+            float GetPermutationWeight(TileIdx tile, TransformSet canonicalPermutations) const
+            {
+                return std::get<0>(GetWeightSums(tile, canonicalPermutations));
+            }
             //Assigns a unique, contiguous, 0-based index to every face that appears in the tileset.
             const std::unordered_map<FacePermutation, int32_t>& GetFaceIndices() const { return FaceIndices; }
             //For each input tile (X) and FacePermutation (Y),
             //    stores which tile permutations contain that face.
             //You can get the index for a FacePermutation with 'FaceIndices'.
             const Array2D<TransformSet>& GetMatchingFaces() const { return MatchingFaces; }
+            //The weighted entropy of a cell that could still be any tile permutation.
+            //Useful for normalizing 'CellState::GetWeightedEntropy()'.
+            float GetMaxWeightedEntropy() const { return MaxWeightedEntropy; }
             inline void DEBUGMEM_ValidateInputs() const
             {
                 //Note: iterate with indices as much as possible so it's clearer in the debugger where validation is failing.
@@ -104,13 +170,17 @@ namespace WFC
             //The output data.
             //While these fields are exposed publicly,
             //    you are strongly encouraged to not modify them directly.
+            //Changes made directly to them also aren't tracked by 'Reset()',
+            //    which only restores the cells the grid itself changed;
+            //    debug builds assert that no other cells were changed.
             //TODO: Make them private with const getters, but public in DEBUG builds
             Array3D<CellState> Cells;
             //For each input tile (X), and each cell (YZW),
-            //    stores the permutations of that tile
+            //    stores the canonical permutations of that tile
             //    which could possibly be placed at that cell.
             //NOTE: after a cell is set, its entry here no longer gets updated,
             //    so you should check whether a cell is set before paying attention to this data.
+            //NOTE: in 'PropagationModes::Faces', this is only brought up to date by 'GetPossiblePermutations()'.
             Array4D<TransformSet> PossiblePermutations;
             //The initial state of 'PossiblePermutations', including any constraints that have been put on cells or faces.
             Array4D<TransformSet> InitialPossiblePermutations;
@@ -130,34 +200,23 @@ namespace WFC
             //This means there are n*7 as many entries (where n is the number of input tiles).
             //
             //If the neighbor cell does not exist then it stores an empty set for that neighbor's input tiles.
+            //
+            //In 'PropagationModes::Faces' this stays empty,
+            //    because undoing a cell only has to forget the faces it imposed on its neighbors.
             std::vector<TransformSet> StatePreActionHistory;
-            //Gets the order of the 6 neighbors + self in 'StatePreActionHistory',
-            //    per each entry in 'ActionHistory'.
-            //Ouputs a tuple of (neighborAxis, neighborDir), using (0, 0) for self.
-            static auto ActionHistoryNeighborsData(int idx) { return std::to_array({
-                std::make_tuple(0, -1),
-                std::make_tuple(0, 1),
-                std::make_tuple(1, -1),
-                std::make_tuple(1, 1),
-                std::make_tuple(2, -1),
-                std::make_tuple(2, 1),
-                std::make_tuple(0, 0)
-            })[idx]; }
             //Given a cell from the action history and its neighbor index (7 representing the cell itself),
             //     gets info on that neighbor in the moment before the cell was set.
             //
             //More precisely, returns a tuple of
             //    (srcCell, neighborCell, neighborPreviousPossibilitiesBegin, neighborPreviousPossibilitiesEnd).
+            //Not available in 'PropagationModes::Faces'.
             std::tuple<Vector3i, Vector3i, std::vector<TransformSet>::const_iterator, std::vector<TransformSet>::const_iterator>
                 ActionHistoryNeighborInfo(int cellHistoryIdx, int neighborI) const;
 
             void DEBUGMEM_ValidateOutputs() const
             {
-                //Note: iterate with indices as much as possible so it's clearer in the debugger where validation is failing.
-                for (Vector3i idx : Region3i(Cells.GetDimensions()))
-                    Cells[idx].DEBUGMEM_Validate();
-                for (Vector4i idx : Region4i(PossiblePermutations.GetDimensions()))
-                    PossiblePermutations[idx].DEBUGMEM_Validate();
+                Cells.ForEach([](const Vector3i&, const CellState& cell) { cell.DEBUGMEM_Validate(); });
+                PossiblePermutations.ForEach([](const Vector4i&, const TransformSet& set) { set.DEBUGMEM_Validate(); });
             }
             void DEBUGMEM_ValidateAll() const
             {
@@ -194,20 +253,47 @@ namespace WFC
                 };
             }
             //NOTE: The above shouldn't be publicly non-const, as changing them affects tile possibilities, but this will be refactored out eventually anyway.
+            //They also must not change after construction, as they're baked into the neighbor tables.
+
+            //How cell possibilities are tracked. Can't be changed after construction.
+            PropagationModes GetPropagationMode() const { return PropagationMode; }
+
+            //Gets the linear index of a (pre-filtered) cell.
+            CellIdx GetCellIdx(const Vector3i& cellPos) const { return static_cast<CellIdx>(Cells.GetIndex(cellPos.x, cellPos.y, cellPos.z)); }
+            //Gets the linear index of a cell's neighbor, or 'CellIdx_INVALID' if it's past the edge of the grid.
+            //Periodic wrapping is baked into a lookup table, so this needs no division or modulo.
+            CellIdx GetNeighborIdx(CellIdx cellIdx, Directions3D dir) const
+            {
+                auto offset = BoundaryClassNeighborOffsets[CellBoundaryClasses[cellIdx]][dir];
+                return (offset == NoNeighborOffset) ?
+                           CellIdx_INVALID :
+                           (cellIdx + static_cast<CellIdx>(offset));
+            }
 
             
             Grid(const std::vector<Tile>& inputTiles, const Vector3i& outputSize)
                 : Grid(inputTiles, outputSize, false, false, false) { }
+            //The 'cellLayout' is the memory layout of all per-cell data.
+            //'Bricked' is more cache-friendly for large grids, at the cost of some padding.
             Grid(const std::vector<Tile>& inputTiles, const Vector3i& outputSize,
-                 bool isPeriodicX, bool isPeriodicY, bool isPeriodicZ);
+                 bool isPeriodicX, bool isPeriodicY, bool isPeriodicZ,
+                 ArrayLayouts cellLayout = ArrayLayouts::RowMajor,
+                 PropagationModes propagationMode = PropagationModes::Permutations);
 
             //Sets up this instance for another run.
+            //Only the cells that changed since the last reset are touched,
+            //    so this is cheap for a grid that was barely used.
+            //Changes made directly to the public fields aren't tracked (see 'Cells').
             void Reset();
 
             
             bool IsLegalPlacement(const Vector3i& cellPos,
                                   TileIdx tileIdx, Transform3D tilePermutation) const;
 
+            //Gets the possible canonical permutations of each input tile at a cell (see 'PossiblePermutations').
+            //In 'PropagationModes::Faces', they are rebuilt first if they're out of date.
+            const TransformSet* GetPossiblePermutations(const Vector3i& cellPos);
+
 
             //Overwrites the tile in the given cell.
             //
@@ -218,6 +304,7 @@ namespace WFC
                          Report* report = nullptr,
                          bool assertLegalPlacement = true);
             //Permanently forbids a particular cell from using a particular tile.
+            //Permutations which produce the same cube as a forbidden one are forbidden too.
             //
             //If it already is using that tile, the cell will be cleared
             //    (even if marked as not changeable).
@@ -266,18 +353,70 @@ namespace WFC
 
         private:
 
-            //Gets the position and connecting face towards each neighbor of a cell.
-            //The neighbor positions are pre-filtered for convenience.
-            inline std::array<std::tuple<Vector3i, Directions3D>, N_DIRECTIONS_3D>
-                GetNeighbors(const Vector3i& cellPos) const
+            //Gets a cell by its index.
+            //The non-const versions of these getters mark the cell as dirty for 'Reset()',
+            //    so all changes to a cell should go through them.
+            CellState& GetCell(CellIdx cellIdx) { MarkCellDirty(cellIdx); return Cells.GetArray()[cellIdx]; }
+            const CellState& GetCell(CellIdx cellIdx) const { return Cells.GetArray()[cellIdx]; }
+            //Gets the possible permutations of each input tile at a cell.
+            TransformSet* GetPossibilities(CellIdx cellIdx) { MarkCellDirty(cellIdx); return PossiblePermutations.GetArray() + (cellIdx * InputTiles.size()); }
+            const TransformSet* GetPossibilities(CellIdx cellIdx) const { return PossiblePermutations.GetArray() + (cellIdx * InputTiles.size()); }
+            TransformSet* GetInitialPossibilities(CellIdx cellIdx) { MarkCellDirty(cellIdx); return InitialPossiblePermutations.GetArray() + (cellIdx * InputTiles.size()); }
+            const TransformSet* GetInitialPossibilities(CellIdx cellIdx) const { return InitialPossiblePermutations.GetArray() + (cellIdx * InputTiles.size()); }
+
+            //Cells are tracked for 'Reset()' in blocks of consecutive indices.
+            //In the 'Bricked' layout, each block is exactly one brick.
+            static constexpr uint32_t CellBlockSizeLog2 = 6,
+                                      CellBlockSize = 1 << CellBlockSizeLog2;
+            static_assert(CellBlockSize == Bricks::NElements);
+            //One bit per block of cells, set if it changed since the last 'Reset()'.
+            std::vector<uint64_t> DirtyCellBlockBits;
+            //The blocks whose bit is set in 'DirtyCellBlockBits', so that resetting doesn't have to search for them.
+            std::vector<uint32_t> DirtyCellBlocks;
+            inline void MarkCellDirty(CellIdx cellIdx)
             {
-                std::array<std::tuple<Vector3i, Directions3D>, N_DIRECTIONS_3D> neighbors;
-                neighbors[0] = { FilterPos(cellPos.LessX()), Directions3D::MinX };
-                neighbors[1] = { FilterPos(cellPos.MoreX()), Directions3D::MaxX };
-                neighbors[2] = { FilterPos(cellPos.LessY()), Directions3D::MinY };
-                neighbors[3] = { FilterPos(cellPos.MoreY()), Directions3D::MaxY };
-                neighbors[4] = { FilterPos(cellPos.LessZ()), Directions3D::MinZ };
-                neighbors[5] = { FilterPos(cellPos.MoreZ()), Directions3D::MaxZ };
+                uint32_t blockI = cellIdx >> CellBlockSizeLog2;
+                uint64_t& bits = DirtyCellBlockBits[blockI >> 6];
+                uint64_t bit = uint64_t{ 1 } << (blockI & 63);
+                if ((bits & bit) == 0)
+                {
+                    bits |= bit;
+                    DirtyCellBlocks.push_back(blockI);
+                }
+            }
+
+            //Gets the position and index of a cell's neighbor.
+            //The position is filtered (i.e. wrapped) if the neighbor exists.
+            inline std::tuple<Vector3i, CellIdx> GetNeighbor(const Vector3i& cellPos, CellIdx cellIdx, Directions3D dir) const
+            {
+                auto neighborIdx = GetNeighborIdx(cellIdx, dir);
+                auto axis = GetAxisIndex(dir);
+
+                Vector3i neighborPos = cellPos;
+                neighborPos[axis] += IsMin(dir) ? -1 : 1;
+                //If the neighbor exists past the edge of the grid, it wrapped around.
+                if (neighborIdx != CellIdx_INVALID)
+                {
+                    if (neighborPos[axis] < 0)
+                        neighborPos[axis] = Cells.GetDimensions()[axis] - 1;
+                    else if (neighborPos[axis] >= Cells.GetDimensions()[axis])
+                        neighborPos[axis] = 0;
+                }
+
+                return { neighborPos, neighborIdx };
+            }
+            //Gets the position, index, and connecting face towards each neighbor of a cell.
+            //Neighbors that don't exist have an index of 'CellIdx_INVALID'.
+            inline std::array<std::tuple<Vector3i, CellIdx, Directions3D>, N_DIRECTIONS_3D>
+                GetNeighbors(const Vector3i& cellPos, CellIdx cellIdx) const
+            {
+                std::array<std::tuple<Vector3i, CellIdx, Directions3D>, N_DIRECTIONS_3D> neighbors;
+                for (int dirI = 0; dirI < N_DIRECTIONS_3D; ++dirI)
+                {
+                    auto dir = static_cast<Directions3D>(dirI);
+                    auto [neighborPos, neighborIdx] = GetNeighbor(cellPos, cellIdx, dir);
+                    neighbors[dirI] = { neighborPos, neighborIdx, dir };
+                }
                 return neighbors;
             }
 
@@ -292,47 +431,145 @@ namespace WFC
             void SetFaceImpl(Vector3i pos, Directions3D dir,
                              const FaceIdentifiers& points,
                              Report* report, bool isForbidding);
-            void SetFaceInnerImpl(Vector3i pos, CellState& cell,
+            void SetFaceInnerImpl(const Vector3i& pos, CellIdx cellIdx,
                                   Directions3D face, const FaceIdentifiers& points,
                                   Report* report, bool isForbidding);
 
-            //Removes tile options from the given cell that do not (or do) fit the given face.
-            void ApplyFilter(const Vector3i& cellPos, const FacePermutation& chosenFace,
-                             CellState& cell, Report* report, bool isForbidding);
-            //Removes tile options from the given cell that do not fit the given face.
-            inline void ApplyFilter(const Vector3i& cellPos, const FacePermutation& chosenFace,
-                                    Report* report, bool isForbidding)
+            //Adds a cell to the report after some of its possibilities were filtered out.
+            static void ReportFilteredCell(Report* report, const Vector3i& cellPos,
+                                           int oldNPossibilities, int newNPossibilities)
             {
-                auto& cell = Cells[cellPos];
-                ApplyFilter(cellPos, chosenFace, cell, report, isForbidding);
+                if (report && oldNPossibilities != newNPossibilities)
+                {
+                    //If the cell no longer has any tile choices, it's unsolvable.
+                    if (newNPossibilities < 1)
+                        report->GotUnsolvable.insert(cellPos);
+                    //Otherwise, it's a candidate of interest since it just had some possibilities narrowed down.
+                    //NOTE: I previously added a check here that the possibility count actually changed, but that seems to make solving worse.
+                    else
+                        report->GotInteresting.insert(cellPos);
+                }
             }
+
+            //Removes tile options from the given cell that do not (or do) fit the given face.
+            //The cell's position is only needed for the report.
+            void ApplyFilter(const Vector3i& cellPos, CellIdx cellIdx,
+                             const FacePermutation& chosenFace,
+                             Report* report, bool isForbidding);
             //Updates a given neighbor of a cell, based on the given cell (presumably set).
-            void ApplyFilter(const Vector3i& cellPos,
-                             const Vector3i& neighborPos,
+            void ApplyFilter(CellIdx cellIdx,
+                             const Vector3i& neighborPos, CellIdx neighborIdx,
                              Directions3D sideTowardsNeighbor,
                              Report* report, bool isForbidding);
 
             //Removes tile options from the initial state of the given cell,
             //    by either forbidding or forcing the given face.
             //Does not touch the current cell possibilities, assuming you already handled those.
-            void ApplyInitialFilter(const Vector3i& cellPos, const FacePermutation& chosenFace,
+            void ApplyInitialFilter(CellIdx cellIdx, const FacePermutation& chosenFace,
                                     bool isForbidding);
 
             //Clears a cell's possibilities, resetting it to *all* possible tiles, respecting any constraints.
-            inline void ResetCellPossibilities(const Vector3i& cellPos, Report* report) { ResetCellPossibilities(cellPos, Cells[cellPos], report); }
-            void ResetCellPossibilities(const Vector3i& cellPos, CellState& cell, Report* report);
+            void ResetCellPossibilities(const Vector3i& cellPos, CellIdx cellIdx, Report* report);
 
             //Recalculates a cell's current possible tiles.
             //Does not bother passing it through the position filter, as it's assumed you already did this.
             //
             //This function should be called after potentially opening up new possibilities,
             //    because finding those is actually harder than recomputing from scratch.
-            void RecalculateCellPossibilities(const Vector3i& cellPos, CellState& cell, Report* report);
-            void RecalculateCellPossibilities(const Vector3i& cellPos, Report* report)
+            void RecalculateCellPossibilities(const Vector3i& cellPos, CellIdx cellIdx, Report* report);
+
+            //Gets the sums of weight (w) and w*log(w) over some canonical permutations of a tile.
+            inline std::tuple<float, float> GetWeightSums(int tileI, TransformSet canonicalPermutations) const
+            {
+                if (UniformGroupSizes[tileI] > 0)
+                {
+                    auto n = canonicalPermutations.Size();
+                    return { n * TileWeights[tileI], n * TileWeightLogWeights[tileI] };
+                }
+
+                float tileWeight = static_cast<float>(InputTiles[tileI].Weight),
+                      weightSum = 0,
+                      weightLogWeightSum = 0;
+                canonicalPermutations.ForEach([&](Transform3D permutation)
+                {
+                    float w = tileWeight * GetEquivalentPermutations(tileI, permutation).Size();
+                    weightSum += w;
+                    weightLogWeightSum += (w > 0) ? (w * std::log(w)) : 0.0f;
+                });
+                return { weightSum, weightLogWeightSum };
+            }
+            //Recomputes a cell's weight sums from scratch, using its current 'PossiblePermutations'.
+            void RecalculateCellWeights(CellIdx cellIdx, CellState& cell);
+
+
+            //In 'PropagationModes::Faces', the state along each side of a cell:
+            //    the index of the face required by a set neighbor (see 'FaceIndices'),
+            //    or one of the special values below.
+            //Cells keep this up to date even while they're set, so that it's correct once they're cleared.
+            using SideFaces = std::array<int32_t, N_DIRECTIONS_3D>;
+            //Nothing is required along this side.
+            static constexpr int32_t SideFace_Any = -1;
+            //The required face doesn't appear anywhere in the tileset, so nothing can fit.
+            static constexpr int32_t SideFace_Unmatched = -2;
+            //The possibility count and weight sums of a cell, given the faces along its sides.
+            struct SideFacesSummary
+            {
+                uint32_t NPossibilities;
+                float WeightSum, WeightLogWeightSum;
+            };
+            struct SideFacesHasher
+            {
+                size_t operator()(const SideFaces& faces) const
+                {
+                    size_t hash = 0;
+                    for (auto face : faces)
+                        hash = (hash * 0x9e3779b97f4a7c15ull) ^ static_cast<uint32_t>(face + 2);
+                    return hash;
+                }
+            };
+
+            //For each cell, the faces along its sides.
+            std::vector<SideFaces> CellSideFaces;
+            //For each cell, whether its 'PossiblePermutations' need to be rebuilt from its side faces.
+            std::vector<uint8_t> ArePossibilitiesStale;
+            //For each cell, whether its initial possibilities have been constrained.
+            //Those cells can't use the shared cache and compute their possibilities directly.
+            std::vector<uint8_t> HasInitialConstraints;
+            //Caches the summary of an unconstrained cell for every combination of side faces seen so far.
+            //Emptied on every reset, and whenever it grows past 'MaxSideFacesCacheSize'.
+            std::unordered_map<SideFaces, SideFacesSummary, SideFacesHasher> SideFacesCache;
+            static constexpr size_t MaxSideFacesCacheSize = size_t{ 1 } << 16;
+            std::vector<TransformSet> buffer_sideFaces_possibilities;
+
+            SideFaces& GetSideFaces(CellIdx cellIdx) { MarkCellDirty(cellIdx); return CellSideFaces[cellIdx]; }
+            //Gets the index of a face for 'SideFaces'.
+            int32_t GetSideFaceIdx(const FacePermutation& face) const
             {
-                if (!Cells.IsIndexValid(cellPos))
-                    return;
-                RecalculateCellPossibilities(cellPos, Cells[cellPos], report);
+                auto found = FaceIndices.find(face);
+                return (found == FaceIndices.end()) ? SideFace_Unmatched : found->second;
+            }
+            //Computes the possible permutations of each tile,
+            //    given a cell's initial possibilities and the faces along its sides.
+            void ComputeSideFacePossibilities(const TransformSet* initialPossibilities, const SideFaces& faces,
+                                              TransformSet* outPossibilities) const;
+            //In 'PropagationModes::Faces', updates a cell's possibility count and weights
+            //    from the faces along its sides, leaving its 'PossiblePermutations' to be rebuilt later.
+            void UpdateFromSideFaces(CellIdx cellIdx, CellState& cell);
+            //Updates a cell's weight sums after it lost some permutations of the given tile.
+            inline void RemoveCellWeights(CellState& cell, int tileI, TransformSet removed)
+            {
+                if (cell.NPossibilities < 1)
+                {
+                    //Snap to exactly zero so floating-point error can't accumulate.
+                    cell.WeightSum = 0;
+                    cell.WeightLogWeightSum = 0;
+                }
+                else if (removed.Size() > 0)
+                {
+                    auto [weightSum, weightLogWeightSum] = GetWeightSums(tileI, removed);
+                    cell.WeightSum -= weightSum;
+                    cell.WeightLogWeightSum -= weightLogWeightSum;
+                }
             }
 
 
@@ -343,6 +580,35 @@ namespace WFC
             //    caches all permutations of the tile which possess that face.
             Array2D<TransformSet> MatchingFaces;
 
+            //For each input tile, the one permutation standing in for each group of equivalent permutations.
+            std::vector<TransformSet> CanonicalPermutations;
+            //For each input tile and each of its permutations (by bit index),
+            //    all of the tile's permutations that produce the same cube.
+            std::vector<std::array<TransformSet, N_TRANSFORMS>> EquivalentPermutations;
+            //For each input tile, the size of every group of its equivalent permutations,
+            //    or 0 if the groups aren't all the same size.
+            std::vector<uint_fast8_t> UniformGroupSizes;
+
+            //For each input tile whose groups of equivalent permutations all have the same size,
+            //    caches the weight (w) of each group (the tile's weight times the group size) and w*log(w), as floats.
+            //Other tiles compute their weights per-group instead.
+            std::vector<float> TileWeights, TileWeightLogWeights;
+            //The weight sums and weighted entropy of a cell with every permutation still possible.
+            float MaxWeightSum, MaxWeightLogWeightSum, MaxWeightedEntropy;
+
+            //Cells are grouped into 'boundary classes' by how they reach their neighbors
+            //    (e.g. across a brick boundary, across the edge of a periodic grid, or not at all).
+            //Within a class, the offset from a cell's index to each neighbor's index is the same.
+            //For each cell (indexed like 'Cells.GetArray()'), its boundary class.
+            std::vector<uint8_t> CellBoundaryClasses;
+            //For each boundary class and direction, the offset from a cell's index to its neighbor's index,
+            //    or 'NoNeighborOffset' if there is no neighbor that way.
+            std::vector<std::array<int32_t, N_DIRECTIONS_3D>> BoundaryClassNeighborOffsets;
+            static constexpr int32_t NoNeighborOffset = std::numeric_limits<int32_t>::min();
+            void BuildNeighborTables();
+
+            PropagationModes PropagationMode;
+
             std::unordered_map<Vector3i, int> buffer_unwindCells_originalNPossibilities;
         };
     }
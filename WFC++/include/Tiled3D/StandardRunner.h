@@ -5,6 +5,7 @@
 #include <variant>
 
 #include "Grid.h"
+#include "../Helpers/SparseIndexMap.hpp"
 
 
 namespace WFC
@@ -44,6 +45,29 @@ namespace Tiled3D
                                               StandardRunnerAction_Finish>;
 
 
+    //The different ways a StandardRunner can measure the entropy of a cell.
+    enum class EntropyHeuristics : uint8_t
+    {
+        //The fraction of tile permutations that have been ruled out.
+        //Ignores tile weights.
+        PossibilityCount,
+        //The Shannon entropy of the remaining permutations, weighted by their tile's 'Weight'.
+        //Unlike the possibility count, this accounts for tiles with very uneven weights.
+        WeightedShannon
+    };
+
+    //The different ways a StandardRunner can recover from unsolvable cells.
+    enum class RecoveryStrategies : uint8_t
+    {
+        //Undo a growing number of the most recent placements,
+        //    and if that keeps failing, clear an area around each unsolvable cell that grows with its temperature.
+        Heuristic,
+        //Find the placements which ruled out every option of an unsolvable cell (its "conflict set"),
+        //    and undo placements back to the most recent one of them, skipping the unrelated ones in between.
+        //Falls back to clearing an area if that placement can't be undone.
+        Backjumping
+    };
+
     //Provides a flexible strategy to generate a tile Grid with WFC.
     class WFC_API StandardRunner
     {
@@ -67,8 +91,10 @@ namespace Tiled3D
         static const uint32_t NEVER_UNSOLVED_TIMESTAMP = -1;
 
 
-        //TODO: Switch to a Set, since most cells won't need their history tracked.
-        Array3D<CellHistory> History;
+        //The history of each cell, keyed by its index in the grid (see 'Grid::GetCellIdx()').
+        //Most cells never come near an unsolvable cell, so only the ones that do get an entry;
+        //    the rest implicitly have a default 'CellHistory'.
+        SparseIndexMap<CellHistory> History;
         StandardRunnerAction LastAction = StandardRunnerAction_Initialize{ };
 
         uint32_t CurrentTimestamp = 0; //Incremented each time the simulation iterates.
@@ -108,6 +134,7 @@ namespace Tiled3D
         int InitialUnwindingCount = 4;
         //If heuristics are telling us to do this many undo operations or more,
         //    switch to clearing cells instead.
+        //This also limits how far back a backjump can go.
         int MaxUnwindingCount = 64;
         //Equal to -1 when not in the middle of redoing some unwinding operations.
         int CurrentUnwindingCount = -1;
@@ -121,6 +148,8 @@ namespace Tiled3D
         //The influence on a cell's 'NPermutations' value on how soon it should be set.
         //Note that the 'NPermutations' value is fed in as a float from 0 to 1.
         float PriorityWeightEntropy = 0.8f;
+        //How a cell's entropy is measured for the above priority.
+        EntropyHeuristics EntropyHeuristic = EntropyHeuristics::PossibilityCount;
         //The random fluctuations of a cell's chances of being set.
         //This can cause lower-entropy cells to get set earlier than higher-entropy ones.
         //However it does not play nicely with 'Unwinding' history,
@@ -132,14 +161,60 @@ namespace Tiled3D
         Grid Grid;
 
 
+        //How to recover from unsolvable cells.
+        RecoveryStrategies RecoveryStrategy = RecoveryStrategies::Heuristic;
+        //When backjumping, the culprit's placement can be remembered as a "nogood":
+        //    it can't work alongside the rest of the conflict set,
+        //    so it won't be tried again while those other placements are in effect.
+        //Conflicts with more than this many other placements are cleared instead of backjumped,
+        //    since they'd likely happen again.
+        //A value of 0 disables nogoods, and always backjumps.
+        int MaxNogoodSize = 16;
+        //The most nogoods to remember per cell; the oldest ones are forgotten first.
+        int MaxNogoodsPerCell = 64;
+
+        //A tile permutation placed in a cell.
+        struct WFC_API CellPlacement
+        {
+            Vector3i Cell;
+            TileIdx Tile = 0;
+            //The canonical permutation (see 'Grid::GetCanonicalPermutation()').
+            Transform3D Permutation;
+        };
+        //A placement which can't be part of a solution while the placements in its 'Context' are in effect.
+        struct WFC_API Nogood
+        {
+            TileIdx Tile = 0;
+            //The canonical permutation (see 'Grid::GetCanonicalPermutation()').
+            Transform3D Permutation;
+            std::vector<CellPlacement> Context;
+        };
+        //The nogoods learned while backjumping, keyed by the index of their cell (see 'Grid::GetCellIdx()').
+        SparseIndexMap<std::vector<Nogood>> Nogoods;
+
+
+        //Gets the history of a cell, which is the default value if it was never near an unsolvable cell.
+        CellHistory GetHistory(const Vector3i& cell) const;
         //Calculates the temperature of a cell.
         float GetTemperature(const Vector3i& cell) const;
+        //Forgets the history of every cell that has completely cooled off, to save memory.
+        //Their temperature stays at 0, but if they heat up again
+        //    they'll be treated as never having been unsolvable before.
+        //Returns the number of cells that were forgotten.
+        size_t PruneHistory();
         //Calculates the area to clear around a given (presumably unsolvable) cell.
         Region3i GetClearRegion(const Vector3i& cell) const;
         //Calculates the priority of handling a given cell.
         //Will be a bit randomized each time it's called.
         float GetPriority(const Vector3i& cellPos);
 
+        //Gets whether every placement in a nogood's context is currently in the grid.
+        bool IsNogoodActive(const Nogood& nogood) const;
+        //Gets the placements that ruled out every option of a (presumably unsolvable) cell:
+        //    its set neighbors, plus the context of every nogood in effect there.
+        //Permanent constraints aren't placements, so they're not included.
+        void GetConflictSet(const Vector3i& cellPos, std::vector<CellPlacement>& outPlacements) const;
+
         //Get the cells that may be set next.
         //Note that if there are any Unsolvable cells (`GetUnsolvableCells()`),
         //    those are handled first.
@@ -157,8 +232,9 @@ namespace Tiled3D
 
         void Reset()
         {
-            Grid.ClearCells(Region3i(Grid.Cells.GetDimensions()));
-            History.Fill({ });
+            Grid.Reset();
+            History.Clear();
+            Nogoods.Clear();
             report.Clear();
             nextCells.clear();
             unsolvableCells.clear();
@@ -192,10 +268,15 @@ namespace Tiled3D
             : StandardRunner(inputTiles, gridSize, false, false, false, rand)
         {
         }
+        //The 'cellLayout' is the memory layout of the grid,
+        //    and the 'propagationMode' is how it tracks cell possibilities (see 'Grid').
         StandardRunner(const std::vector<Tile>& inputTiles, const Vector3i& gridSize,
                        bool periodicX, bool periodicY, bool periodicZ,
-                       PRNG rand = { std::random_device{ }() })
-            : History(gridSize, { }), Rand(rand), Grid(inputTiles, gridSize, periodicX, periodicY, periodicZ)
+                       PRNG rand = { std::random_device{ }() },
+                       ArrayLayouts cellLayout = ArrayLayouts::RowMajor,
+                       PropagationModes propagationMode = PropagationModes::Permutations)
+            : Rand(rand),
+              Grid(inputTiles, gridSize, periodicX, periodicY, periodicZ, cellLayout, propagationMode)
         {
         }
 
@@ -209,7 +290,18 @@ namespace Tiled3D
         std::unordered_map<Vector3i, int> buffer_unwindCells_originalNPossibilities;
 
 
+        std::vector<CellPlacement> buffer_backjump_conflictSet, buffer_backjump_bestConflictSet;
+        std::vector<Vector3i> buffer_backjump_unsolvableCells;
+        std::vector<TransformSet> buffer_nogoods_possibilities;
+
+
         void ClearAround(const Vector3i& centerCellPos);
+        //Undoes placements back to the most recent culprit of an unsolvable cell,
+        //    remembering a nogood for it if possible.
+        //Returns false if no culprit can be undone.
+        bool Backjump();
+        //Gets a cell's possible permutations, minus any ruled out by nogoods in effect there.
+        const TransformSet* GetAllowedPermutations(const Vector3i& cellPos);
 
         Vector3i PickNextCellToSet();
 
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../HelperClasses.h"
+#include "Tile.hpp"
+
+namespace WFC
+{
+    namespace Tiled3D
+    {
+        //An offline analysis of how the faces of a tileset connect to each other.
+        //It finds "dead" tile permutations, which have some face that no other tile permutation can ever sit against,
+        //    and so can never be placed in the interior of a grid.
+        //These would otherwise be filtered out over and over at runtime,
+        //    and they're a common source of contradictions.
+        //Removing one dead permutation can kill others that only it could connect to,
+        //    so the analysis repeats until nothing else dies.
+        //
+        //Note that a dead permutation may still fit along the border of a non-periodic grid,
+        //    where one of its sides has no neighbor.
+        //Only prune them if that doesn't matter to you.
+        class WFC_API TilesetAnalysis
+        {
+        public:
+
+            //For each input tile, its permutations which can never be placed.
+            std::vector<TransformSet> DeadPermutations;
+            int NDeadPermutations = 0;
+            //The number of tiles which lost all of their permutations.
+            int NDeadTiles = 0;
+            //The number of rounds of pruning it took to find every dead permutation.
+            //Permutations found in later rounds only died because of ones found in earlier rounds.
+            int NPruningRounds = 0;
+
+            //The number of distinct faces among all the original tile permutations.
+            int NFaces = 0;
+            //The number of those faces which no original tile permutation can sit against.
+            int NUnmatchedFaces = 0;
+
+            //Across every face of every live tile permutation,
+            //    the number of live tile permutations that can sit against it.
+            int MinNeighborOptions = 0,
+                MaxNeighborOptions = 0;
+            float AverageNeighborOptions = 0;
+            //For each input tile, the smallest number of live tile permutations
+            //    that can sit against any face of its live permutations.
+            //Tiles with no live permutations have a value of 0.
+            std::vector<int> MinNeighborOptionsPerTile;
+
+
+            TilesetAnalysis(const std::vector<Tile>& tiles);
+
+            //Removes the dead permutations from the given tileset, which should be the one that was analyzed.
+            //Tiles which lose all their permutations are left in the list (so that tile indices don't change),
+            //    and will never be placed.
+            void Prune(std::vector<Tile>& tiles) const;
+        };
+    }
+}
@@ -327,7 +327,206 @@ namespace WFC
             CornerBBA_120, CornerBBA_240,
         };
         constexpr uint_fast16_t N_ROTATIONS_3D = 24;
-        WFC_API Rotations3D CombineRotations(Rotations3D first, Rotations3D second);
+        //Every rotation, optionally combined with an inversion.
+        constexpr int N_TRANSFORMS = N_ROTATIONS_3D * 2;
+
+
+        //Lookup tables for transforms, generated at compile-time.
+        //Transforms are identified by 'Transform3D::GetIndex()'.
+        //Everything is derived from 'RotationAxes', which describes how each rotation moves a point around.
+        namespace TransformLookups
+        {
+            #pragma region RotationAxes
+
+            //Where one axis of a transformed point comes from.
+            struct AxisSource
+            {
+                uint8_t Axis;
+                bool Negate;
+            };
+            using AxisSources = std::array<AxisSource, 3>;
+
+            //For each rotation, and each axis of the rotated point,
+            //    the axis of the original point that it's taken from, and whether it's negated.
+            //Must match 'Transform3D::ApplyToPos()'.
+            constexpr std::array<AxisSources, N_ROTATIONS_3D> RotationAxes = { {
+                { { { 0, false }, { 1, false }, { 2, false } } }, //None
+
+                { { { 0, false }, { 2, true  }, { 1, false } } }, //AxisX_90
+                { { { 0, false }, { 1, true  }, { 2, true  } } }, //AxisX_180
+                { { { 0, false }, { 2, false }, { 1, true  } } }, //AxisX_270
+                { { { 2, false }, { 1, false }, { 0, true  } } }, //AxisY_90
+                { { { 0, true  }, { 1, false }, { 2, true  } } }, //AxisY_180
+                { { { 2, true  }, { 1, false }, { 0, false } } }, //AxisY_270
+                { { { 1, true  }, { 0, false }, { 2, false } } }, //AxisZ_90
+                { { { 0, true  }, { 1, true  }, { 2, false } } }, //AxisZ_180
+                { { { 1, false }, { 0, true  }, { 2, false } } }, //AxisZ_270
+
+                { { { 0, true  }, { 2, false }, { 1, false } } }, //EdgesXa
+                { { { 0, true  }, { 2, true  }, { 1, true  } } }, //EdgesXb
+                { { { 2, false }, { 1, true  }, { 0, false } } }, //EdgesYa
+                { { { 2, true  }, { 1, true  }, { 0, true  } } }, //EdgesYb
+                { { { 1, false }, { 0, false }, { 2, true  } } }, //EdgesZa
+                { { { 1, true  }, { 0, true  }, { 2, true  } } }, //EdgesZb
+
+                { { { 1, false }, { 2, false }, { 0, false } } }, //CornerAAA_120
+                { { { 2, false }, { 0, false }, { 1, false } } }, //CornerAAA_240
+                { { { 2, false }, { 0, true  }, { 1, true  } } }, //CornerABA_120
+                { { { 1, true  }, { 2, true  }, { 0, false } } }, //CornerABA_240
+                { { { 2, true  }, { 0, true  }, { 1, false } } }, //CornerBAA_120
+                { { { 1, true  }, { 2, false }, { 0, true  } } }, //CornerBAA_240
+                { { { 1, false }, { 2, true  }, { 0, true  } } }, //CornerBBA_120
+                { { { 2, true  }, { 0, false }, { 1, true  } } }, //CornerBBA_240
+            } };
+
+            #pragma endregion
+
+            //Gets the axis sources for the transform with the given index.
+            //An inversion negates every axis.
+            constexpr AxisSources GetAxisSources(uint_fast8_t trIdx)
+            {
+                auto axes = RotationAxes[trIdx % N_ROTATIONS_3D];
+                if (trIdx >= N_ROTATIONS_3D)
+                    for (auto& axis : axes)
+                        axis.Negate = !axis.Negate;
+                return axes;
+            }
+            //Applies a transform's axis sources to a point in the space from 0 to 'max' along each axis.
+            constexpr std::array<int, 3> ApplyAxisSources(const AxisSources& axes, std::array<int, 3> pos, int max)
+            {
+                std::array<int, 3> output{ };
+                for (int i = 0; i < 3; ++i)
+                    output[i] = axes[i].Negate ? (max - pos[axes[i].Axis]) : pos[axes[i].Axis];
+                return output;
+            }
+
+            //Packs a set of axis sources into a unique integer, from 0 to 27*8.
+            constexpr int PackAxisSources(const AxisSources& axes)
+            {
+                int key = (((axes[0].Axis * 3) + axes[1].Axis) * 3) + axes[2].Axis;
+                return (key * 8) + (axes[0].Negate ? 1 : 0) + (axes[1].Negate ? 2 : 0) + (axes[2].Negate ? 4 : 0);
+            }
+            //The index of each transform, keyed by its packed axis sources.
+            constexpr auto IndexByAxisSources = []()
+            {
+                std::array<uint8_t, 27 * 8> output{ };
+                for (uint_fast8_t trIdx = 0; trIdx < N_TRANSFORMS; ++trIdx)
+                    output[PackAxisSources(GetAxisSources(trIdx))] = trIdx;
+                return output;
+            }();
+            constexpr uint8_t GetIndex(const AxisSources& axes) { return IndexByAxisSources[PackAxisSources(axes)]; }
+
+            //The result of applying one transform and then another,
+            //    indexed as '[first * N_TRANSFORMS + second]'.
+            constexpr auto Then = []()
+            {
+                std::array<uint8_t, N_TRANSFORMS * N_TRANSFORMS> output{ };
+                for (uint_fast8_t firstI = 0; firstI < N_TRANSFORMS; ++firstI)
+                {
+                    auto firstAxes = GetAxisSources(firstI);
+                    for (uint_fast8_t secondI = 0; secondI < N_TRANSFORMS; ++secondI)
+                    {
+                        auto secondAxes = GetAxisSources(secondI);
+
+                        AxisSources combinedAxes{ };
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            const auto& middleAxis = firstAxes[secondAxes[i].Axis];
+                            combinedAxes[i] = { middleAxis.Axis, middleAxis.Negate != secondAxes[i].Negate };
+                        }
+                        output[(firstI * N_TRANSFORMS) + secondI] = GetIndex(combinedAxes);
+                    }
+                }
+                return output;
+            }();
+
+            //The inverse of each transform.
+            constexpr auto Inverse = []()
+            {
+                std::array<uint8_t, N_TRANSFORMS> output{ };
+                for (uint_fast8_t trIdx = 0; trIdx < N_TRANSFORMS; ++trIdx)
+                {
+                    auto axes = GetAxisSources(trIdx);
+                    AxisSources inverseAxes{ };
+                    for (uint8_t i = 0; i < 3; ++i)
+                        inverseAxes[axes[i].Axis] = { i, axes[i].Negate };
+                    output[trIdx] = GetIndex(inverseAxes);
+                }
+                return output;
+            }();
+
+            //Where each side of the cube ends up after each transform.
+            constexpr auto Sides = []()
+            {
+                std::array<std::array<Directions3D, N_DIRECTIONS_3D>, N_TRANSFORMS> output{ };
+                for (uint_fast8_t trIdx = 0; trIdx < N_TRANSFORMS; ++trIdx)
+                {
+                    auto axes = GetAxisSources(trIdx);
+                    for (uint_fast8_t side = 0; side < N_DIRECTIONS_3D; ++side)
+                        for (uint8_t i = 0; i < 3; ++i)
+                            if (axes[i].Axis == side / 2)
+                                output[trIdx][side] = (Directions3D)((i * 2) + (((side % 2) == 1) != axes[i].Negate ? 1 : 0));
+                }
+                return output;
+            }();
+
+            //Where each corner and edge of each side ends up on its new side after each transform,
+            //    indexed as '[transform][original side][original point]'.
+            //Computed by placing the points in the space from 0 to 2 and transforming them.
+            struct FacePointPlaces
+            {
+                std::array<std::array<PerFacePoint<FacePoints>, N_DIRECTIONS_3D>, N_TRANSFORMS> Corners{ },
+                                                                                                Edges{ };
+            };
+            constexpr auto PointPlaces = []()
+            {
+                //Gets the two axes of a face, in world-space order (see 'GetAxes()').
+                auto getFaceAxes = [](uint_fast8_t side) -> std::array<int, 2>
+                {
+                    switch (side / 2)
+                    {
+                        case 0: return { 1, 2 };
+                        case 1: return { 0, 2 };
+                        default: return { 0, 1 };
+                    }
+                };
+
+                FacePointPlaces output;
+                for (uint_fast8_t trIdx = 0; trIdx < N_TRANSFORMS; ++trIdx)
+                {
+                    auto axes = GetAxisSources(trIdx);
+                    for (uint_fast8_t side = 0; side < N_DIRECTIONS_3D; ++side)
+                    {
+                        auto oldFaceAxes = getFaceAxes(side),
+                             newFaceAxes = getFaceAxes(Sides[trIdx][side]);
+                        for (int pointI = 0; pointI < N_FACE_POINTS; ++pointI)
+                        {
+                            //Corners are at 0 or 2 along each face axis.
+                            //Edges are at 1 along the axis they're parallel to.
+                            std::array<int, 3> cornerPos{ }, edgePos{ };
+                            cornerPos[side / 2] = edgePos[side / 2] = ((side % 2) == 0) ? 0 : 2;
+                            cornerPos[oldFaceAxes[0]] = (pointI / 2) * 2;
+                            cornerPos[oldFaceAxes[1]] = (pointI % 2) * 2;
+                            bool isParallelToAxis1 = (pointI / 2) == 0;
+                            edgePos[oldFaceAxes[isParallelToAxis1 ? 0 : 1]] = 1;
+                            edgePos[oldFaceAxes[isParallelToAxis1 ? 1 : 0]] = (pointI % 2) * 2;
+
+                            cornerPos = ApplyAxisSources(axes, cornerPos, 2);
+                            edgePos = ApplyAxisSources(axes, edgePos, 2);
+
+                            output.Corners[trIdx][side][pointI] = (FacePoints)(
+                                (cornerPos[newFaceAxes[0]] == 0 ? 0 : 2) +
+                                (cornerPos[newFaceAxes[1]] == 0 ? 0 : 1));
+                            bool isNowParallelToAxis1 = edgePos[newFaceAxes[0]] == 1;
+                            output.Edges[trIdx][side][pointI] = (FacePoints)(
+                                (isNowParallelToAxis1 ? 0 : 2) +
+                                (edgePos[newFaceAxes[isNowParallelToAxis1 ? 1 : 0]] == 0 ? 0 : 1));
+                        }
+                    }
+                }
+                return output;
+            }();
+        }
 
 
         //The faces of a cube, with memory of how they have been transformed.
@@ -376,7 +575,22 @@ namespace WFC
             //The rotation that is applied (AFTER the inversion, if applicable).
             Rotations3D Rot = Rotations3D::None;
 
-            inline bool IsIdentity() const { return !Invert && Rot == Rotations3D::None; }
+            constexpr bool IsIdentity() const { return !Invert && Rot == Rotations3D::None; }
+
+            //Gets a unique index for this transform, from 0 to 'N_TRANSFORMS' - 1.
+            //This is the index into 'TransformLookups', and the bit index in 'TransformSet'.
+            constexpr uint_fast8_t GetIndex() const
+            {
+                return static_cast<uint_fast8_t>(Rot) +
+                       static_cast<uint_fast8_t>(Invert ? N_ROTATIONS_3D : 0);
+            }
+            //The inverse of 'GetIndex()'.
+            static constexpr Transform3D FromIndex(uint_fast8_t idx)
+            {
+                return (idx < N_ROTATIONS_3D) ?
+                           Transform3D{ false, static_cast<Rotations3D>(idx) } :
+                           Transform3D{ true, static_cast<Rotations3D>(idx - N_ROTATIONS_3D) };
+            }
 
             //Applies this transformation to the given 3D position.
             //By default centered around the origin, but you can provide a "max" value
@@ -384,48 +598,24 @@ namespace WFC
             Vector3i ApplyToPos(Vector3i pos, Vector3i maxInclusive = Vector3i::Zero()) const;
 
             //Gets the position of the given face after this transformation.
-            Directions3D ApplyToSide(Directions3D currentSide) const;
+            constexpr Directions3D ApplyToSide(Directions3D currentSide) const
+            {
+                return TransformLookups::Sides[GetIndex()][currentSide];
+            }
             //Gets the new permutated face after this transformation.
             FacePermutation ApplyToFace(FacePermutation currentFace) const;
             //Gets the new permutated cube after this transformation.
             CubePermutation ApplyToCube(CubePermutation currentCube) const;
 
-            inline Transform3D Inverse() const
-            {
-                //This is actually quite simple because you can consider
-                //    the inversion and rotation separately.
-
-                static const std::array<Rotations3D, N_ROTATIONS_3D> rotLookup = {
-                    Rotations3D::None, //None
-                    Rotations3D::AxisX_270, //AxisX_90
-                    Rotations3D::AxisX_180, //AxisX_180
-                    Rotations3D::AxisX_90, //AxisX_270
-                    Rotations3D::AxisY_270, //AxisY_90
-                    Rotations3D::AxisY_180, //AxisY_180
-                    Rotations3D::AxisY_90, //AxisY_270
-                    Rotations3D::AxisZ_270, //AxisZ_90
-                    Rotations3D::AxisZ_180, //AxisZ_180
-                    Rotations3D::AxisZ_90, //AxisZ_270
-                    Rotations3D::EdgesXa, //EdgesXa
-                    Rotations3D::EdgesXb, //EdgesXb
-                    Rotations3D::EdgesYa, //EdgesYa
-                    Rotations3D::EdgesYb, //EdgesYb
-                    Rotations3D::EdgesZa, //EdgesZa
-                    Rotations3D::EdgesZb, //EdgesZb
-                    Rotations3D::CornerAAA_240, //CornerAAA_120
-                    Rotations3D::CornerAAA_120, //CornerAAA_240
-                    Rotations3D::CornerABA_240, //CornerABA_120
-                    Rotations3D::CornerABA_120, //CornerABA_240
-                    Rotations3D::CornerBAA_240, //CornerBAA_120
-                    Rotations3D::CornerBAA_120, //CornerBAA_240
-                    Rotations3D::CornerBBA_240, //CornerBBA_120
-                    Rotations3D::CornerBBA_120, //CornerBBA_240
-                };
-
-                return { Invert, rotLookup[(int)Rot] };
+            constexpr Transform3D Inverse() const
+            {
+                return FromIndex(TransformLookups::Inverse[GetIndex()]);
             }
             //Applies the given transform after this one, and returns the resulting transform.
-            Transform3D Then(const Transform3D& tr2) const;
+            constexpr Transform3D Then(const Transform3D& tr2) const
+            {
+                return FromIndex(TransformLookups::Then[(GetIndex() * N_TRANSFORMS) + tr2.GetIndex()]);
+            }
 
 
             //A small yet performant uint type to contain a transform's perfect hash.
@@ -467,22 +657,26 @@ namespace WFC
                 return h;
             }
         };
-        constexpr int N_TRANSFORMS = N_ROTATIONS_3D * 2;
 
         //Gets the face data for a transformed cube.
         WFC_API FacePermutation GetFace(CubePermutation cubeBeforeTransform,
 		                                Transform3D transform,
 		                                Directions3D sideAfterTransform);
 
-        inline bool operator==(Transform3D t1, Transform3D t2)
+        constexpr bool operator==(Transform3D t1, Transform3D t2)
         {
             return (t1.Invert == t2.Invert) && (t1.Rot == t2.Rot);
         }
-        inline bool operator!=(Transform3D t1, Transform3D t2)
+        constexpr bool operator!=(Transform3D t1, Transform3D t2)
         {
             return !operator==(t1, t2);
         }
 
+        constexpr Rotations3D CombineRotations(Rotations3D first, Rotations3D second)
+        {
+            return Transform3D{ false, first }.Then(Transform3D{ false, second }).Rot;
+        }
+
 
         //An optimized and sorted collection of transforms (no heap usage necessary).
         //The default constructor creates an empty set; use static functions to create other kinds of sets.
@@ -516,10 +710,10 @@ namespace WFC
 
             //Gets the index of the bit for this transform.
             //This doubles as a unique index/perfect hash!
-            static uint_fast8_t ToBitIdx(Transform3D tr)
+            static constexpr uint_fast8_t ToBitIdx(Transform3D tr)
             {
-                return (uint_fast8_t)tr.Rot +
-                       (uint_fast8_t)(tr.Invert ? FIRST_INVERT_BIT_IDX : 0);
+                static_assert(FIRST_INVERT_BIT_IDX == N_ROTATIONS_3D);
+                return tr.GetIndex();
             }
             //Turns a transformation into a specific bit.
             static BitsType ToBits(Transform3D tr)
@@ -532,11 +726,9 @@ namespace WFC
                 return FromBit(Math::FindBitIndex(bits));
             }
             //Finds the transform corresponding to a specific bit.
-            static Transform3D FromBit(uint_fast8_t bitIdx)
+            static constexpr Transform3D FromBit(uint_fast8_t bitIdx)
             {
-                return (bitIdx < FIRST_INVERT_BIT_IDX) ?
-                           Transform3D{ false, (Rotations3D)bitIdx } :
-                           Transform3D{ true, (Rotations3D)(bitIdx - FIRST_INVERT_BIT_IDX) };
+                return Transform3D::FromIndex(bitIdx);
             }
 
             static TransformSet All() { TransformSet s; s.bits = USED_BITS; s.nBits = BIT_COUNT; return s; }
@@ -549,10 +741,7 @@ namespace WFC
             {
                 TransformSet set;
                 for (Transform3D tr : iterable)
-                {
-                    set.bits |= ToBits(tr);
-                    set.nBits += 1;
-                }
+                    set.Add(tr);
                 return set;
             }
             #pragma warning( push )
@@ -659,6 +848,32 @@ namespace WFC
                 nBits = Math::CountBits(bits);
             }
 
+            //Calls the given function for each transform in this set, in order.
+            //Jumps straight from one element to the next, like the iterator does.
+            template<typename Func>
+            void ForEach(Func&& f) const
+            {
+                for (BitsType remaining = bits; remaining != ZERO; remaining &= remaining - ONE)
+                    f(FromBit(Math::FindBitIndex(remaining)));
+            }
+            //Gets the n-th element of this set, in iteration order.
+            //'n' must be less than 'Size()'.
+            Transform3D NthElement(uint_fast8_t n) const
+            {
+                WFCPP_ASSERT(n < nBits);
+                BitsType remaining = bits;
+                for (uint_fast8_t i = 0; i < n; ++i)
+                    remaining &= remaining - ONE;
+                return FromBits(remaining);
+            }
+            //Gets the number of elements in this set which come before the given transform.
+            //If the transform is in the set, this is its index in iteration order
+            //    (the inverse of 'NthElement()').
+            uint_fast8_t Rank(Transform3D tr) const
+            {
+                return Math::CountBits(static_cast<BitsType>(bits & (ToBits(tr) - ONE)));
+            }
+
             void Clear() { bits = ZERO; nBits = ZERO; }
 
             //Implement equality/hashing for WFC dictionaries.
@@ -688,46 +903,32 @@ namespace WFC
                 //TODO: make proxies for references to elements.
 
                 const TransformSet* Set;
-                uint_fast8_t CurrentBit;
+                //The bits of the set that haven't been visited yet.
+                BitsType RemainingBits;
 
-                //Makes an iterator starting at the given bit.
-                //Automatically moves forward to the first actual element.
-                ConstIterator(const TransformSet& set, uint_fast8_t startBit)
-                    : Set(&set), CurrentBit(startBit)
-                {
-                    //Jump forward to the first existing rotation.
-                    while (CurrentBit < BIT_COUNT && !IsValidElement())
-                        CurrentBit += 1;
-                }
+                //Makes an iterator starting at the first element.
+                ConstIterator(const TransformSet& set, BitsType remainingBits)
+                    : Set(&set), RemainingBits(remainingBits) { }
                 //Makes an 'end()' iterator.
-                ConstIterator(const TransformSet& set) : Set(&set), CurrentBit(BIT_COUNT) { }
+                ConstIterator(const TransformSet& set) : Set(&set), RemainingBits(ZERO) { }
 
-                ConstIterator& operator=(const ConstIterator& iter) { Set = iter.Set; CurrentBit = iter.CurrentBit; return *this; }
                 ConstIterator& operator++()
                 {
-                    while (CurrentBit < BIT_COUNT)
-                    {
-                        CurrentBit += 1;
-                        if (IsValidElement())
-                            break;
-                    }
+                    //Clear the lowest bit.
+                    RemainingBits &= RemainingBits - ONE;
                     return *this;
                 };
 
-                bool operator==(const ConstIterator& iter) const { return (Set == iter.Set) && (CurrentBit == iter.CurrentBit); }
+                bool operator==(const ConstIterator& iter) const { return (Set == iter.Set) && (RemainingBits == iter.RemainingBits); }
                 bool operator!=(const ConstIterator& iter) const { return !operator==(iter); }
 
-                Transform3D operator*() const { return FromBit(CurrentBit); }
+                Transform3D operator*() const { return FromBit(Math::FindBitIndex(RemainingBits)); }
                 Transform3D operator->() const { return operator*(); }
-
-
-            private:
-                bool IsValidElement() const { return Set->Contains(FromBit(CurrentBit)); }
             };
 
             #pragma endregion
 
-            auto begin() const { return ConstIterator(*this, 0); }
+            auto begin() const { return ConstIterator(*this, bits); }
             auto end() const { return ConstIterator(*this); }
 
         private:
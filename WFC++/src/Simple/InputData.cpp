@@ -1,5 +1,7 @@
 #include "../../include/Simple/InputData.h"
 
+#include <algorithm>
+
 using namespace WFC;
 using namespace WFC::Simple;
 
@@ -14,7 +16,7 @@ InputData::InputData(const Array2D<Pixel>& pixelData, Vector2i patternSize,
 					 bool periodicX, bool periodicY, bool useRotations, bool useReflections)
 	: PeriodicX(periodicX), PeriodicY(periodicY),
 	  OriginalPatternSize(patternSize),
-	  MaxPatternSize(useReflections ?
+	  MaxPatternSize((useRotations || useReflections) ?
 					     Vector2i(max(patternSize.x, patternSize.y),
 								  max(patternSize.x, patternSize.y)) :
 						 patternSize)
@@ -42,6 +44,14 @@ InputData::InputData(const Array2D<Pixel>& pixelData, Vector2i patternSize,
 		pixelDataByTransform[Transformations::None] = std::move(dataCopy);
 	}
 
+	//Give each distinct color a dense index, so per-color data can be stored in flat arrays.
+	for (Vector2i pos : Region2i(pixelData.GetDimensions()))
+	{
+		auto [found, isNew] = paletteIndices.try_emplace(pixelData[pos], palette.size());
+		if (isNew)
+			palette.push_back(pixelData[pos]);
+	}
+
 	//Make transformed copies of the input data.
 	const Array2D<Pixel>& originalData = getOriginalData();
 	if (useRotations)
@@ -100,7 +110,16 @@ InputData::InputData(const Array2D<Pixel>& pixelData, Vector2i patternSize,
 		pixelDataByTransform[Transformations::FlipY] = std::move(transformedData_y);
 	}
 
-	//Create patterns.
+	//Create patterns, merging duplicates as they're found.
+	//Each pattern-sized chunk of the input is hashed with a rolling 2D polynomial hash,
+	//    so hashing a chunk takes constant time no matter how big the patterns are.
+	//Chunks with the same hash are then compared pixel-by-pixel to rule out collisions.
+	const uint64_t hashMultiplierX = 0x100000001B3ull,
+				   hashMultiplierY = 0x9E3779B97F4A7C15ull;
+	std::unordered_map<uint64_t, size_t> firstPatternByHash;
+	std::vector<size_t> nextPatternWithSameHash;
+	const size_t noPattern = std::numeric_limits<size_t>::max();
+	Array2D<uint64_t> rowHashes, chunkHashes;
 	for (Transformations transf : usedTransformations)
 	{
 		auto& transformedData = pixelDataByTransform[transf];
@@ -108,45 +127,113 @@ InputData::InputData(const Array2D<Pixel>& pixelData, Vector2i patternSize,
 							  		  transf == Transformations::Rotate270CW) ?
 									     Vector2i(patternSize.y, patternSize.x) :
 										 patternSize;
-
-		//Iterate across every pattern-sized chunk of the input and make a pattern out of it.
 		Vector2i maxPos = transformedData.GetDimensions() - transfPatternSize + 1;
-		for (Vector2i transfPos : Region2i(maxPos))
+		if (maxPos.x < 1 || maxPos.y < 1)
+			continue;
+
+		//The hash of a chunk is the sum of "pixel * (multiplierX^a) * (multiplierY^b)",
+		//    where 'a' and 'b' count the pixels after it along each axis.
+		//Sliding the chunk over by one removes the oldest row/column's term and adds a new one.
+		uint64_t highestMultiplierX = 1,
+				 highestMultiplierY = 1;
+		for (int i = 0; i < transfPatternSize.x; ++i)
+			highestMultiplierX *= hashMultiplierX;
+		for (int i = 0; i < transfPatternSize.y; ++i)
+			highestMultiplierY *= hashMultiplierY;
+
+		//First hash each pattern-width piece of every row.
+		rowHashes.Reset(maxPos.x, transformedData.GetHeight());
+		for (int y = 0; y < transformedData.GetHeight(); ++y)
 		{
-			Region2i patternRange(transfPos, transfPos + transfPatternSize);
-			patterns.push_back(Pattern(*this, transf, patternRange));
+			uint64_t hash = 0;
+			for (int x = 0; x < transformedData.GetWidth(); ++x)
+			{
+				hash = (hash * hashMultiplierX) + transformedData[Vector2i(x, y)];
+				if (x >= transfPatternSize.x)
+					hash -= transformedData[Vector2i(x - transfPatternSize.x, y)] * highestMultiplierX;
+				if (x >= transfPatternSize.x - 1)
+					rowHashes[Vector2i(x - transfPatternSize.x + 1, y)] = hash;
+			}
 		}
-	}
-
-	//Remove duplicate patterns.
-	//Hash the patterns for quicker comparisons.
-	std::vector<size_t> patternHashes;
-	patternHashes.resize(patterns.size());
-	for (size_t i = 0; i < patterns.size(); ++i)
-		patternHashes[i] = patterns[i].GetHashcode();
-	for (size_t i = 0; i < patterns.size(); ++i)
-	{
-		for (size_t j = i + 1; j < patterns.size(); ++j)
+		//Then combine those pieces down each column.
+		chunkHashes.Reset(maxPos.x, maxPos.y);
+		for (int x = 0; x < maxPos.x; ++x)
 		{
-			if (patternHashes[i] == patternHashes[j] && patterns[i].HasSameData(patterns[j]))
+			uint64_t hash = 0;
+			for (int y = 0; y < transformedData.GetHeight(); ++y)
 			{
-				patterns[i].Frequency += 1;
+				hash = (hash * hashMultiplierY) + rowHashes[Vector2i(x, y)];
+				if (y >= transfPatternSize.y)
+					hash -= rowHashes[Vector2i(x, y - transfPatternSize.y)] * highestMultiplierY;
+				if (y >= transfPatternSize.y - 1)
+					chunkHashes[Vector2i(x, y - transfPatternSize.y + 1)] = hash;
+			}
+		}
+		//Different transformations may have different pattern sizes.
+		uint64_t sizeHash = Vector2i(transfPatternSize).GetSTLHashcode();
+
+		//Iterate across every pattern-sized chunk of the input and make a pattern out of it,
+		//    unless it already exists.
+		for (Vector2i transfPos : Region2i(maxPos))
+		{
+			Region2i patternRange(transfPos, transfPos + transfPatternSize);
+			uint64_t hash = chunkHashes[transfPos] ^ sizeHash;
 
-				patterns.erase(patterns.begin() + j);
-				patternHashes.erase(patternHashes.begin() + j);
-				j -= 1;
+			auto [found, isNew] = firstPatternByHash.try_emplace(hash, patterns.size());
+			if (!isNew)
+			{
+				//Look for a pattern with the same pixels.
+				auto isSameAsChunk = [&](const Pattern& pattern)
+				{
+					if (pattern.InputDataRegion.GetSize() != transfPatternSize)
+						return false;
+					//Both the pattern and the input data are stored row by row.
+					const Pixel* patternRow = patternPixels.data() + pattern.PixelsStart;
+					for (int y = 0; y < transfPatternSize.y; ++y)
+					{
+						const Pixel* inputRow = &transformedData[transfPos + Vector2i(0, y)];
+						if (!std::equal(patternRow, patternRow + transfPatternSize.x, inputRow))
+							return false;
+						patternRow += transfPatternSize.x;
+					}
+					return true;
+				};
+				size_t patternI = found->second,
+					   lastPatternI = patternI;
+				while (patternI != noPattern && !isSameAsChunk(patterns[patternI]))
+				{
+					lastPatternI = patternI;
+					patternI = nextPatternWithSameHash[patternI];
+				}
+
+				if (patternI != noPattern)
+				{
+					patterns[patternI].Frequency += 1;
+					continue;
+				}
+
+				//It's a hash collision, so chain a new pattern onto the last one.
+				nextPatternWithSameHash[lastPatternI] = patterns.size();
 			}
+
+			//Add a new pattern.
+			patterns.push_back(Pattern(*this, transf, patternRange, patternPixels.size()));
+			nextPatternWithSameHash.push_back(noPattern);
+			for (Vector2i patternPos : Region2i(transfPatternSize))
+				patternPixels.push_back(transformedData[transfPos + patternPos]);
 		}
 	}
 
-    //Count the pixel frequencies.
-    for (size_t i = 0; i < patterns.size(); ++i)
+    //Count the color frequencies, and look up each pattern pixel's palette index.
+    colorFrequencies.resize(palette.size(), 0);
+    patternPaletteIndices.reserve(patternPixels.size());
+    for (Pixel color : patternPixels)
+        patternPaletteIndices.push_back(static_cast<uint32_t>(paletteIndices[color]));
+    for (const auto& pattern : patterns)
     {
-        auto& pattern = patterns[i];
-        for (Vector2i patternPos : Region2i(pattern.InputDataRegion.GetSize()))
-        {
-            Pixel color = pattern[patternPos];
-            pixelFrequencies[color] += pattern.Frequency;
-        }
+        size_t patternArea = static_cast<size_t>(pattern.InputDataRegion.GetSize().x) *
+                             static_cast<size_t>(pattern.InputDataRegion.GetSize().y);
+        for (size_t i = 0; i < patternArea; ++i)
+            colorFrequencies[patternPaletteIndices[pattern.PixelsStart + i]] += pattern.Frequency;
     }
-}
\ No newline at end of file
+}
@@ -2,25 +2,29 @@
 #include "../../include/Simple/InputData.h"
 #include "../../include/Simple/State.h"
 
+#include <algorithm>
+
 using namespace WFC;
 using namespace WFC::Simple;
 
 
 const Pixel& Pattern::operator[](const Vector2i& patternPos) const
 {
-	Vector2i inputPos = InputDataRegion.MinInclusive + patternPos;
-	return input->GetPixel(inputPos, InputDataTransform);
+	return GetPixels()[patternPos.x + (patternPos.y * InputDataRegion.GetSize().x)];
+}
+
+const Pixel* Pattern::GetPixels() const
+{
+	return input->GetPatternPixels().data() + PixelsStart;
 }
 
 size_t Pattern::GetHashcode() const
 {
 	const unsigned int prime = 59;
 	unsigned int hash = 1;
-	for (Vector2i sourcePixelPos : InputDataRegion)
-	{
-		Pixel pixel = input->GetPixel(sourcePixelPos, InputDataTransform);
-		hash = (hash * prime) + pixel;
-	}
+	const Pixel* pixels = GetPixels();
+	for (int i = 0; i < InputDataRegion.GetSize().x * InputDataRegion.GetSize().y; ++i)
+		hash = (hash * prime) + pixels[i];
 
     return static_cast<size_t>(hash);
 }
@@ -30,29 +34,42 @@ bool Pattern::HasSameData(const Pattern& otherPattern) const
 	if (InputDataRegion.GetSize() != otherPattern.InputDataRegion.GetSize())
 		return false;
 
+	int nPixels = InputDataRegion.GetSize().x * InputDataRegion.GetSize().y;
+	return std::equal(GetPixels(), GetPixels() + nPixels, otherPattern.GetPixels());
+}
+
+bool Pattern::DoesFit(Vector2i outputMinCorner, const State& outputState) const
+{
 	for (Vector2i patternPos : Region2i(InputDataRegion.GetSize()))
 	{
-		Pixel myPixel = (*this)[patternPos],
-			  theirPixel = otherPattern[patternPos];
-		if (myPixel != theirPixel)
+		Vector2i outputPos = patternPos + outputMinCorner;
+
+		Pixel inputPixel = (*this)[patternPos];
+		auto tryPixel = outputState[outputPos];
+		if (tryPixel != nullptr && tryPixel->Value.has_value() && tryPixel->Value.value() != inputPixel)
 			return false;
 	}
 
 	return true;
 }
 
-bool Pattern::DoesFit(Vector2i outputMinCorner, const State& outputState) const
+bool Pattern::DoesFit(const Pixel* outputValues, const Pixel* outputMasks, int outputStride) const
 {
-	for (Vector2i patternPos : Region2i(InputDataRegion.GetSize()))
+	Vector2i size = InputDataRegion.GetSize();
+	const Pixel* pixels = GetPixels();
+	for (int y = 0; y < size.y; ++y)
 	{
-		Vector2i inputPos = patternPos + InputDataRegion.MinInclusive,
-				 outputPos = patternPos + outputMinCorner;
-
-		Pixel inputPixel = input->GetPixel(inputPos, InputDataTransform);
-		auto tryPixel = outputState[outputPos];
-		if (tryPixel != nullptr && tryPixel->Value.has_value() && tryPixel->Value.value() != inputPixel)
+		//Accumulate mismatches without branching, so the compiler can vectorize each row.
+		Pixel mismatches = 0;
+		for (int x = 0; x < size.x; ++x)
+			mismatches |= (pixels[x] ^ outputValues[x]) & outputMasks[x];
+		if (mismatches != 0)
 			return false;
+
+		pixels += size.x;
+		outputValues += outputStride;
+		outputMasks += outputStride;
 	}
 
 	return true;
-}
\ No newline at end of file
+}
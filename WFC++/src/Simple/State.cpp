@@ -1,96 +1,176 @@
 #include "../../include/Simple/State.h"
 
-#include <unordered_set>
+#include <numeric>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 using namespace WFC;
 using namespace WFC::Simple;
 
 
-void State::Reset(Vector2i newOutputSize)
+//A fixed set of threads which each run their share of a job, then wait for the next one.
+struct State::RecalculationWorkers
 {
-	//Re-initialize the output array.
+	std::vector<std::thread> Threads;
+
+	std::mutex Lock;
+	std::condition_variable JobStarted, JobFinished;
+	//The current job, given the index of the thread running it
+	//    (0 is the thread that started the job, and the workers start at 1).
+	const std::function<void(size_t)>* Job = nullptr;
+	//Counts up every time a new job starts.
+	size_t JobI = 0;
+	size_t NBusyThreads = 0;
+	bool Quit = false;
+
+	RecalculationWorkers(size_t nThreads)
+	{
+		for (size_t threadI = 1; threadI <= nThreads; ++threadI)
+			Threads.emplace_back([this, threadI]() { RunThread(threadI); });
+	}
+	~RecalculationWorkers()
+	{
+		{
+			std::lock_guard<std::mutex> lock(Lock);
+			Quit = true;
+		}
+		JobStarted.notify_all();
+		for (auto& thread : Threads)
+			thread.join();
+	}
+
+	//Runs the given job on this thread and every worker thread, and waits for all of them to finish.
+	void Run(const std::function<void(size_t)>& job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(Lock);
+			Job = &job;
+			JobI += 1;
+			NBusyThreads = Threads.size();
+		}
+		JobStarted.notify_all();
+
+		job(0);
 
-	//Set the pixel frequencies for every pixel to the frequencies of the input image itself.
-	const auto& colorFrequencies = Input.GetPixelFrequencies();
+		std::unique_lock<std::mutex> lock(Lock);
+		JobFinished.wait(lock, [&]() { return NBusyThreads == 0; });
+	}
+
+private:
 
+	void RunThread(size_t threadI)
+	{
+		size_t lastJobI = 0;
+		std::unique_lock<std::mutex> lock(Lock);
+		while (true)
+		{
+			JobStarted.wait(lock, [&]() { return Quit || JobI != lastJobI; });
+			if (Quit)
+				return;
+			lastJobI = JobI;
+
+			lock.unlock();
+			(*Job)(threadI);
+			lock.lock();
+
+			NBusyThreads -= 1;
+			if (NBusyThreads == 0)
+				JobFinished.notify_one();
+		}
+	}
+};
+
+State::State(const InputData& input, Vector2i outputSize,
+			 unsigned int seed, bool periodicX, bool periodicY, size_t violationClearSize)
+	: Input(input), Output(outputSize),
+	  PeriodicX(periodicX), PeriodicY(periodicY),
+	  ViolationClearSize(violationClearSize),
+	  rng(seed)
+{
+	Reset(outputSize);
+}
+State::~State() = default;
+
+
+void State::Reset(Vector2i newOutputSize)
+{
+	//Re-initialize the output array.
 	Output.Reset(newOutputSize.x, newOutputSize.y);
 	for (Vector2i pos : Region2i(Output.GetDimensions()))
-	{
 		Output[pos] = OutputPixel();
 
-		auto& pixel = Output[pos];
-        pixel.ColorFrequencies = colorFrequencies;
+	//Set the color frequencies for every pixel to the frequencies of the input image itself.
+	const auto& inputFrequencies = Input.GetColorFrequencies();
+	size_t inputEntropy = std::accumulate(inputFrequencies.begin(), inputFrequencies.end(), size_t{ 0 });
+
+	colorFrequencies.resize(static_cast<size_t>(Output.GetNumbElements()) * inputFrequencies.size());
+	for (Vector2i pos : Region2i(Output.GetDimensions()))
+	{
+		std::copy(inputFrequencies.begin(), inputFrequencies.end(), EditColorFrequencies(pos));
+		Output[pos].Entropy = inputEntropy;
 	}
+
+	//Every pixel starts out in the same bucket.
+	entropyBuckets.clear();
+	bucketSlots.Reset(newOutputSize.x, newOutputSize.y, BucketSlot());
+	for (Vector2i pos : Region2i(Output.GetDimensions()))
+		UpdateEntropyBucket(pos);
 }
 
 std::optional<bool> State::Iterate(Vector2i& out_changedPos, std::vector<Vector2i>& out_failedAt)
 {
 	//Get the pixels that are closest to being certain.
-	std::vector<Vector2i> lowestEntropyPixelPoses;
-	GetBestPixels(lowestEntropyPixelPoses);
+	const auto& lowestEntropyPixelPoses = GetBestPixels();
 
 	//If all pixels are aleady set, we're done.
 	if (lowestEntropyPixelPoses.size() == 0)
 		return true;
 
 	//If any pixels are impossible to solve, handle it.
-	size_t nColorChoices = Output[lowestEntropyPixelPoses[0]].ColorFrequencies.size();
-	if (nColorChoices == 0)
+	if (Output[lowestEntropyPixelPoses[0]].Entropy == 0)
 	{
 		//Either clear out the violating pixels, or give up.
 		if (ViolationClearSize > 0)
 		{
             //Clear all violating pixels, and collect all positions that will be affected by this.
-            std::unordered_set<Vector2i> affectedPoses;
-			for (size_t i = 0; i < lowestEntropyPixelPoses.size(); ++i)
-				for (Vector2i affectedPos : ClearArea(lowestEntropyPixelPoses[i]))
-                    affectedPoses.insert(affectedPos);
+            //Clearing changes the entropy buckets, so copy the violating pixels first.
+            std::vector<Vector2i> violatingPixelPoses = lowestEntropyPixelPoses;
+			for (Vector2i violatingPos : violatingPixelPoses)
+				for (Vector2i affectedPos : ClearArea(violatingPos))
+                    pixelsToRecalculate.push_back(affectedPos);
 
             //Recalculate positions that will be affected by this.
-            for (Vector2i affectedPos : affectedPoses)
-                RecalculatePixelChances(affectedPos);
+            RecalculatePixelChances();
 
             out_changedPos = Vector2i(-1, -1);
 			return std::nullopt;
 		}
 		else
 		{
-			out_failedAt = std::move(lowestEntropyPixelPoses);
+			out_failedAt = lowestEntropyPixelPoses;
 			return false;
 		}
 	}
 
 	//Pick one of these pixels at random to fill in.
 	std::uniform_int_distribution<size_t> pixelIndexRange(0, lowestEntropyPixelPoses.size() - 1);
-	auto chosenPixelPos = lowestEntropyPixelPoses[pixelIndexRange(rng)];
+	Vector2i chosenPixelPos = lowestEntropyPixelPoses[pixelIndexRange(rng)];
 	auto& chosenPixel = Output[chosenPixelPos];
 
-	//Pick a color at random for the pixel to have.
-	Pixel chosenColor = -1; //Dummy value to keep the compiler hapy
-	//If there's only one possible color, this is easy.
-	if (chosenPixel.ColorFrequencies.size() == 1)
+	//Pick a color at random for the pixel to have, weighted by its frequency.
+	const auto& palette = Input.GetPalette();
+	const size_t* frequencies = GetColorFrequencies(chosenPixelPos);
+	std::uniform_int_distribution<size_t> weightRange(0, chosenPixel.Entropy - 1);
+	size_t chosenWeight = weightRange(rng),
+		   chosenColorI = 0;
+	while (chosenWeight >= frequencies[chosenColorI])
 	{
-        for (const auto& kvp : chosenPixel.ColorFrequencies)
-            chosenColor = kvp.first;
-	}
-	//Otherwise, make a weighted random choice.
-	else
-	{
-		//Get a list of values and corresponding weights.
-		std::vector<Pixel> colors(chosenPixel.ColorFrequencies.size());
-		std::vector<double> weights(chosenPixel.ColorFrequencies.size());
-		size_t index = 0;
-        for (const auto& colAndWeight : chosenPixel.ColorFrequencies)
-        {
-            colors[index] = colAndWeight.first;
-            weights[index] = static_cast<double>(colAndWeight.second);
-            index += 1;
-        }
-
-		//Plug that into the RNG.
-		std::discrete_distribution<size_t> distribution(weights.begin(), weights.end());
-		chosenColor = colors[distribution(rng)];
+		chosenWeight -= frequencies[chosenColorI];
+		chosenColorI += 1;
 	}
+	Pixel chosenColor = palette[chosenColorI];
 
 	//Finally set the pixel and wait for the next iteration.
 	SetPixel(chosenPixelPos, chosenColor);
@@ -101,13 +181,15 @@ std::optional<bool> State::Iterate(Vector2i& out_changedPos, std::vector<Vector2
 void State::SetPixel(Vector2i pixelPos, Pixel value)
 {
 	Output[pixelPos].Value = value;
+	RemoveFromEntropyBucket(pixelPos);
 
 	//Any pixel that could share a pattern with the changed pixel needs to be updated.
 	for (Vector2i affectedPixel : Region2i(pixelPos - Input.MaxPatternSize,
 										   pixelPos + Input.MaxPatternSize + 1))
 	{
-		RecalculatePixelChances(affectedPixel);
+		pixelsToRecalculate.push_back(affectedPixel);
 	}
+	RecalculatePixelChances();
 }
 
 Region2i State::ClearArea(Vector2i center)
@@ -121,106 +203,234 @@ Region2i State::ClearArea(Vector2i center)
 	for (Vector2i posToClear : regionToClear)
 	{
 		auto tryPixel = operator[](posToClear);
-		if (tryPixel != nullptr)
+		if (tryPixel != nullptr && tryPixel->Value.has_value())
+		{
 			tryPixel->Value = std::nullopt;
+
+			//Until it's recalculated, the pixel keeps the entropy it had before it was set.
+			Filter(posToClear);
+			UpdateEntropyBucket(posToClear);
+		}
 	}
 
 	return Region2i(regionToClear.MinInclusive - Input.MaxPatternSize + 1,
 				    regionToClear.MaxExclusive + Input.MaxPatternSize - 1);
 }
 
-void State::GetBestPixels(std::vector<Vector2i>& outValues) const
+void State::GetNeighborhood(Region2i area, Pixel* outValues, Pixel* outMasks) const
+{
+	for (Vector2i outputPos : area)
+	{
+		auto tryPixel = operator[](outputPos);
+		bool isSet = (tryPixel != nullptr && tryPixel->Value.has_value());
+		*(outValues++) = isSet ? *tryPixel->Value : 0;
+		*(outMasks++) = isSet ? ~Pixel{ 0 } : 0;
+	}
+}
+
+const std::vector<Vector2i>& State::GetBestPixels() const
 {
 	//Find the pixels with the smallest "entropy",
-	//    where "entropy" is the sum of all the different ways the pixel could be given a color
-	//    (i.e. the sum of the values in its "ColorFrequency" dictionary).
+	//    where "entropy" is the sum of all the different ways the pixel could be given a color.
+	//The buckets are kept up to date as pixels change, and empty ones are removed,
+	//    so the first bucket is the answer.
+	static const std::vector<Vector2i> noPixels;
+	return entropyBuckets.empty() ? noPixels : entropyBuckets.begin()->second;
+}
+
+void State::UpdateEntropyBucket(Vector2i pixelPos)
+{
+	const auto& pixel = Output[pixelPos];
+	if (pixel.Value.has_value())
+	{
+		RemoveFromEntropyBucket(pixelPos);
+		return;
+	}
+
+	auto& slot = bucketSlots[pixelPos];
+	if (slot.Index >= 0 && slot.Entropy == pixel.Entropy)
+		return;
+
+	RemoveFromEntropyBucket(pixelPos);
+	auto& bucket = entropyBuckets[pixel.Entropy];
+	slot = { pixel.Entropy, static_cast<int>(bucket.size()) };
+	bucket.push_back(pixelPos);
+}
+void State::RemoveFromEntropyBucket(Vector2i pixelPos)
+{
+	auto& slot = bucketSlots[pixelPos];
+	if (slot.Index < 0)
+		return;
 
-	size_t minEntropy = std::numeric_limits<size_t>::max();
+	//Swap the last element of the bucket into this pixel's place.
+	auto bucket = entropyBuckets.find(slot.Entropy);
+	Vector2i movedPos = bucket->second.back();
+	bucket->second[slot.Index] = movedPos;
+	bucketSlots[movedPos].Index = slot.Index;
+	bucket->second.pop_back();
+	if (bucket->second.empty())
+		entropyBuckets.erase(bucket);
 
-	for (Vector2i outputPos : Region2i(Output.GetDimensions()))
+	slot = { };
+}
+
+void State::RecalculatePixelChances()
+{
+	//Skip any pixels that are outside the output, already set, or listed more than once.
+	Region2i outputRegion(Output.GetDimensions());
+	for (Vector2i& pixelPos : pixelsToRecalculate)
+		Filter(pixelPos);
+	std::erase_if(pixelsToRecalculate, [&](Vector2i pixelPos)
+	{
+		return !outputRegion.Contains(pixelPos) || Output[pixelPos].Value.has_value();
+	});
+	auto isBefore = [&](Vector2i a, Vector2i b) { return GetPixelIndex(a) < GetPixelIndex(b); };
+	std::sort(pixelsToRecalculate.begin(), pixelsToRecalculate.end(), isBefore);
+	pixelsToRecalculate.erase(std::unique(pixelsToRecalculate.begin(), pixelsToRecalculate.end()),
+							  pixelsToRecalculate.end());
+
+	size_t nPixels = pixelsToRecalculate.size(),
+		   nColors = Input.GetPalette().size(),
+		   nThreads = std::max(size_t{ 1 }, std::min(NThreads, nPixels));
+	if (recalculationBuffers.size() < nThreads)
+		recalculationBuffers.resize(nThreads);
+
+	if (nThreads == 1)
 	{
-		auto& pixel = Output[outputPos];
-		if (!pixel.Value.has_value())
+		//Each pixel's calculation only reads 'Output's values,
+		//    so the results can be written in place.
+		for (Vector2i pixelPos : pixelsToRecalculate)
 		{
-			size_t pixelEntropy = std::accumulate(
-				pixel.ColorFrequencies.begin(), pixel.ColorFrequencies.end(),
-				size_t{ 0 },
-				[&](size_t sum, const auto& entry) { return sum + entry.second; }
-			);
-
-			//If it's less than the current minimum, we've found a new minimum.
-			if (pixelEntropy < minEntropy)
-			{
-				minEntropy = pixelEntropy;
-				outValues.clear();
-				outValues.push_back(outputPos);
-			}
-			//Otherwise, we could still have found one with the SAME entropy.
-			else if (pixelEntropy == minEntropy)
+			Output[pixelPos].Entropy = CalculatePixelChances(pixelPos, recalculationBuffers[0],
+															 EditColorFrequencies(pixelPos));
+			UpdateEntropyBucket(pixelPos);
+		}
+	}
+	else
+	{
+		//Split the pixels evenly across the threads, with this thread taking the first share.
+		//The worker threads are kept around between batches.
+		recalculatedFrequencies.resize(nPixels * nColors);
+		recalculatedEntropies.resize(nPixels);
+		auto recalculateShare = [&](size_t threadI)
+		{
+			for (size_t i = (nPixels * threadI) / nThreads; i < (nPixels * (threadI + 1)) / nThreads; ++i)
 			{
-				outValues.push_back(outputPos);
+				recalculatedEntropies[i] = CalculatePixelChances(pixelsToRecalculate[i],
+																 recalculationBuffers[threadI],
+																 &recalculatedFrequencies[i * nColors]);
 			}
+		};
+		if (recalculationWorkers == nullptr || recalculationWorkers->Threads.size() != NThreads - 1)
+		{
+			recalculationWorkers.reset();
+			recalculationWorkers = std::make_unique<RecalculationWorkers>(NThreads - 1);
+		}
+		recalculationWorkers->Run([&](size_t threadI)
+		{
+			//Small batches may not need every thread.
+			if (threadI < nThreads)
+				recalculateShare(threadI);
+		});
+
+		//Copy the results into the output.
+		for (size_t i = 0; i < nPixels; ++i)
+		{
+			Vector2i pixelPos = pixelsToRecalculate[i];
+			std::copy_n(&recalculatedFrequencies[i * nColors], nColors, EditColorFrequencies(pixelPos));
+			Output[pixelPos].Entropy = recalculatedEntropies[i];
+			UpdateEntropyBucket(pixelPos);
 		}
 	}
+
+	pixelsToRecalculate.clear();
 }
 
-void State::RecalculatePixelChances(Vector2i pixelPos)
+size_t State::CalculatePixelChances(Vector2i pixelPos, RecalculationBuffers& buffers,
+								    size_t* outFrequencies) const
 {
-	Region2i outputRegion(Output.GetDimensions());
-
-	auto& inputData = Input;
-    auto& outputArray = Output;
-	Filter(pixelPos);
-
-	//If the position is outside the output, or the pixel is already set,
-	//    nothing needs to be done.
-	if (!outputRegion.Contains(pixelPos) || Output[pixelPos].Value.has_value())
-		return;
-
-	auto& pixel = Output[pixelPos];
+	//Grab every output pixel that a pattern touching this pixel could cover.
+	Region2i neighborhood(pixelPos - Input.MaxPatternSize + 1,
+						  pixelPos + Input.MaxPatternSize);
+	Vector2i neighborhoodSize = neighborhood.GetSize();
+	auto& neighborhoodValues = buffers.NeighborhoodValues;
+	auto& neighborhoodMasks = buffers.NeighborhoodMasks;
+	neighborhoodValues.resize(neighborhoodSize.x * neighborhoodSize.y);
+	neighborhoodMasks.resize(neighborhoodSize.x * neighborhoodSize.y);
+	GetNeighborhood(neighborhood, neighborhoodValues.data(), neighborhoodMasks.data());
+	auto getNeighborhoodIndex = [&](Vector2i outputPos)
+	{
+		Vector2i neighborhoodPos = outputPos - neighborhood.MinInclusive;
+		return neighborhoodPos.x + (neighborhoodPos.y * neighborhoodSize.x);
+	};
+	auto doesFit = [&](const Pattern& pattern, Vector2i outputMinCorner)
+	{
+		size_t i = getNeighborhoodIndex(outputMinCorner);
+		return pattern.DoesFit(&neighborhoodValues[i], &neighborhoodMasks[i], neighborhoodSize.x);
+	};
+
+	//If the output wraps around and is smaller than the neighborhood,
+	//    the neighborhood contains this pixel more than once.
+	auto& pixelIndices = buffers.PixelIndices;
+	pixelIndices.clear();
+	if ((PeriodicX && neighborhoodSize.x > Output.GetWidth()) ||
+		(PeriodicY && neighborhoodSize.y > Output.GetHeight()))
+	{
+		for (Vector2i outputPos : neighborhood)
+		{
+			Vector2i filteredPos = outputPos;
+			Filter(filteredPos);
+			if (filteredPos == pixelPos)
+				pixelIndices.push_back(getNeighborhoodIndex(outputPos));
+		}
+	}
+	else
+	{
+		pixelIndices.push_back(getNeighborhoodIndex(pixelPos));
+	}
 
 	//Find any colors that, if placed here, would cause a violation of the WFC constraint.
-	std::vector<Pixel> badColors;
-    for (const auto& kvp : Input.GetPixelFrequencies())
+    const auto& palette = Input.GetPalette();
+    auto& badColors = buffers.BadColors;
+    badColors.assign(palette.size(), false);
+    for (size_t colorI = 0; colorI < palette.size(); ++colorI)
     {
-        auto color = kvp.first;
-
         //Assume that the color is placed.
-        Output[pixelPos].Value = color;
+        for (size_t pixelI : pixelIndices)
+        {
+            neighborhoodValues[pixelI] = palette[colorI];
+            neighborhoodMasks[pixelI] = ~Pixel{ 0 };
+        }
 
         //Test the constraint: any NxM pattern in the output
         //    appears at least once in the input.
-        Region2i nearbyAffectedPixels(pixelPos - inputData.MaxPatternSize + 1,
+        Region2i nearbyAffectedPixels(pixelPos - Input.MaxPatternSize + 1,
                                       pixelPos + 1);
         for (Vector2i nearbyAffectedPixelPos : nearbyAffectedPixels)
         {
-            bool passed = false;
-            for (size_t patternI = 0; patternI < inputData.GetPatterns().size(); ++patternI)
-            {
-                if (inputData.GetPatterns()[patternI].DoesFit(nearbyAffectedPixelPos, *this))
-                {
-                    passed = true;
-                    break;
-                }
-            }
+            bool passed = std::any_of(Input.GetPatterns().begin(), Input.GetPatterns().end(),
+                                      [&](const Pattern& pattern) { return doesFit(pattern, nearbyAffectedPixelPos); });
             if (!passed)
             {
-                badColors.push_back(color);
+                badColors[colorI] = true;
                 break;
             }
         }
 
         //Undo the color placement.
-        Output[pixelPos].Value = std::nullopt;
+        for (size_t pixelI : pixelIndices)
+        {
+            neighborhoodValues[pixelI] = 0;
+            neighborhoodMasks[pixelI] = 0;
+        }
     }
 
 	//Check which patterns can be applied at which positions around this pixel.
-    pixel.ColorFrequencies.clear();
-    for (size_t patternI = 0; patternI < Input.GetPatterns().size(); ++patternI)
+    std::fill(outFrequencies, outFrequencies + palette.size(), size_t{ 0 });
+    size_t entropy = 0;
+    for (const auto& pattern : Input.GetPatterns())
     {
         //Try placing this pattern everywhere that touches the pixel.
-
-        auto& pattern = Input.GetPatterns()[patternI];
         Vector2i patternSize = pattern.InputDataRegion.GetSize();
         Region2i patternMinCorners(pixelPos - patternSize + 1,
                                     pixelPos + 1);
@@ -228,12 +438,16 @@ void State::RecalculatePixelChances(Vector2i pixelPos)
         for (Vector2i patternMinCorner : patternMinCorners)
         {
             Vector2i patternPos = pixelPos - patternMinCorner;
-            Pixel patternColor = pattern[patternPos];
+            uint32_t patternColorI = Input.GetPatternPaletteIndices()[pattern.PixelsStart + patternPos.x +
+                                                                      (patternPos.y * patternSize.x)];
 
-			bool fits = std::any_of(badColors.begin(), badColors.end(),
-									[&patternColor](const Pixel& p) { return p == patternColor; });
-            if (fits && pattern.DoesFit(patternMinCorner, *this))
-                pixel.ColorFrequencies[patternColor] += pattern.Frequency;
+            if (badColors[patternColorI] && doesFit(pattern, patternMinCorner))
+            {
+                outFrequencies[patternColorI] += pattern.Frequency;
+                entropy += pattern.Frequency;
+            }
         }
     }
-}
\ No newline at end of file
+
+    return entropy;
+}
@@ -0,0 +1,455 @@
+#include "../../include/Simple/WaveState.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace WFC;
+using namespace WFC::Simple;
+
+
+WaveState::WaveState(const InputData& input, Vector2i outputSize,
+                     unsigned int seed, bool periodicX, bool periodicY, size_t violationClearSize)
+    : Input(input), Output(outputSize),
+      PeriodicX(periodicX), PeriodicY(periodicY),
+      ViolationClearSize(violationClearSize),
+      rng(seed)
+{
+    for (const auto& pattern : Input.GetPatterns())
+        patternSizes.push_back(pattern.InputDataRegion.GetSize());
+
+    BuildCompatibilityTables();
+    Reset(outputSize);
+}
+
+void WaveState::BuildCompatibilityTables()
+{
+    size_t nPatterns = patternSizes.size();
+
+    //Pick the neighbor offsets to propagate through.
+    neighborOffsets.clear();
+    bool allSameSize = std::all_of(patternSizes.begin(), patternSizes.end(),
+                                   [&](Vector2i size) { return size == patternSizes[0]; });
+    if (allSameSize)
+    {
+        neighborOffsets = { Vector2i(-1, 0), Vector2i(1, 0),
+                            Vector2i(0, -1), Vector2i(0, 1) };
+    }
+    else
+    {
+        Vector2i maxOffset = Input.MaxPatternSize - 1;
+        for (Vector2i offset : Region2i(-maxOffset, maxOffset + 1))
+            if (offset != Vector2i())
+                neighborOffsets.push_back(offset);
+    }
+    oppositeOffsets.resize(neighborOffsets.size());
+    for (size_t offsetI = 0; offsetI < neighborOffsets.size(); ++offsetI)
+    {
+        oppositeOffsets[offsetI] = std::find(neighborOffsets.begin(), neighborOffsets.end(),
+                                             -neighborOffsets[offsetI]) -
+                                   neighborOffsets.begin();
+    }
+
+    //For every pair of patterns and every offset, check whether their overlap agrees.
+    compatiblePatterns.clear();
+    compatiblePatterns.resize(nPatterns * neighborOffsets.size(), PatternSet(nPatterns));
+    for (size_t patternI = 0; patternI < nPatterns; ++patternI)
+    {
+        Vector2i patternSize = patternSizes[patternI];
+        for (size_t offsetI = 0; offsetI < neighborOffsets.size(); ++offsetI)
+        {
+            Vector2i offset = neighborOffsets[offsetI];
+            auto& compatibles = compatiblePatterns[(patternI * neighborOffsets.size()) + offsetI];
+            for (size_t otherI = 0; otherI < nPatterns; ++otherI)
+            {
+                //Get the overlap, in this pattern's coordinates.
+                Region2i overlap(Vector2i(Math::Max(0, offset.x), Math::Max(0, offset.y)),
+                                 Vector2i(Math::Min(patternSize.x, offset.x + patternSizes[otherI].x),
+                                          Math::Min(patternSize.y, offset.y + patternSizes[otherI].y)));
+
+                bool agrees = true;
+                for (Vector2i patternPos : overlap)
+                {
+                    if (GetPatternPixel(patternI, patternPos) != GetPatternPixel(otherI, patternPos - offset))
+                    {
+                        agrees = false;
+                        break;
+                    }
+                }
+
+                if (agrees)
+                    compatibles.Add(otherI);
+            }
+        }
+    }
+}
+
+void WaveState::Reset(Vector2i newOutputSize)
+{
+    size_t nPatterns = patternSizes.size();
+
+    Output.Reset(newOutputSize.x, newOutputSize.y, std::nullopt);
+    fixedPixels.Reset(newOutputSize.x, newOutputSize.y, std::nullopt);
+    anyFixedPixels = false;
+
+    //Each cell starts with every pattern that fits inside the output.
+    initialCells.Reset(newOutputSize.x, newOutputSize.y);
+    for (Vector2i cellPos : Region2i(newOutputSize))
+    {
+        auto& cell = initialCells[cellPos];
+        cell = PatternSet(nPatterns);
+        for (size_t patternI = 0; patternI < nPatterns; ++patternI)
+        {
+            Vector2i patternMax = cellPos + patternSizes[patternI];
+            if ((PeriodicX | (patternMax.x <= newOutputSize.x)) &
+                (PeriodicY | (patternMax.y <= newOutputSize.y)))
+            {
+                cell.Add(patternI);
+            }
+        }
+    }
+    cells = initialCells;
+
+    entropyBuckets.clear();
+    entropyBuckets.resize(nPatterns + 1);
+    bucketSlots.Reset(newOutputSize.x, newOutputSize.y, BucketSlot());
+    minEntropyBucket = 0;
+    for (Vector2i cellPos : Region2i(newOutputSize))
+        UpdateCell(cellPos);
+
+    propagationQueue.clear();
+    isQueued.Reset(newOutputSize.x, newOutputSize.y, false);
+    supportBuffer = PatternSet(nPatterns);
+    optionWeightSumsBuffer.reserve(nPatterns);
+    optionValuesBuffer.reserve(nPatterns);
+}
+
+bool WaveState::Filter(Vector2i& pos) const
+{
+    pos.x = (PeriodicX ? Math::PositiveModulo(pos.x, Output.GetWidth()) : pos.x);
+    pos.y = (PeriodicY ? Math::PositiveModulo(pos.y, Output.GetHeight()) : pos.y);
+    return Region2i(Output.GetDimensions()).Contains(pos);
+}
+
+std::optional<bool> WaveState::Iterate(Vector2i& out_changedPos, std::vector<Vector2i>& out_failedAt)
+{
+	//Get the cells that are closest to being certain.
+    const auto& lowestEntropyCellPoses = GetBestCells();
+
+	//If all cells are aleady set, we're done.
+	if (lowestEntropyCellPoses.size() == 0)
+		return true;
+
+	//If any cells are impossible to solve, handle it.
+	if (cells[lowestEntropyCellPoses[0]].IsEmpty())
+	{
+        out_changedPos = Vector2i(-1, -1);
+        return HandleViolations(out_failedAt);
+	}
+
+	//Pick one of these cells at random to fill in.
+    //As with 'Tiled::State', "rng() % count" is close enough to uniform.
+    Vector2i chosenCellPos = lowestEntropyCellPoses[rng() % lowestEntropyCellPoses.size()];
+    auto& chosenCell = cells[chosenCellPos];
+
+    //Pick a pattern based on how often each one appears in the input.
+    optionValuesBuffer.clear();
+    optionWeightSumsBuffer.clear();
+    uint64_t totalWeight = 0;
+    for (size_t patternI : chosenCell)
+    {
+        totalWeight += Input.GetPatterns()[patternI].Frequency;
+        optionValuesBuffer.push_back(patternI);
+        optionWeightSumsBuffer.push_back(totalWeight);
+    }
+    uint64_t chosenWeight = rng() % totalWeight;
+    size_t chosenOptionI = std::upper_bound(optionWeightSumsBuffer.begin(), optionWeightSumsBuffer.end(),
+                                            chosenWeight) -
+                           optionWeightSumsBuffer.begin();
+
+	//Finally set the cell and propagate it.
+    chosenCell.Clear();
+    chosenCell.Add(optionValuesBuffer[chosenOptionI]);
+    UpdateCell(chosenCellPos);
+    QueuePropagation(chosenCellPos);
+
+    out_changedPos = chosenCellPos;
+    if (!Propagate())
+        return HandleViolations(out_failedAt);
+	return std::nullopt;
+}
+std::optional<bool> WaveState::HandleViolations(std::vector<Vector2i>& out_failedAt)
+{
+    //The cells with no patterns left are in the lowest bucket.
+    const auto& violatingCells = GetBestCells();
+    WFCPP_ASSERT(!violatingCells.empty() && cells[violatingCells[0]].IsEmpty());
+
+    //Either clear out the violating cells, or give up.
+    if (ViolationClearSize == 0)
+    {
+        out_failedAt = violatingCells;
+        return false;
+    }
+
+    //Clearing changes the entropy buckets, so copy the violating cells first.
+    std::vector<Vector2i> violatingCellPoses = violatingCells;
+    for (Vector2i cellPos : violatingCellPoses)
+    {
+        //An earlier clear may have already taken care of this cell.
+        if (!cells[cellPos].IsEmpty())
+            continue;
+
+        //If the cells around the cleared area can't be made to agree again,
+        //    keep clearing a bigger area until it covers the whole output.
+        //If even that fails, the pixels given to "SetPixel()" can't all be satisfied.
+        size_t clearScale = ViolationClearSize;
+        while (!ClearArea(cellPos, clearScale))
+        {
+            Vector2i halfClearSize = (Input.MaxPatternSize * (int)clearScale) / 2;
+            if (halfClearSize.x >= Output.GetWidth() && halfClearSize.y >= Output.GetHeight())
+            {
+                out_failedAt = GetBestCells();
+                return false;
+            }
+            clearScale *= 2;
+        }
+    }
+
+    return std::nullopt;
+}
+
+bool WaveState::SetPixel(Vector2i pixelPos, Pixel value)
+{
+    if (!Filter(pixelPos))
+        return true;
+
+    //Remember the pixel, so that clearing an area around it doesn't undo this.
+    fixedPixels[pixelPos] = value;
+    anyFixedPixels = true;
+
+    //Check every cell whose patterns could cover this pixel.
+    for (Vector2i patternPos : Region2i(Input.MaxPatternSize))
+    {
+        Vector2i cellPos = pixelPos - patternPos;
+        if (Filter(cellPos))
+            RemoveDisagreeingPatterns(cellPos, patternPos, value);
+    }
+
+    return Propagate();
+}
+void WaveState::RemoveDisagreeingPatterns(Vector2i cellPos, Vector2i patternPos, Pixel value)
+{
+    auto& cell = cells[cellPos];
+    supportBuffer.Clear();
+    for (size_t patternI : cell)
+    {
+        Vector2i patternSize = patternSizes[patternI];
+        if ((patternPos.x < patternSize.x) & (patternPos.y < patternSize.y) &&
+            GetPatternPixel(patternI, patternPos) != value)
+        {
+            supportBuffer.Add(patternI);
+        }
+    }
+
+    if (cell.Remove(supportBuffer) > 0)
+    {
+        UpdateCell(cellPos);
+        QueuePropagation(cellPos);
+    }
+}
+
+void WaveState::QueuePropagation(Vector2i cellPos)
+{
+    if (!isQueued[cellPos])
+    {
+        isQueued[cellPos] = true;
+        propagationQueue.push_back(cellPos);
+    }
+}
+bool WaveState::Propagate()
+{
+    auto giveUp = [&]()
+    {
+        for (Vector2i cellPos : propagationQueue)
+            isQueued[cellPos] = false;
+        propagationQueue.clear();
+        return false;
+    };
+
+    size_t nOffsets = neighborOffsets.size();
+    while (!propagationQueue.empty())
+    {
+        Vector2i cellPos = propagationQueue.back();
+        propagationQueue.pop_back();
+        isQueued[cellPos] = false;
+
+        const auto& cell = cells[cellPos];
+        if (cell.IsEmpty())
+            return giveUp();
+
+        for (size_t offsetI = 0; offsetI < nOffsets; ++offsetI)
+        {
+            //Cells outside the output, or that never had any patterns, are ignored.
+            Vector2i neighborPos = cellPos + neighborOffsets[offsetI];
+            if (!Filter(neighborPos) || initialCells[neighborPos].IsEmpty())
+                continue;
+            auto& neighbor = cells[neighborPos];
+
+            //Remove every pattern from the neighbor that doesn't agree with
+            //    at least one of this cell's patterns.
+            //When this cell has few patterns, it's faster to collect everything they allow.
+            //Otherwise, it's faster to check the neighbor's patterns one at a time.
+            size_t nRemoved;
+            if (cell.Size() * cell.GetWords().size() <= neighbor.Size())
+            {
+                supportBuffer.Clear();
+                for (size_t patternI : cell)
+                {
+                    supportBuffer.Add(compatiblePatterns[(patternI * nOffsets) + offsetI]);
+                    if (supportBuffer.Size() == supportBuffer.GetCapacity())
+                        break;
+                }
+                nRemoved = neighbor.Intersect(supportBuffer);
+            }
+            else
+            {
+                size_t oppositeOffsetI = oppositeOffsets[offsetI];
+                supportBuffer.Clear();
+                for (size_t neighborPatternI : neighbor)
+                    if (!cell.Intersects(compatiblePatterns[(neighborPatternI * nOffsets) + oppositeOffsetI]))
+                        supportBuffer.Add(neighborPatternI);
+                nRemoved = neighbor.Remove(supportBuffer);
+            }
+
+            if (nRemoved == 0)
+                continue;
+            UpdateCell(neighborPos);
+
+            if (neighbor.IsEmpty())
+                return giveUp();
+            QueuePropagation(neighborPos);
+        }
+    }
+
+    return true;
+}
+
+void WaveState::UpdateCell(Vector2i cellPos)
+{
+    if (initialCells[cellPos].IsEmpty())
+        return;
+
+    const auto& cell = cells[cellPos];
+    size_t newBucket = cell.Size();
+
+    //Cells with exactly one pattern are done; write that pattern to the output.
+    if (newBucket == 1)
+    {
+        RemoveFromEntropyBucket(cellPos);
+
+        size_t patternI = cell.First();
+        for (Vector2i patternPos : Region2i(patternSizes[patternI]))
+        {
+            Vector2i pixelPos = cellPos + patternPos;
+            if (Filter(pixelPos))
+                Output[pixelPos] = GetPatternPixel(patternI, patternPos);
+        }
+        return;
+    }
+
+    auto& slot = bucketSlots[cellPos];
+    if (slot.Bucket == static_cast<int>(newBucket))
+        return;
+
+    RemoveFromEntropyBucket(cellPos);
+    slot = { static_cast<int>(newBucket), static_cast<int>(entropyBuckets[newBucket].size()) };
+    entropyBuckets[newBucket].push_back(cellPos);
+    minEntropyBucket = Math::Min(minEntropyBucket, newBucket);
+}
+void WaveState::RemoveFromEntropyBucket(Vector2i cellPos)
+{
+    auto& slot = bucketSlots[cellPos];
+    if (slot.Bucket < 0)
+        return;
+
+    //Swap the last element of the bucket into this cell's place.
+    auto& bucket = entropyBuckets[slot.Bucket];
+    Vector2i movedPos = bucket.back();
+    bucket[slot.Index] = movedPos;
+    bucketSlots[movedPos].Index = slot.Index;
+    bucket.pop_back();
+
+    slot = { };
+}
+
+const std::vector<Vector2i>& WaveState::GetBestCells()
+{
+    while (minEntropyBucket < entropyBuckets.size() - 1 &&
+           entropyBuckets[minEntropyBucket].empty())
+    {
+        minEntropyBucket += 1;
+    }
+    return entropyBuckets[minEntropyBucket];
+}
+
+bool WaveState::ClearArea(Vector2i center, size_t clearScale)
+{
+	Vector2i clearSize = Input.MaxPatternSize * (int)clearScale,
+			 halfClearSize = clearSize / 2;
+	Region2i regionToClear(center - halfClearSize,
+						   center + halfClearSize + 1);
+
+    //The cells around the cleared ones may have been narrowed because of them,
+    //    so start a pattern's width of those over too, unless they're already down to one pattern.
+    Region2i regionToReset(regionToClear.MinInclusive - Input.MaxPatternSize,
+                           regionToClear.MaxExclusive + Input.MaxPatternSize);
+    for (Vector2i cellPos : regionToReset)
+    {
+        bool isCleared = regionToClear.Contains(cellPos);
+        if (Filter(cellPos) && (isCleared || cells[cellPos].Size() != 1))
+            cells[cellPos] = initialCells[cellPos];
+    }
+
+    //Erase the pixels those cells may have written, then let every remaining pattern nearby write its pixels again.
+    Vector2i patternReach = Input.MaxPatternSize - 1;
+    for (Vector2i pixelPos : Region2i(regionToReset.MinInclusive,
+                                      regionToReset.MaxExclusive + patternReach))
+        if (Filter(pixelPos))
+            Output[pixelPos] = std::nullopt;
+    for (Vector2i cellPos : Region2i(regionToReset.MinInclusive - patternReach,
+                                     regionToReset.MaxExclusive + patternReach))
+        if (Filter(cellPos))
+            UpdateCell(cellPos);
+
+    //Bring back the pixels given to "SetPixel()".
+    if (anyFixedPixels)
+    {
+        for (Vector2i cellPos : regionToReset)
+        {
+            if (!Filter(cellPos) || initialCells[cellPos].IsEmpty())
+                continue;
+            for (Vector2i patternPos : Region2i(Input.MaxPatternSize))
+            {
+                Vector2i pixelPos = cellPos + patternPos;
+                if (Filter(pixelPos) && fixedPixels[pixelPos].has_value())
+                    RemoveDisagreeingPatterns(cellPos, patternPos, *fixedPixels[pixelPos]);
+            }
+        }
+    }
+
+    //Narrow the reset cells again, from the cells around them and the ones that kept their pattern.
+    Vector2i reach;
+    for (Vector2i offset : neighborOffsets)
+        reach = Vector2i(Math::Max(reach.x, std::abs(offset.x)),
+                         Math::Max(reach.y, std::abs(offset.y)));
+    for (Vector2i cellPos : Region2i(regionToReset.MinInclusive - reach,
+                                     regionToReset.MaxExclusive + reach))
+    {
+        bool wasReset = regionToReset.Contains(cellPos);
+        if (Filter(cellPos) && !cells[cellPos].IsEmpty() &&
+            (!wasReset || cells[cellPos].Size() == 1))
+        {
+            QueuePropagation(cellPos);
+        }
+    }
+    return Propagate();
+}
@@ -12,13 +12,13 @@ namespace
     I getMax(I a, I b) { return (a > b) ? a : b; }
 }
 
-const TileIDSet InputData::EmptyTileSet;
-
-
 InputData::InputData(const std::vector<Tile>& _tiles)
     : tiles(_tiles)
 
 {
+    for (const auto& tile : tiles)
+        maxWeight = getMax(maxWeight, tile.Weight);
+
     //Collect all tiles that fit each type of edge.
     for (TileID tileID = 0; tileID < (TileID)tiles.size(); ++tileID)
     {
@@ -26,7 +26,26 @@ InputData::InputData(const std::vector<Tile>& _tiles)
         for (uint8_t edgeI = 0; edgeI < 4; ++edgeI)
         {
             auto key = EdgeInstance(tile.Edges[edgeI], (EdgeDirs)edgeI);
-            matchingEdges[key].insert(tileID);
+            auto [found, isNew] = matchingEdgeIndices.try_emplace(key, matchingEdges.size());
+            if (isNew)
+                matchingEdges.emplace_back(tiles.size());
+            matchingEdges[found->second].Add(tileID);
+        }
+    }
+    emptyMatchingEdgesI = matchingEdges.size();
+    matchingEdges.emplace_back(tiles.size());
+
+    //Cache which tiles can go on each side of each tile.
+    allowedNeighborIndices.resize(tiles.size() * 4);
+    for (TileID tileID = 0; tileID < (TileID)tiles.size(); ++tileID)
+    {
+        const auto& tile = tiles[tileID];
+        for (uint8_t edgeI = 0; edgeI < 4; ++edgeI)
+        {
+            auto found = matchingEdgeIndices.find({ tile.Edges[edgeI], GetOppositeEdge((EdgeDirs)edgeI) });
+            allowedNeighborIndices[(tileID * 4) + edgeI] = (found == matchingEdgeIndices.end()) ?
+                                                               emptyMatchingEdgesI :
+                                                               found->second;
         }
     }
 }
\ No newline at end of file
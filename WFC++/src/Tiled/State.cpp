@@ -10,9 +10,7 @@ using namespace WFC::Tiled;
 void State::Reset(Vector2i newOutputSize)
 {
     //To start with, all output tiles will share the same chances of being anything.
-    allTileIDs.clear();
-    for (TileID id = 0; id < (TileID)Input.GetTiles().size(); ++id)
-        allTileIDs.insert(id);
+    allTileIDs = TileIDSet(Input.GetTiles().size(), true);
 
 	//Re-initialize the output array.
     Output.Reset(newOutputSize.x, newOutputSize.y);
@@ -22,6 +20,46 @@ void State::Reset(Vector2i newOutputSize)
         oTile.Value = std::nullopt;
         oTile.PossibleTiles = allTileIDs;
     }
+
+    //Every output tile starts in the highest-entropy bucket.
+    //With weighted entropy, each tile contributes between 1 and "entropyLevels",
+    //    scaled down from its weight if the weights are too large to use directly.
+    size_t nTiles = Input.GetTiles().size();
+    uint64_t maxWeight = Input.GetMaxWeight(),
+             entropyLevels = Max(size_t{ 1 }, MaxEntropyBuckets / Max(nTiles, size_t{ 1 }));
+    tileEntropies.resize(nTiles);
+    size_t maxEntropy = 0;
+    for (TileID tileID = 0; tileID < (TileID)nTiles; ++tileID)
+    {
+        uint64_t weightDeficit = maxWeight - Input.GetTiles()[tileID].Weight;
+        if (!WeightedEntropy)
+            tileEntropies[tileID] = 1;
+        else if (maxWeight < entropyLevels)
+            tileEntropies[tileID] = static_cast<size_t>(weightDeficit + 1);
+        else
+            tileEntropies[tileID] = static_cast<size_t>(1 + ((weightDeficit * (entropyLevels - 1)) / maxWeight));
+        maxEntropy += tileEntropies[tileID];
+    }
+    entropyBuckets.clear();
+    entropyBuckets.resize(maxEntropy + 1);
+    bucketSlots.Reset(newOutputSize.x, newOutputSize.y);
+    auto& fullBucket = entropyBuckets.back();
+    for (Vector2i pos : Region2i(Output.GetDimensions()))
+    {
+        bucketSlots[pos] = { static_cast<int>(entropyBuckets.size() - 1),
+                             static_cast<int>(fullBucket.size()) };
+        fullBucket.push_back(pos);
+    }
+    minEntropyBucket = 0;
+
+    optionValuesBuffer.reserve(nTiles);
+    optionWeightSumsBuffer.reserve(nTiles);
+
+    supportBuffer = TileIDSet(nTiles);
+    propagationQueue.clear();
+    rebuildMarks.Reset(newOutputSize.x, newOutputSize.y, 0);
+    rebuildMark = 0;
+    ForgetHistory();
 }
 
 std::optional<bool> State::Iterate(Vector2i& out_changedPos, std::vector<Vector2i>& out_failedAt)
@@ -31,35 +69,41 @@ std::optional<bool> State::Iterate(Vector2i& out_changedPos, std::vector<Vector2
     Region2i outputRegion(Output.GetDimensions());
 
 	//Get the tiles that are closest to being certain.
-    std::vector<Vector2i> lowestEntropyTilePoses;
-	GetBestTiles(lowestEntropyTilePoses);
+    const auto& lowestEntropyTilePoses = GetBestTiles();
 
 	//If all tiles are aleady set, we're done.
 	if (lowestEntropyTilePoses.size() == 0)
 		return true;
 
 	//If some tiles are impossible to solve, handle it.
-	size_t entropy = Output[lowestEntropyTilePoses[0]].PossibleTiles.size();
+	size_t entropy = Output[lowestEntropyTilePoses[0]].PossibleTiles.Size();
 	if (entropy == 0)
 	{
-		//Either clear out the area to try again, or give up.
+        //First try undoing the most recent placements.
+        if (Backtrack())
+        {
+            out_changedPos = Vector2i(-1, -1);
+            return std::nullopt;
+        }
+
+		//Otherwise, either clear out the area to try again, or give up.
 		if (ClearSize > 0)
 		{
             //Clear the area.
-            std::unordered_set<Vector2i> affectedPoses;
-            for (const auto& tilePos : lowestEntropyTilePoses)
-                ClearArea(tilePos, affectedPoses);
+            //Clearing changes the entropy buckets, so copy the unsolvable tiles first.
+            clearCentersBuffer.assign(lowestEntropyTilePoses.begin(), lowestEntropyTilePoses.end());
+            for (const auto& tilePos : clearCentersBuffer)
+                RebuildTileChances(ClearArea(tilePos));
 
-            //Recalculate output tiles that are affected by this.
-            for (auto affectedPos : affectedPoses)
-                RecalculateTileChances(affectedPos);
+            //The undo history may refer to tiles that were just cleared.
+            ForgetHistory();
 
             out_changedPos = Vector2i(-1, -1);
             return std::nullopt;
 		}
 		else
 		{
-			out_failedAt = std::move(lowestEntropyTilePoses);
+			out_failedAt = lowestEntropyTilePoses;
 			return false;
 		}
 	}
@@ -75,57 +119,224 @@ std::optional<bool> State::Iterate(Vector2i& out_changedPos, std::vector<Vector2
 	//Pick a tile randomly, but based on their weights.
     TileID chosenTileID;
 	//If there's only one possible tile, this is easy.
-	if (chosenTile.PossibleTiles.size() == 1)
+	if (chosenTile.PossibleTiles.Size() == 1)
 	{
-        for (auto tile : chosenTile.PossibleTiles)
-            chosenTileID = tile;
+        chosenTileID = chosenTile.PossibleTiles.First();
 	}
 	//Otherwise, make a weighted random choice.
 	else
 	{
-        //Get a list of the values and of their corresonding weights.
-        std::vector<TileID> optionValues;
-        std::vector<uint32_t> optionWeights;
+        //Get a list of the values and the running total of their weights.
+        optionValuesBuffer.clear();
+        optionWeightSumsBuffer.clear();
+        uint64_t totalWeight = 0;
         for (TileID tileOptionID : chosenTile.PossibleTiles)
         {
-            const Tile& tileOption = Input.GetTiles()[tileOptionID];
-            optionValues.push_back(tileOptionID);
-            optionWeights.push_back(tileOption.Weight);
+            totalWeight += Input.GetTiles()[tileOptionID].Weight;
+            optionValuesBuffer.push_back(tileOptionID);
+            optionWeightSumsBuffer.push_back(totalWeight);
         }
 
-		//Plug that into the RNG.
-		std::discrete_distribution<size_t> distribution(optionWeights.begin(), optionWeights.end());
-		chosenTileID = optionValues[distribution(rng)];
+        //Pick a point along the total weight, and find the tile it lands in.
+        //If every weight is 0, fall back to a uniform choice.
+        size_t chosenOptionI;
+        if (totalWeight == 0)
+        {
+            chosenOptionI = rng() % optionValuesBuffer.size();
+        }
+        else
+        {
+            uint64_t chosenWeight = rng() % totalWeight;
+            chosenOptionI = std::upper_bound(optionWeightSumsBuffer.begin(), optionWeightSumsBuffer.end(),
+                                             chosenWeight) -
+                            optionWeightSumsBuffer.begin();
+        }
+		chosenTileID = optionValuesBuffer[chosenOptionI];
 	}
 
 	//Finally, set the pixel.
-	SetTile(chosenTilePos, chosenTileID);
+    decisions.push_back({ chosenTilePos, chosenTileID, trail.size() });
+    PlaceTile(chosenTilePos, chosenTileID, false);
+    Propagate();
     out_changedPos = chosenTilePos;
 
+    //If this is further than the algorithm has gotten before, allow more backtracking.
+    size_t depth = nForgottenDecisions + decisions.size();
+    if (depth > deepestDecision)
+    {
+        deepestDecision = depth;
+        backtracksLeft = MaxBacktracks;
+    }
+    TrimHistory();
+
 	return std::nullopt;
 }
 
 void State::SetTile(Vector2i tilePos, TileID value, bool permanent)
 {
-    //Set the pixel.
+    //If the tile wasn't already possible here (e.x. it replaces another tile),
+    //    its neighbors may have been narrowed too far, so recalculate them.
+    bool wasPossible = Output[tilePos].PossibleTiles.Contains(value);
+
+    PlaceTile(tilePos, value, permanent);
+    if (wasPossible)
+        Propagate();
+    else
+        RebuildTileChances(Region2i(tilePos, tilePos + 1));
+
+    //Backtracking shouldn't undo this tile.
+    ForgetHistory();
+}
+
+void State::PlaceTile(Vector2i tilePos, TileID value, bool permanent)
+{
+    PushTrail(tilePos);
+
     auto& outTile = Output[tilePos];
-    outTile.PossibleTiles.clear();
-    outTile.PossibleTiles.insert(value);
+    outTile.PossibleTiles.Clear();
+    outTile.PossibleTiles.Add(value);
     outTile.Value = value;
     outTile.IsDeletable = !permanent;
+    RemoveFromEntropyBucket(tilePos);
+
+    propagationQueue.push_back(tilePos);
+}
+
+bool State::Propagate()
+{
+    while (!propagationQueue.empty())
+    {
+        Vector2i tilePos = propagationQueue.back();
+        propagationQueue.pop_back();
+
+        const auto& tile = Output[tilePos];
+        if (tile.PossibleTiles.IsEmpty())
+        {
+            propagationQueue.clear();
+            return false;
+        }
+
+        for (int edgeI = 0; edgeI < 4; ++edgeI)
+        {
+            EdgeDirs edge = (EdgeDirs)edgeI;
+
+            //Set tiles and nonexistent tiles are left alone.
+            Vector2i neighborPos = tilePos + GetEdgeDirection(edge);
+            if (!IsValidPos(neighborPos))
+                continue;
+            neighborPos = Filter(neighborPos);
+            auto& neighbor = Output[neighborPos];
+            if (neighbor.IsSet())
+                continue;
+
+            //Find every tile that can go next to at least one of this tile's possibilities.
+            supportBuffer.Clear();
+            for (TileID tileID : tile.PossibleTiles)
+            {
+                supportBuffer.Add(Input.GetAllowedNeighbors(tileID, edge));
+                if (supportBuffer.Size() == supportBuffer.GetCapacity())
+                    break;
+            }
+
+            //Remove everything else from the neighbor.
+            //If nothing was removed, it doesn't need to be logged or propagated further.
+            PushTrail(neighborPos);
+            if (neighbor.PossibleTiles.Intersect(supportBuffer) == 0)
+            {
+                trail.pop_back();
+                trailWords.resize(trailWords.size() - neighbor.PossibleTiles.GetWords().size());
+                continue;
+            }
+            UpdateEntropyBucket(neighborPos);
+
+            if (neighbor.PossibleTiles.IsEmpty())
+            {
+                propagationQueue.clear();
+                return false;
+            }
+            propagationQueue.push_back(neighborPos);
+        }
+    }
 
-    //Update adjacent tiles.
-    if (PeriodicX | (tilePos.x > 0))
-        RecalculateTileChances(Filter(tilePos.LessX()));
-    if (PeriodicY | (tilePos.y > 0))
-        RecalculateTileChances(Filter(tilePos.LessY()));
-    if (PeriodicX | (tilePos.x < Output.GetWidth() - 1))
-        RecalculateTileChances(Filter(tilePos.MoreX()));
-    if (PeriodicY | (tilePos.y < Output.GetHeight() - 1))
-        RecalculateTileChances(Filter(tilePos.MoreY()));
+    return true;
 }
 
-void State::ClearArea(Vector2i center, std::unordered_set<Vector2i>& out_affectedPoses)
+bool State::Backtrack()
+{
+    if (decisions.empty() || backtracksLeft == 0)
+        return false;
+    backtracksLeft -= 1;
+
+    //Undo the most recent placement and everything that followed from it.
+    Decision decision = decisions.back();
+    decisions.pop_back();
+    UndoTrail(decision.TrailStart);
+
+    //That placement led to a contradiction, so rule it out.
+    //This is logged as part of the previous placement, so undoing that one undoes this too.
+    PushTrail(decision.Pos);
+    Output[decision.Pos].PossibleTiles.Remove(decision.Tile);
+    UpdateEntropyBucket(decision.Pos);
+    propagationQueue.push_back(decision.Pos);
+    Propagate();
+
+    return true;
+}
+
+void State::PushTrail(Vector2i tilePos)
+{
+    const auto& tile = Output[tilePos];
+    trail.push_back({ tilePos, tile.Value });
+
+    const auto& words = tile.PossibleTiles.GetWords();
+    trailWords.insert(trailWords.end(), words.begin(), words.end());
+}
+void State::UndoTrail(size_t newSize)
+{
+    size_t nWords = allTileIDs.GetWords().size();
+    for (size_t entryI = trail.size(); entryI > newSize; --entryI)
+    {
+        const auto& entry = trail[entryI - 1];
+        auto& tile = Output[entry.Pos];
+        tile.Value = entry.Value;
+        tile.PossibleTiles.SetWords(trailWords.data() + ((entryI - 1) * nWords));
+        UpdateEntropyBucket(entry.Pos);
+    }
+
+    trail.resize(newSize);
+    trailWords.resize(newSize * nWords);
+}
+void State::ForgetHistory()
+{
+    trail.clear();
+    trailWords.clear();
+    decisions.clear();
+    nForgottenDecisions = 0;
+    deepestDecision = 0;
+    backtracksLeft = 0;
+}
+void State::TrimHistory()
+{
+    //Let the history grow to twice the needed size before trimming it,
+    //    so the cost of shifting everything down is spread out.
+    if (decisions.size() <= MaxBacktracks * 2)
+        return;
+
+    size_t nDropped = decisions.size() - MaxBacktracks;
+    size_t nDroppedEntries = (nDropped < decisions.size()) ?
+                                 decisions[nDropped].TrailStart :
+                                 trail.size();
+    size_t nWords = allTileIDs.GetWords().size();
+
+    trail.erase(trail.begin(), trail.begin() + nDroppedEntries);
+    trailWords.erase(trailWords.begin(), trailWords.begin() + (nDroppedEntries * nWords));
+    decisions.erase(decisions.begin(), decisions.begin() + nDropped);
+    for (auto& decision : decisions)
+        decision.TrailStart -= nDroppedEntries;
+    nForgottenDecisions += nDropped;
+}
+
+Region2i State::ClearArea(Vector2i center)
 {
     //Calculate the region to be cleared.
     Region2i clearRegion(center - (int)ClearSize,
@@ -149,83 +360,127 @@ void State::ClearArea(Vector2i center, std::unordered_set<Vector2i>& out_affecte
     for (auto posToClear : clearRegion)
     {
         posToClear = Filter(posToClear);
-        if (out_affectedPoses.insert(posToClear).second)
+        auto& tile = Output[posToClear];
+        if (tile.IsDeletable)
         {
-            auto& tile = Output[posToClear];
-            if (tile.IsDeletable)
-            {
-                tile.Value = std::nullopt;
-                tile.PossibleTiles = allTileIDs;
-            }
-            else
-            {
-                out_affectedPoses.erase(posToClear);
-            }
+            tile.Value = std::nullopt;
+            tile.PossibleTiles = allTileIDs;
+            UpdateEntropyBucket(posToClear);
         }
     }
 
-    //Add the neighbors of the region to the list of affected tiles.
-    bool allowMinX = (PeriodicX | (clearRegion.MinInclusive.x > 0)),
-         allowMaxX = (PeriodicX | (clearRegion.MaxExclusive.x < Output.GetWidth())),
-         allowMinY = (PeriodicY | (clearRegion.MinInclusive.y > 0)),
-         allowMaxY = (PeriodicY | (clearRegion.MaxExclusive.y < Output.GetHeight()));
-    Vector2i minEdge = Filter(clearRegion.MinInclusive - 1),
-             maxEdge = Filter(clearRegion.MaxExclusive);
-    //Left and right edges:
-    for (int y = clearRegion.MinInclusive.y; y < clearRegion.MaxExclusive.y; ++y)
+    return clearRegion;
+}
+void State::RebuildTileChances(Region2i region)
+{
+    //Narrowing only spreads through unset tiles, so anything the region used to be
+    //    could have affected every unset tile connected to it, up to the set tiles around them.
+    //It also can't have passed through a tile that still has every possibility,
+    //    so the search can stop at those.
+    //Recalculate all of those tiles from their set neighbors, then propagate.
+    rebuildMark += 1;
+    if (rebuildMark == 0)
     {
-        if (allowMinX)
-            out_affectedPoses.insert(Filter(Vector2i(minEdge.x, y)));
-        if (allowMaxX)
-            out_affectedPoses.insert(Filter(Vector2i(maxEdge.x, y)));
+        rebuildMarks.Fill(0);
+        rebuildMark = 1;
     }
-    //Top and bottom edges:
-    for (int x = clearRegion.MinInclusive.x; x < clearRegion.MaxExclusive.x; ++x)
+    rebuildQueue.clear();
+    propagationQueue.clear();
+    auto visit = [&](Vector2i tilePos)
     {
-        if (allowMinY)
-            out_affectedPoses.insert(Filter(Vector2i(x, minEdge.y)));
-        if (allowMaxY)
-            out_affectedPoses.insert(Filter(Vector2i(x, maxEdge.y)));
+        if (!IsValidPos(tilePos))
+            return;
+        tilePos = Filter(tilePos);
+        if (Output[tilePos].IsSet() || rebuildMarks[tilePos] == rebuildMark)
+            return;
+        rebuildMarks[tilePos] = rebuildMark;
+        rebuildQueue.push_back(tilePos);
+    };
+
+    //Start from the region and the tiles right next to it, since the region may contain set tiles.
+    for (Vector2i tilePos : Region2i(region.MinInclusive - 1, region.MaxExclusive + 1))
+        visit(tilePos);
+    size_t nStartingTiles = rebuildQueue.size();
+    for (size_t i = 0; i < rebuildQueue.size(); ++i)
+    {
+        Vector2i tilePos = rebuildQueue[i];
+        bool wasNarrowed = Output[tilePos].PossibleTiles.Size() < allTileIDs.Size();
+        RecalculateTileChances(tilePos);
+        if (Output[tilePos].PossibleTiles.Size() < allTileIDs.Size())
+            propagationQueue.push_back(tilePos);
+
+        if (wasNarrowed || i < nStartingTiles)
+            for (int edgeI = 0; edgeI < 4; ++edgeI)
+                visit(tilePos + GetEdgeDirection((EdgeDirs)edgeI));
     }
+
+    Propagate();
 }
 
-void State::GetBestTiles(std::vector<Vector2i>& outValues) const
+const std::vector<Vector2i>& State::GetBestTiles()
 {
 	//Find the output spaces with the smallest "entropy",
 	//    where "entropy" is the sum of all the different tiles the pixel could still become.
 	//    (i.e. the sum of the values in its "PossibleTiles" dictionary).
+    //The buckets are kept up to date as tiles change, so just find the first non-empty one.
+    //Each bucket is only skipped over once before something lands in a lower bucket again,
+    //    so this is amortized O(1).
+    while (minEntropyBucket < entropyBuckets.size() - 1 &&
+           entropyBuckets[minEntropyBucket].empty())
+    {
+        minEntropyBucket += 1;
+    }
+    return entropyBuckets[minEntropyBucket];
+}
 
-    //TODO: Track the min-entropy tiles every time "RecalculateTileChances()" is called, instead of recalculating from scratch here.
+size_t State::GetEntropy(const OutputTile& tile) const
+{
+    if (!WeightedEntropy)
+        return tile.PossibleTiles.Size();
 
-	size_t currentMinEntropy = std::numeric_limits<size_t>::max();
-	for (Vector2i outputPos : Region2i(Output.GetDimensions()))
-	{
-		auto& outTile = Output[outputPos];
-		if (!outTile.IsSet())
-		{
-            //TODO: If a tile has a higher weight, it's more certain to happen. So scale each possible tile's entropy contribution inversely to its weight. This would imply making the entropy a float, but floating-point error is a problem here. So avoid floats by having InputData cache the max weight and do "PossibleTiles.Sum(tile => maxWeight + 1 - tile.Weight)".
-            size_t thisEntropy = outTile.PossibleTiles.size();
-
-			//If it's less than the current minimum, then we've found a new minimum.
-			if (thisEntropy < currentMinEntropy)
-			{
-				currentMinEntropy = thisEntropy;
-				outValues.clear();
-				outValues.push_back(outputPos);
-			}
-			//Otherwise, if it's equal to the current minimum, add it to the list.
-			else if (thisEntropy == currentMinEntropy)
-			{
-				outValues.push_back(outputPos);
-			}
-		}
-	}
+    size_t entropy = 0;
+    for (TileID tileID : tile.PossibleTiles)
+        entropy += tileEntropies[tileID];
+    return entropy;
 }
 
-void State::RecalculateTileChances(Vector2i tilePos)
+void State::UpdateEntropyBucket(Vector2i tilePos)
 {
-    //TODO: I feel like there's room for optimization here.
+    const auto& tile = Output[tilePos];
+    if (tile.IsSet())
+    {
+        RemoveFromEntropyBucket(tilePos);
+        return;
+    }
+
+    int newBucket = static_cast<int>(GetEntropy(tile));
+    auto& slot = bucketSlots[tilePos];
+    if (slot.Bucket == newBucket)
+        return;
+
+    RemoveFromEntropyBucket(tilePos);
+    slot = { newBucket, static_cast<int>(entropyBuckets[newBucket].size()) };
+    entropyBuckets[newBucket].push_back(tilePos);
+    minEntropyBucket = Min(minEntropyBucket, static_cast<size_t>(newBucket));
+}
+void State::RemoveFromEntropyBucket(Vector2i tilePos)
+{
+    auto& slot = bucketSlots[tilePos];
+    if (slot.Bucket < 0)
+        return;
+
+    //Swap the last element of the bucket into this tile's place.
+    auto& bucket = entropyBuckets[slot.Bucket];
+    Vector2i movedPos = bucket.back();
+    bucket[slot.Index] = movedPos;
+    bucketSlots[movedPos].Index = slot.Index;
+    bucket.pop_back();
+
+    slot = { };
+}
 
+void State::RecalculateTileChances(Vector2i tilePos)
+{
 	Region2i outputRegion(Output.GetDimensions());
 
 	tilePos = Filter(tilePos);
@@ -249,17 +504,12 @@ void State::RecalculateTileChances(Vector2i tilePos)
         const auto* neighborTileOutput = (*this)[tilePos + GetEdgeDirection(edge)];
         if (neighborTileOutput == nullptr || !neighborTileOutput->IsSet())
             continue;
-        const auto& neighborTile = Input.GetTiles()[*neighborTileOutput->Value];
 
-        //Get all tiles that fit the neighbor tile at this edge.
+        //Get all tiles that fit the neighbor tile at this edge,
+        //    and remove tiles that don't exist in that set.
         EdgeDirs neighborEdge = GetOppositeEdge(edge);
-        const auto& neighborMatches = Input.GetTilesWithEdge(neighborTile.Edges[neighborEdge],
-                                                             edge);
-
-        //Remove tiles that don't exist in this set.
-        tempTileIdSet = tile.PossibleTiles; //Making a copy
-        for (TileID tileOptionID : tempTileIdSet)
-            if (!neighborMatches.contains(tileOptionID))
-                tile.PossibleTiles.erase(tileOptionID);
+        tile.PossibleTiles.Intersect(Input.GetAllowedNeighbors(*neighborTileOutput->Value, neighborEdge));
     }
+
+    UpdateEntropyBucket(tilePos);
 }
\ No newline at end of file
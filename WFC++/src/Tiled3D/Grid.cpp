@@ -8,22 +8,70 @@ using namespace WFC::Tiled3D;
 
 
 Grid::Grid(const std::vector<Tile>& inputTiles, const Vector3i& outputSize,
-           bool periodicX, bool periodicY, bool periodicZ)
+           bool periodicX, bool periodicY, bool periodicZ,
+           ArrayLayouts cellLayout, PropagationModes propagationMode)
     : InputTiles(inputTiles),
-      NPermutedTiles(std::accumulate(InputTiles.begin(), InputTiles.end(),
-                                     0, [](int sum, const Tile& tile) { return sum + tile.Permutations.Size(); })),
-      Cells(outputSize),
-      PossiblePermutations({ (int)inputTiles.size(), outputSize }),
+      NPermutedTiles(0),
+      Cells(cellLayout, outputSize),
+      PossiblePermutations(cellLayout, { (int)inputTiles.size(), outputSize }),
       IsPeriodicX(periodicX), IsPeriodicY(periodicY), IsPeriodicZ(periodicZ),
-      InitialPossiblePermutations({ (int)inputTiles.size(), outputSize })
+      InitialPossiblePermutations(cellLayout, { (int)inputTiles.size(), outputSize }, TransformSet()),
+      PropagationMode(propagationMode)
 {
     WFCPP_ASSERT(inputTiles.size() < TileIdx_INVALID); //The last index is reserved for [null]
+    WFCPP_ASSERT(static_cast<CellIdx>(Cells.GetNumbStoredElements()) < CellIdx_INVALID);
+
+    //Group together the permutations of each tile which produce the same cube.
+    //Each group is represented by its first permutation.
+    CanonicalPermutations.resize(InputTiles.size());
+    EquivalentPermutations.resize(InputTiles.size());
+    UniformGroupSizes.resize(InputTiles.size());
+    for (int tileI = 0; tileI < (int)InputTiles.size(); ++tileI)
+    {
+        auto& canonicals = CanonicalPermutations[tileI];
+        auto& equivalents = EquivalentPermutations[tileI];
+        for (Transform3D transform : InputTiles[tileI].Permutations)
+        {
+            auto isSameCube = [&](Transform3D canonical)
+            {
+                for (int dirI = 0; dirI < N_DIRECTIONS_3D; ++dirI)
+                {
+                    auto dir = static_cast<Directions3D>(dirI);
+                    if (!(GetFace(tileI, transform, dir) == GetFace(tileI, canonical, dir)))
+                        return false;
+                }
+                return true;
+            };
+            auto canonical = std::find_if(canonicals.begin(), canonicals.end(), isSameCube);
+            if (canonical == canonicals.end())
+            {
+                canonicals.Add(transform);
+                equivalents[TransformSet::ToBitIdx(transform)].Add(transform);
+            }
+            else
+            {
+                equivalents[TransformSet::ToBitIdx(*canonical)].Add(transform);
+            }
+        }
+        //Every member of a group shares the group's set.
+        for (Transform3D canonical : canonicals)
+            equivalents[TransformSet::ToBitIdx(canonical)].ForEach([&](Transform3D member)
+            {
+                equivalents[TransformSet::ToBitIdx(member)] = equivalents[TransformSet::ToBitIdx(canonical)];
+            });
+
+        NPermutedTiles += canonicals.Size();
+        UniformGroupSizes[tileI] = InputTiles[tileI].Permutations.Size() / Math::Max(1, (int)canonicals.Size());
+        for (Transform3D canonical : canonicals)
+            if (GetEquivalentPermutations(tileI, canonical).Size() != UniformGroupSizes[tileI])
+                UniformGroupSizes[tileI] = 0;
+    }
 
     //Set up FaceIndices.
     int32_t nextID = 0;
-    for (const auto& tile : InputTiles)
-        for (const auto& transform : tile.Permutations)
-            for (const auto& face : tile.Data.Faces)
+    for (int tileI = 0; tileI < (int)InputTiles.size(); ++tileI)
+        for (const auto& transform : CanonicalPermutations[tileI])
+            for (const auto& face : InputTiles[tileI].Data.Faces)
                 FaceIndices[transform.ApplyToFace(face)] = nextID++;
     int32_t nFacePermutations = nextID;
 
@@ -31,7 +79,7 @@ Grid::Grid(const std::vector<Tile>& inputTiles, const Vector3i& outputSize,
     MatchingFaces = Array2D<TransformSet>((int)InputTiles.size(), nFacePermutations,
                                           TransformSet());
     for (int tileI = 0; tileI < (int)InputTiles.size(); ++tileI)
-        for (const auto& transform : InputTiles[tileI].Permutations)
+        for (const auto& transform : CanonicalPermutations[tileI])
             for (const auto& face : InputTiles[tileI].Data.Faces)
             {
                 auto transformedFace = transform.ApplyToFace(face);
@@ -40,30 +88,167 @@ Grid::Grid(const std::vector<Tile>& inputTiles, const Vector3i& outputSize,
                 matches.Add(transform);
             }
 
+    //Set up the weight caches for the weighted-entropy heuristic.
+    MaxWeightSum = 0;
+    MaxWeightLogWeightSum = 0;
+    for (int tileI = 0; tileI < (int)InputTiles.size(); ++tileI)
+    {
+        float weight = static_cast<float>(InputTiles[tileI].Weight * UniformGroupSizes[tileI]);
+        TileWeights.push_back(weight);
+        TileWeightLogWeights.push_back((weight > 0) ? (weight * std::log(weight)) : 0.0f);
+
+        auto [weightSum, weightLogWeightSum] = GetWeightSums(tileI, CanonicalPermutations[tileI]);
+        MaxWeightSum += weightSum;
+        MaxWeightLogWeightSum += weightLogWeightSum;
+    }
+    {
+        CellState fullCell;
+        fullCell.WeightSum = MaxWeightSum;
+        fullCell.WeightLogWeightSum = MaxWeightLogWeightSum;
+        MaxWeightedEntropy = fullCell.GetWeightedEntropy();
+    }
+
     //Set up the initial possible permutation set.
-    for (int tileI = 0; tileI < static_cast<int>(InputTiles.size()); ++tileI)
-        for (const Vector3i& cellPos : Region3i(Cells.GetDimensions()))
-            InitialPossiblePermutations[Vector4i(tileI, cellPos)] = InputTiles[tileI].Permutations;
+    InitialPossiblePermutations.ForEach([&](const Vector4i& idx, TransformSet& permutations)
+    {
+        permutations = CanonicalPermutations[idx.x];
+    });
+
+    BuildNeighborTables();
+
+    if (PropagationMode == PropagationModes::Faces)
+    {
+        CellSideFaces.resize(Cells.GetNumbStoredElements());
+        ArePossibilitiesStale.resize(Cells.GetNumbStoredElements(), 0);
+        HasInitialConstraints.resize(Cells.GetNumbStoredElements(), 0);
+        buffer_sideFaces_possibilities.resize(InputTiles.size());
+    }
+
+    //Every cell starts out uninitialized, so the first reset has to touch all of them.
+    size_t nCellBlocks = (Cells.GetNumbStoredElements() + CellBlockSize - 1) / CellBlockSize;
+    DirtyCellBlockBits.resize((nCellBlocks + 63) / 64, 0);
+    for (uint32_t blockI = 0; blockI < nCellBlocks; ++blockI)
+        MarkCellDirty(blockI << CellBlockSizeLog2);
 
     DEBUGMEM_ValidateAll();
     Reset();
 }
+void Grid::BuildNeighborTables()
+{
+    Vector3i size = Cells.GetDimensions();
+    bool isPeriodic[3] = { IsPeriodicX, IsPeriodicY, IsPeriodicZ };
+
+    //Padding cells (in the bricked layout) have no neighbors; they use the first class.
+    std::array<int32_t, N_DIRECTIONS_3D> noNeighbors;
+    noNeighbors.fill(NoNeighborOffset);
+    BoundaryClassNeighborOffsets.assign(1, noNeighbors);
+    CellBoundaryClasses.assign(Cells.GetNumbStoredElements(), 0);
+
+    //There are only a handful of classes (per axis: the two edges, brick boundaries, and everything else),
+    //    so a linear search is fine.
+    auto findClass = [&](const std::array<int32_t, N_DIRECTIONS_3D>& offsets)
+    {
+        auto found = std::find(BoundaryClassNeighborOffsets.begin(), BoundaryClassNeighborOffsets.end(), offsets);
+        if (found == BoundaryClassNeighborOffsets.end())
+        {
+            WFCPP_ASSERT(BoundaryClassNeighborOffsets.size() <= std::numeric_limits<uint8_t>::max());
+            BoundaryClassNeighborOffsets.push_back(offsets);
+            found = BoundaryClassNeighborOffsets.end() - 1;
+        }
+        return static_cast<uint8_t>(found - BoundaryClassNeighborOffsets.begin());
+    };
+
+    for (Vector3i cellPos : Region3i(size))
+    {
+        auto cellIdx = GetCellIdx(cellPos);
+        //Per-cell tile data relies on matching the cell's index.
+        WFCPP_ASSERT(PossiblePermutations.GetIndex(0, cellPos.x, cellPos.y, cellPos.z) ==
+                       static_cast<int>(cellIdx * InputTiles.size()));
+
+        std::array<int32_t, N_DIRECTIONS_3D> offsets;
+        for (int dirI = 0; dirI < N_DIRECTIONS_3D; ++dirI)
+        {
+            auto dir = static_cast<Directions3D>(dirI);
+            auto axis = GetAxisIndex(dir);
+
+            auto neighborPos = cellPos + GetFaceDirection(dir);
+            if (neighborPos[axis] < 0 || neighborPos[axis] >= size[axis])
+            {
+                if (!isPeriodic[axis])
+                {
+                    offsets[dirI] = NoNeighborOffset;
+                    continue;
+                }
+                neighborPos[axis] = IsMin(dir) ? (size[axis] - 1) : 0;
+            }
+
+            offsets[dirI] = static_cast<int32_t>(GetCellIdx(neighborPos)) - static_cast<int32_t>(cellIdx);
+        }
+        CellBoundaryClasses[cellIdx] = findClass(offsets);
+    }
+}
 
 void Grid::Reset()
 {
-    //Set up Cells.
-    CellState startingCellData;
-    startingCellData.NPossibilities = NPermutedTiles;
-    Cells.Fill(startingCellData);
+    //Restore the cells that changed since the last reset to their initial possibilities.
+    //Every other cell is already in that state.
+    auto nStoredCells = static_cast<CellIdx>(Cells.GetNumbStoredElements());
+    size_t nTiles = InputTiles.size();
+    #if WFCPP_DEBUG
+        //Writing to 'Cells' or the possibility arrays directly skips the dirty tracking,
+        //    so make sure every cell outside a dirty block is still in its initial state.
+        for (CellIdx cellIdx = 0; cellIdx < nStoredCells; ++cellIdx)
+        {
+            uint32_t blockI = cellIdx >> CellBlockSizeLog2;
+            if ((DirtyCellBlockBits[blockI >> 6] & (uint64_t{ 1 } << (blockI & 63))) != 0)
+                continue;
+
+            WFCPP_ASSERT(!Cells.GetArray()[cellIdx].IsSet());
+            WFCPP_ASSERT(std::equal(InitialPossiblePermutations.GetArray() + (cellIdx * nTiles),
+                                    InitialPossiblePermutations.GetArray() + ((cellIdx + 1) * nTiles),
+                                    PossiblePermutations.GetArray() + (cellIdx * nTiles)));
+        }
+    #endif
+    for (uint32_t blockI : DirtyCellBlocks)
+    {
+        DirtyCellBlockBits[blockI >> 6] &= ~(uint64_t{ 1 } << (blockI & 63));
+
+        CellIdx firstCellIdx = blockI << CellBlockSizeLog2,
+                endCellIdx = Math::Min(firstCellIdx + CellBlockSize, nStoredCells);
+        //Use the raw arrays, to avoid re-marking these cells as dirty.
+        std::copy(InitialPossiblePermutations.GetArray() + (firstCellIdx * nTiles),
+                  InitialPossiblePermutations.GetArray() + (endCellIdx * nTiles),
+                  PossiblePermutations.GetArray() + (firstCellIdx * nTiles));
+        for (CellIdx cellIdx = firstCellIdx; cellIdx < endCellIdx; ++cellIdx)
+        {
+            auto& cell = Cells.GetArray()[cellIdx];
+            cell = { };
+            if (PropagationMode == PropagationModes::Faces)
+            {
+                CellSideFaces[cellIdx].fill(SideFace_Any);
+                ArePossibilitiesStale[cellIdx] = 0;
+            }
 
-    InitialPossiblePermutations.MemCopyInto(PossiblePermutations.GetArray());
+            const auto* initialPossibilities = InitialPossiblePermutations.GetArray() + (cellIdx * nTiles);
+            for (size_t tileI = 0; tileI < nTiles; ++tileI)
+            {
+                auto [weightSum, weightLogWeightSum] = GetWeightSums(static_cast<int>(tileI), initialPossibilities[tileI]);
+                cell.NPossibilities += initialPossibilities[tileI].Size();
+                cell.WeightSum += weightSum;
+                cell.WeightLogWeightSum += weightLogWeightSum;
+            }
+        }
+    }
+    DirtyCellBlocks.clear();
+    SideFacesCache.clear();
 
     //Clear history.
     ActionHistory.clear();
     StatePreActionHistory.clear();
     //Make sure history buffers have enough space to remember the entire grid history.
     ActionHistory.reserve(Cells.GetNumbElements());
-    StatePreActionHistory.reserve(Cells.GetNumbElements() * (N_DIRECTIONS_3D + 1) * InputTiles.size());
+    if (PropagationMode == PropagationModes::Permutations)
+        StatePreActionHistory.reserve(Cells.GetNumbElements() * (N_DIRECTIONS_3D + 1) * InputTiles.size());
 
     DEBUGMEM_ValidateAll();
 }
@@ -72,11 +257,13 @@ void Grid::Reset()
 std::tuple<Vector3i, Vector3i, std::vector<TransformSet>::const_iterator, std::vector<TransformSet>::const_iterator>
     Grid::ActionHistoryNeighborInfo(int cellHistoryIdx, int neighborI) const
 {
+    WFCPP_ASSERT(PropagationMode == PropagationModes::Permutations);
     Vector3i srcCell = ActionHistory[cellHistoryIdx];
 
+    //The neighbor order matches the order of 'Directions3D', followed by the cell itself.
     Vector3i neighborCell = srcCell;
-    auto [neighborAxis, neighborDir] = ActionHistoryNeighborsData(neighborI);
-    neighborCell[neighborAxis] += neighborDir;
+    if (neighborI < N_DIRECTIONS_3D)
+        neighborCell = std::get<0>(GetNeighbor(srcCell, GetCellIdx(srcCell), static_cast<Directions3D>(neighborI)));
 
     int entriesPerNeighbor = static_cast<int>(InputTiles.size()),
         entriesPerHistoryEntry = entriesPerNeighbor * (N_DIRECTIONS_3D + 1),
@@ -94,15 +281,11 @@ bool Grid::IsLegalPlacement(const Vector3i& cellPos,
 {
     DEBUGMEM_ValidateAll();
 
-    for (const auto& neighborData : GetNeighbors(cellPos))
+    for (const auto& [neighborPos, neighborIdx, mySide] : GetNeighbors(cellPos, GetCellIdx(cellPos)))
     {
-        Vector3i neighborPos;
-        Directions3D mySide;
-        std::tie(neighborPos, mySide) = neighborData;
-
-        if (Cells.IsIndexValid(neighborPos) && Cells[neighborPos].IsSet())
+        if (neighborIdx != CellIdx_INVALID && GetCell(neighborIdx).IsSet())
         {
-            const auto& neighborCell = Cells[neighborPos];
+            const auto& neighborCell = GetCell(neighborIdx);
             auto neighborSide = GetOpposite(mySide);
 
             auto neighborFace = GetFace(neighborCell.ChosenTile,
@@ -113,7 +296,7 @@ bool Grid::IsLegalPlacement(const Vector3i& cellPos,
             auto faceIndex = FaceIndices.at(myRequiredFace);
             Vector2i faceLookup{ tileIdx, faceIndex };
             const auto& faces = MatchingFaces[faceLookup];
-            bool hasFace = faces.Contains(tilePermutation);
+            bool hasFace = faces.Contains(GetCanonicalPermutation(tileIdx, tilePermutation));
             if (!hasFace)
                 return false;
         }
@@ -122,11 +305,25 @@ bool Grid::IsLegalPlacement(const Vector3i& cellPos,
     return true;
 }
 
+const TransformSet* Grid::GetPossiblePermutations(const Vector3i& cellPos)
+{
+    auto cellIdx = GetCellIdx(cellPos);
+    if (PropagationMode == PropagationModes::Faces && ArePossibilitiesStale[cellIdx])
+    {
+        ComputeSideFacePossibilities(GetInitialPossibilities(cellIdx), CellSideFaces[cellIdx],
+                                     GetPossibilities(cellIdx));
+        ArePossibilitiesStale[cellIdx] = 0;
+    }
+    return GetPossibilities(cellIdx);
+}
+
 void Grid::SetCell(Vector3i pos, TileIdx tile, Transform3D tilePermutation,
                    bool isPermanent,
                    Report* report, bool assertLegalPlacement)
 {
     pos = FilterPos(pos);
+    auto cellIdx = GetCellIdx(pos);
+    auto neighbors = GetNeighbors(pos, cellIdx);
 
     if (assertLegalPlacement)
         WFCPP_ASSERT(IsLegalPlacement(pos, tile, tilePermutation));
@@ -135,7 +332,7 @@ void Grid::SetCell(Vector3i pos, TileIdx tile, Transform3D tilePermutation,
     //    then neighbor data is harder to update seamlessly because
     //    it could add tile possibilities as well as remove them.
     //The best and simplest option is to clear this cell so that setting it can only subtract possibliities.
-    auto& cell = Cells[pos];
+    auto& cell = GetCell(cellIdx);
     if (cell.IsSet() && (cell.ChosenTile != tile || cell.ChosenPermutation != tilePermutation))
         ClearCell(pos, report);
     //Note that there's no chance of reallocation, so 'cell' is still valid!
@@ -143,66 +340,70 @@ void Grid::SetCell(Vector3i pos, TileIdx tile, Transform3D tilePermutation,
     if (isPermanent)
     {
         //Bake this constraint into the initial grid state.
+        auto initialPossibilities = GetInitialPossibilities(cellIdx);
         for (int tileID = 0; tileID < InputTiles.size(); ++tileID)
         {
-            Vector4i key{ tileID, pos };
             if (tileID == tile)
-                InitialPossiblePermutations[key] = TransformSet::Combine(tilePermutation);
+                initialPossibilities[tileID] = TransformSet::Combine(GetCanonicalPermutation(tile, tilePermutation));
             else
-                InitialPossiblePermutations[key] = TransformSet::None();
+                initialPossibilities[tileID] = TransformSet::None();
         }
+        if (PropagationMode == PropagationModes::Faces)
+            HasInitialConstraints[cellIdx] = 1;
 
         //Bake this constraint into neighboring cells' initial faces.
-        for (int neighborAxis = 0; neighborAxis < 3; ++neighborAxis)
-            for (int neighborSide = 0; neighborSide < 2; ++neighborSide)
+        for (const auto& [neighborPos, neighborIdx, dir] : neighbors)
+        {
+            if (neighborIdx != CellIdx_INVALID)
             {
-                auto neighborPos = pos;
-                neighborPos[neighborAxis] += (neighborSide * 2) - 1;
-                neighborPos = FilterPos(neighborPos);
-
-                if (Cells.IsIndexValid(neighborPos))
-                {
-                    auto dir = WFC::Tiled3D::MakeDirection3D(neighborSide == 0, neighborAxis);
+                auto cube = InputTiles[tile].Data;
+                cube = tilePermutation.ApplyToCube(cube);
 
-                    auto cube = InputTiles[tile].Data;
-                    cube = tilePermutation.ApplyToCube(cube);
+                auto face = cube.Faces[cube.GetFace(dir)];
 
-                    auto face = cube.Faces[cube.GetFace(dir)];
-
-                    SetFaceInnerImpl(neighborPos, Cells[neighborPos], dir, face.Points, report, false);
-                }
+                SetFaceInnerImpl(neighborPos, neighborIdx, dir, face.Points, report, false);
             }
+        }
 
         //Changing the initial constraints removes all known action history.
         ActionHistory.clear();
         StatePreActionHistory.clear();
     }
+    else if (PropagationMode == PropagationModes::Faces)
+    {
+        //Undoing this only requires knowing which cell it was.
+        ActionHistory.push_back(pos);
+    }
     else
     {
         //Add this event to the action history, so it can be quickly undone later.
+        //The neighbors are stored in the order of 'Directions3D', followed by the cell itself.
         ActionHistory.push_back(pos);
-        for (int neighborI = 0; neighborI < N_DIRECTIONS_3D + 1; ++neighborI)
+        auto pushHistory = [&](CellIdx historyCellIdx)
         {
-            //Get the neighbor cell in our history ordering.
-            auto [neighborAxis, neighborDir] = ActionHistoryNeighborsData(neighborI);
-            auto neighborCellPos = pos;
-            neighborCellPos[neighborAxis] += neighborDir;
-            neighborCellPos = FilterPos(neighborCellPos);
-
-            if (Cells.IsIndexValid(neighborCellPos))
-                for (int inputTileI = 0; inputTileI < InputTiles.size(); ++inputTileI)
-                    StatePreActionHistory.push_back(PossiblePermutations[Vector4i{ inputTileI, neighborCellPos }]);
+            if (historyCellIdx != CellIdx_INVALID)
+            {
+                auto possibilities = GetPossibilities(historyCellIdx);
+                StatePreActionHistory.insert(StatePreActionHistory.end(),
+                                             possibilities, possibilities + InputTiles.size());
+            }
             else
-                for (int inputTileI = 0; inputTileI < InputTiles.size(); ++inputTileI)
-                    StatePreActionHistory.emplace_back();
-        }
+            {
+                StatePreActionHistory.resize(StatePreActionHistory.size() + InputTiles.size());
+            }
+        };
+        for (const auto& [neighborPos, neighborIdx, dir] : neighbors)
+            pushHistory(neighborIdx);
+        pushHistory(cellIdx);
     }
 
     //Update the cell and its neighbors.
     cell = { tile, tilePermutation, 1 };
-    for (const auto& [neighborPos, faceTowardsNeighbor] : GetNeighbors(pos))
-        if (Cells.IsIndexValid(neighborPos))
-            ApplyFilter(pos, neighborPos, faceTowardsNeighbor, report, false);
+    std::tie(cell.WeightSum, cell.WeightLogWeightSum) =
+        GetWeightSums(tile, TransformSet::Combine(GetCanonicalPermutation(tile, tilePermutation)));
+    for (const auto& [neighborPos, neighborIdx, faceTowardsNeighbor] : neighbors)
+        if (neighborIdx != CellIdx_INVALID)
+            ApplyFilter(cellIdx, neighborPos, neighborIdx, faceTowardsNeighbor, report, false);
 
     DEBUGMEM_ValidateAll();
 }
@@ -238,12 +439,12 @@ void Grid::ClearCells(const Region3i& region, Report* report)
     for (Vector3i cellPos : region)
     {
         cellPos = FilterPos(cellPos);
-        auto& cell = Cells[cellPos];
+        auto cellIdx = GetCellIdx(cellPos);
 
         #if defined(WFCPP_DEBUG)
-            cell.ChosenPermutation = { }; //Give unset cells a standardized value.
+            GetCell(cellIdx).ChosenPermutation = { }; //Give unset cells a standardized value.
         #endif
-        ResetCellPossibilities(cellPos, report);
+        ResetCellPossibilities(cellPos, cellIdx, report);
     }
 
     //The cells on the border of the clear region need to update
@@ -271,25 +472,27 @@ void Grid::ClearCells(const Region3i& region, Report* report)
 
                     if (Cells.IsIndexValid(outsidePos))
                     {
-                        auto& outsideCell = Cells[outsidePos];
+                        auto outsideIdx = GetCellIdx(outsidePos);
 
                         //If the outside cell is already set, then its adjacent cleared neighbor
                         //     should filter out some tile possibilities based on their connecting face.
-                        if (outsideCell.IsSet())
+                        if (GetCell(outsideIdx).IsSet())
                         {
-                            Vector3i clearedPos = outsidePos;
-                            int inwardDelta = -((side * 2) - 1);
-                            clearedPos[axis] += inwardDelta;
-
                             auto sideTowardsOutside = Tiled3D::MakeDirection3D(side == 0, axis);
+                            auto sideTowardsCleared = GetOpposite(sideTowardsOutside);
+                            auto [clearedPos, clearedIdx] = GetNeighbor(outsidePos, outsideIdx, sideTowardsCleared);
 
-                            ApplyFilter(outsidePos, clearedPos, GetOpposite(sideTowardsOutside), report, false);
+                            //The outside cell no longer has anything required along that side.
+                            if (PropagationMode == PropagationModes::Faces)
+                                GetSideFaces(outsideIdx)[sideTowardsCleared] = SideFace_Any;
+
+                            ApplyFilter(outsideIdx, clearedPos, clearedIdx, sideTowardsCleared, report, false);
                         }
                         //Otherwise, the outside cell needs to recompute *its* possibilities
                         //    because the cleared cell may have opened them back up.
                         else
                         {
-                            RecalculateCellPossibilities(outsidePos, outsideCell, report);
+                            RecalculateCellPossibilities(outsidePos, outsideIdx, report);
                         }
                     }
                 }
@@ -310,12 +513,23 @@ void Grid::SetCellNot(Vector3i pos,
     ActionHistory.clear();
     StatePreActionHistory.clear();
 
+    auto cellIdx = GetCellIdx(pos);
+
+    //Permutations that produce the same cube can't be told apart, so forbid their whole group.
+    TransformSet forbidden = specificPermutations;
+    specificPermutations.ForEach([&](Transform3D permutation)
+    {
+        forbidden.Add(GetEquivalentPermutations(tile, permutation));
+    });
+    specificPermutations = forbidden;
+
     //Bake this constraint into the initial grid state.
-    Vector4i key{ static_cast<int>(tile), pos };
-    InitialPossiblePermutations[key].Remove(specificPermutations);
+    GetInitialPossibilities(cellIdx)[tile].Remove(specificPermutations);
+    if (PropagationMode == PropagationModes::Faces)
+        HasInitialConstraints[cellIdx] = 1;
 
     //Update the current grid state.
-    auto& cell = Cells[pos];
+    auto& cell = GetCell(cellIdx);
     //If the cell was set to this forbidden state, it must be cleared.
     if (cell.IsSet() && cell.ChosenTile == tile && specificPermutations.Contains(cell.ChosenPermutation))
     {
@@ -324,10 +538,25 @@ void Grid::SetCellNot(Vector3i pos,
     //If the cell is not set yet, its possibilities must be updated.
     else if (!cell.IsSet())
     {
-        auto nRemoved = PossiblePermutations[key].Remove(specificPermutations);
-        WFCPP_ASSERT(cell.NPossibilities >= nRemoved);
-
-        cell.NPossibilities -= nRemoved;
+        int nRemoved;
+        if (PropagationMode == PropagationModes::Faces)
+        {
+            auto oldNPossibilities = cell.NPossibilities;
+            UpdateFromSideFaces(cellIdx, cell);
+            nRemoved = oldNPossibilities - cell.NPossibilities;
+        }
+        else
+        {
+            auto& available = GetPossibilities(cellIdx)[tile];
+            auto removed = available;
+            available.Remove(specificPermutations);
+            removed.Remove(available);
+            nRemoved = removed.Size();
+            WFCPP_ASSERT(cell.NPossibilities >= static_cast<uint32_t>(nRemoved));
+
+            cell.NPossibilities -= nRemoved;
+            RemoveCellWeights(cell, tile, removed);
+        }
         if (report && nRemoved > 0)
         {
             if (cell.NPossibilities < 1)
@@ -347,36 +576,32 @@ void Grid::SetFaceImpl(Vector3i pos, Directions3D dir, const FaceIdentifiers& po
     pos = FilterPos(pos);
     WFCPP_ASSERT(Cells.IsIndexValid(pos));
 
-    auto neighborPos = FilterPos(pos + GetFaceDirection(dir));
-    bool hasNeighbor = Cells.IsIndexValid(neighborPos);
+    auto cellIdx = GetCellIdx(pos);
+    auto [neighborPos, neighborIdx] = GetNeighbor(pos, cellIdx, dir);
 
-    CellState* faceCells[2] = {
-        &Cells[pos],
-        (hasNeighbor ? &Cells[neighborPos] : nullptr)
+    CellIdx faceCellIdcs[2] = {
+        cellIdx, neighborIdx
     };
     Directions3D faceDirs[2] = {
         dir,
         GetOpposite(dir)
     };
-    Vector3i faceCellIdcs[2] = {
+    Vector3i faceCellPoses[2] = {
         pos, neighborPos
     };
 
     for (int i = 0; i < 2; ++i)
     {
-        if (faceCells[i] == nullptr)
+        if (faceCellIdcs[i] == CellIdx_INVALID)
             continue;
-        auto& cell = *faceCells[i];
-        auto faceDir = faceDirs[i];
-        auto facePos = faceCellIdcs[i];
-
-        SetFaceInnerImpl(faceCellIdcs[i], *faceCells[i], faceDir, points, report, isForbidding);
+        SetFaceInnerImpl(faceCellPoses[i], faceCellIdcs[i], faceDirs[i], points, report, isForbidding);
     }
 }
-void Grid::SetFaceInnerImpl(Vector3i pos, CellState& cell,
+void Grid::SetFaceInnerImpl(const Vector3i& pos, CellIdx cellIdx,
                             Directions3D face, const FaceIdentifiers& points,
                             Report* report, bool isForbidding)
 {
+    auto& cell = GetCell(cellIdx);
     bool needsFiltering;
     if (cell.IsSet())
     {
@@ -398,15 +623,30 @@ void Grid::SetFaceInnerImpl(Vector3i pos, CellState& cell,
     }
 
     FacePermutation permutation{ face, points };
-    if (needsFiltering)
-        ApplyFilter(pos, permutation, cell, report, isForbidding);
-    ApplyInitialFilter(pos, permutation, isForbidding);
+    if (PropagationMode == PropagationModes::Faces)
+    {
+        //The cell's possibilities are derived from its initial ones, so filter those first.
+        ApplyInitialFilter(cellIdx, permutation, isForbidding);
+        if (needsFiltering && !cell.IsSet())
+        {
+            auto oldNPossibilities = cell.NPossibilities;
+            UpdateFromSideFaces(cellIdx, cell);
+            ReportFilteredCell(report, pos, oldNPossibilities, cell.NPossibilities);
+        }
+    }
+    else
+    {
+        if (needsFiltering)
+            ApplyFilter(pos, cellIdx, permutation, report, isForbidding);
+        ApplyInitialFilter(cellIdx, permutation, isForbidding);
+    }
 }
 
-void Grid::ApplyFilter(const Vector3i& cellPos, const FacePermutation& face,
-                       CellState& cell, Report* report,
-                       bool isForbidding)
+void Grid::ApplyFilter(const Vector3i& cellPos, CellIdx cellIdx,
+                       const FacePermutation& face,
+                       Report* report, bool isForbidding)
 {
+    auto& cell = GetCell(cellIdx);
     cell.DEBUGMEM_Validate();
     if (cell.IsSet())
         return;
@@ -417,66 +657,82 @@ void Grid::ApplyFilter(const Vector3i& cellPos, const FacePermutation& face,
     {
         if (!isForbidding)
         {
-            for (int i = 0; i < static_cast<int>(InputTiles.size()); ++i)
-                PossiblePermutations[{ i, cellPos }] = { };
+            std::fill_n(GetPossibilities(cellIdx), InputTiles.size(), TransformSet{ });
             cell.NPossibilities = 0;
+            cell.WeightSum = 0;
+            cell.WeightLogWeightSum = 0;
         }
     }
     else
     {
         auto faceIdx = FaceIndices[face];
+        auto possibilities = GetPossibilities(cellIdx);
         for (int tileI = 0; tileI < static_cast<int>(InputTiles.size()); ++tileI)
         {
             const auto& supported = MatchingFaces[{ tileI, faceIdx }];
-            auto& available = PossiblePermutations[{ tileI, cellPos }];
-            auto nChoicesLost = isForbidding ? available.Remove(supported) : available.Intersect(supported);
+            auto& available = possibilities[tileI];
+            auto lost = available;
+            if (isForbidding)
+                available.Remove(supported);
+            else
+                available.Intersect(supported);
+            lost.Remove(available);
 
-            WFCPP_ASSERT(nChoicesLost <= cell.NPossibilities);
-            cell.NPossibilities -= nChoicesLost;
+            WFCPP_ASSERT(lost.Size() <= cell.NPossibilities);
+            cell.NPossibilities -= lost.Size();
+            RemoveCellWeights(cell, tileI, lost);
         }
     }
 
-    if (report && initialNPossibilities != cell.NPossibilities)
-    {
-        //If the cell no longer has any tile choices, it's unsolvable.
-        if (cell.NPossibilities < 1)
-        {
-            report->GotUnsolvable.insert(cellPos);
-        }
-        //Otherwise, it's a candidate of interest since it just had some possibilities narrowed down.
-        //NOTE: I previously added a check here that the possibility count actually changed, but that seems to make solving worse.
-        else
-        {
-            report->GotInteresting.insert(cellPos);
-        }
-    }
+    ReportFilteredCell(report, cellPos, initialNPossibilities, cell.NPossibilities);
 
     DEBUGMEM_ValidateAll();
 }
-void Grid::ApplyFilter(const Vector3i& cellPos,
-                       const Vector3i& neighborPos,
+void Grid::ApplyFilter(CellIdx cellIdx,
+                       const Vector3i& neighborPos, CellIdx neighborIdx,
                        Directions3D sideTowardsNeighbor,
                        Report* report, bool isForbidding)
 {
-    auto& cell = Cells[cellPos];
+    const auto& cell = GetCell(cellIdx);
     if (!cell.IsSet())
         return;
 
     auto cellFace = GetFace(cell.ChosenTile, cell.ChosenPermutation, sideTowardsNeighbor);
     auto neighborFace = cellFace.Flipped();
 
-    ApplyFilter(neighborPos, neighborFace, report, isForbidding);
+    if (PropagationMode == PropagationModes::Faces)
+    {
+        //Only forcing a face can be expressed with side faces; forbidding one is a permanent constraint.
+        WFCPP_ASSERT(!isForbidding);
+
+        //Set cells still remember the face, in case they're cleared later.
+        auto& neighbor = GetCell(neighborIdx);
+        GetSideFaces(neighborIdx)[GetOpposite(sideTowardsNeighbor)] = GetSideFaceIdx(neighborFace);
+        if (neighbor.IsSet())
+            return;
+
+        auto oldNPossibilities = neighbor.NPossibilities;
+        UpdateFromSideFaces(neighborIdx, neighbor);
+        ReportFilteredCell(report, neighborPos, oldNPossibilities, neighbor.NPossibilities);
+    }
+    else
+    {
+        ApplyFilter(neighborPos, neighborIdx, neighborFace, report, isForbidding);
+    }
 }
 
-void Grid::ApplyInitialFilter(const Vector3i& cellPos,
+void Grid::ApplyInitialFilter(CellIdx cellIdx,
                               const FacePermutation& face,
                               bool isForbidding)
 {
+    auto initialPossibilities = GetInitialPossibilities(cellIdx);
+    if (PropagationMode == PropagationModes::Faces)
+        HasInitialConstraints[cellIdx] = 1;
+
     //It's possible, if uncommon, that a tileset has no match for a particular face.
     if (!FaceIndices.contains(face))
     {
-        for (int i = 0; i < static_cast<int>(InputTiles.size()); ++i)
-            InitialPossiblePermutations[{ i, cellPos }] = { };
+        std::fill_n(initialPossibilities, InputTiles.size(), TransformSet{ });
     }
     else
     {
@@ -484,7 +740,7 @@ void Grid::ApplyInitialFilter(const Vector3i& cellPos,
         for (int tileI = 0; tileI < static_cast<int>(InputTiles.size()); ++tileI)
         {
             const auto& supported = MatchingFaces[{ tileI, faceIdx }];
-            auto& available = InitialPossiblePermutations[{ tileI, cellPos }];
+            auto& available = initialPossibilities[tileI];
 
             if (isForbidding)
                 available.Remove(supported);
@@ -496,22 +752,33 @@ void Grid::ApplyInitialFilter(const Vector3i& cellPos,
     DEBUGMEM_ValidateAll();
 }
 
-void Grid::ResetCellPossibilities(const Vector3i& cellPos, CellState& cell, Report* report)
+void Grid::ResetCellPossibilities(const Vector3i& cellPos, CellIdx cellIdx, Report* report)
 {
+    auto& cell = GetCell(cellIdx);
+    if (PropagationMode == PropagationModes::Faces)
+        GetSideFaces(cellIdx).fill(SideFace_Any);
+
     //If the cell is already completely empty, don't change anything.
     if (cell.NPossibilities == NPermutedTiles)
         return;
 
     cell.ChosenTile = TileIdx_INVALID;
 
-    cell.NPossibilities = 0;
-    for (int tileI = 0; tileI < static_cast<int>(InputTiles.size()); ++tileI)
+    if (PropagationMode == PropagationModes::Faces)
     {
-        Vector4i key{ tileI, cellPos };
-        auto initialPossibilities = InitialPossiblePermutations[key];
-
-        PossiblePermutations[key] = initialPossibilities;
-        cell.NPossibilities += initialPossibilities.Size();
+        UpdateFromSideFaces(cellIdx, cell);
+    }
+    else
+    {
+        cell.NPossibilities = 0;
+        auto possibilities = GetPossibilities(cellIdx);
+        const auto initialPossibilities = GetInitialPossibilities(cellIdx);
+        for (int tileI = 0; tileI < static_cast<int>(InputTiles.size()); ++tileI)
+        {
+            possibilities[tileI] = initialPossibilities[tileI];
+            cell.NPossibilities += initialPossibilities[tileI].Size();
+        }
+        RecalculateCellWeights(cellIdx, cell);
     }
 
     if (report && cell.NPossibilities == NPermutedTiles)
@@ -519,51 +786,131 @@ void Grid::ResetCellPossibilities(const Vector3i& cellPos, CellState& cell, Repo
 
     DEBUGMEM_ValidateAll();
 }
-void Grid::RecalculateCellPossibilities(const Vector3i& cellPos, CellState& cell, Report* report)
+void Grid::RecalculateCellPossibilities(const Vector3i& cellPos, CellIdx cellIdx, Report* report)
+{
+    ResetCellPossibilities(cellPos, cellIdx, report);
+
+    for (const auto& [neighborPos, neighborIdx, sideTowardsNeighbor] : GetNeighbors(cellPos, cellIdx))
+        if (neighborIdx != CellIdx_INVALID)
+            ApplyFilter(neighborIdx, cellPos, cellIdx, GetOpposite(sideTowardsNeighbor), report, false);
+}
+
+void Grid::RecalculateCellWeights(CellIdx cellIdx, CellState& cell)
+{
+    cell.WeightSum = 0;
+    cell.WeightLogWeightSum = 0;
+    auto possibilities = GetPossibilities(cellIdx);
+    for (int tileI = 0; tileI < static_cast<int>(InputTiles.size()); ++tileI)
+    {
+        auto [weightSum, weightLogWeightSum] = GetWeightSums(tileI, possibilities[tileI]);
+        cell.WeightSum += weightSum;
+        cell.WeightLogWeightSum += weightLogWeightSum;
+    }
+}
+
+void Grid::ComputeSideFacePossibilities(const TransformSet* initialPossibilities, const SideFaces& faces,
+                                        TransformSet* outPossibilities) const
+{
+    bool isUnmatched = std::find(faces.begin(), faces.end(), SideFace_Unmatched) != faces.end();
+    for (int tileI = 0; tileI < static_cast<int>(InputTiles.size()); ++tileI)
+    {
+        auto& available = outPossibilities[tileI];
+        available = isUnmatched ? TransformSet{ } : initialPossibilities[tileI];
+        for (auto faceIdx : faces)
+            if (faceIdx >= 0)
+                available.Intersect(MatchingFaces[{ tileI, faceIdx }]);
+    }
+}
+void Grid::UpdateFromSideFaces(CellIdx cellIdx, CellState& cell)
 {
-    ResetCellPossibilities(cellPos, cell, report);
+    const auto& faces = CellSideFaces[cellIdx];
+
+    //Constrained cells are rare enough to compute directly.
+    if (HasInitialConstraints[cellIdx])
+    {
+        auto possibilities = GetPossibilities(cellIdx);
+        ComputeSideFacePossibilities(GetInitialPossibilities(cellIdx), faces, possibilities);
+        ArePossibilitiesStale[cellIdx] = 0;
 
-    for (const auto& neighborData : GetNeighbors(cellPos))
+        cell.NPossibilities = 0;
+        for (int tileI = 0; tileI < static_cast<int>(InputTiles.size()); ++tileI)
+            cell.NPossibilities += possibilities[tileI].Size();
+        RecalculateCellWeights(cellIdx, cell);
+        return;
+    }
+
+    auto found = SideFacesCache.find(faces);
+    if (found == SideFacesCache.end())
     {
-        Vector3i neighborPos;
-        Directions3D sideTowardsNeighbor;
-        std::tie(neighborPos, sideTowardsNeighbor) = neighborData;
+        auto& possibilities = buffer_sideFaces_possibilities;
+        ComputeSideFacePossibilities(CanonicalPermutations.data(), faces, possibilities.data());
 
-        if (Cells.IsIndexValid(neighborPos))
-            ApplyFilter(neighborPos, cellPos, GetOpposite(sideTowardsNeighbor), report, false);
+        SideFacesSummary summary{ 0, 0, 0 };
+        for (int tileI = 0; tileI < static_cast<int>(InputTiles.size()); ++tileI)
+        {
+            auto [weightSum, weightLogWeightSum] = GetWeightSums(tileI, possibilities[tileI]);
+            summary.NPossibilities += possibilities[tileI].Size();
+            summary.WeightSum += weightSum;
+            summary.WeightLogWeightSum += weightLogWeightSum;
+        }
+        if (SideFacesCache.size() >= MaxSideFacesCacheSize)
+            SideFacesCache.clear();
+        found = SideFacesCache.emplace(faces, summary).first;
     }
+
+    cell.NPossibilities = found->second.NPossibilities;
+    cell.WeightSum = found->second.WeightSum;
+    cell.WeightLogWeightSum = found->second.WeightLogWeightSum;
+    ArePossibilitiesStale[cellIdx] = 1;
 }
 
 void Grid::UnwindActionHistory(Report* report)
 {
     WFCPP_ASSERT(!ActionHistory.empty());
-    WFCPP_ASSERT(StatePreActionHistory.size() == ActionHistory.size() * (N_DIRECTIONS_3D + 1) * InputTiles.size());
-
-    decltype(StatePreActionHistory)::const_iterator historyDataStart, historyDataEnd;
+    WFCPP_ASSERT(StatePreActionHistory.size() ==
+                   ((PropagationMode == PropagationModes::Faces) ?
+                        0 :
+                        (ActionHistory.size() * (N_DIRECTIONS_3D + 1) * InputTiles.size())));
+
+    Vector3i cellPos = ActionHistory.back();
+    auto cellIdx = GetCellIdx(cellPos);
+    auto neighbors = GetNeighbors(cellPos, cellIdx);
+
+    //The history stores the neighbors in the order of 'Directions3D', followed by the cell itself.
+    //In face mode there's no stored history; neighbors just forget the face this cell imposed on them.
+    size_t nTiles = InputTiles.size(),
+           nHistoryEntries = (PropagationMode == PropagationModes::Faces) ? 0 : (nTiles * (N_DIRECTIONS_3D + 1));
+    auto historyDataStart = StatePreActionHistory.end() - static_cast<ptrdiff_t>(nHistoryEntries),
+         historyDataEnd = StatePreActionHistory.end();
     for (int neighborI = 0; neighborI < N_DIRECTIONS_3D + 1; ++neighborI)
     {
-        auto [selfCell, neighborCellPos, neighborPermutationsStart, neighborPermutationsEnd] =
-            ActionHistoryNeighborInfo(static_cast<int>(ActionHistory.size() - 1), neighborI);
-        
-        if (neighborI == 0)
-            historyDataStart = neighborPermutationsStart;
-        else if (neighborI == N_DIRECTIONS_3D)
-            historyDataEnd = neighborPermutationsEnd;
+        bool isSelf = (neighborI == N_DIRECTIONS_3D);
+        const auto& neighborCellPos = isSelf ? cellPos : std::get<0>(neighbors[neighborI]);
+        auto neighborIdx = isSelf ? cellIdx : std::get<1>(neighbors[neighborI]);
 
-        if (Cells.IsIndexValid(neighborCellPos))
-        {
-            auto& neighborCell = Cells[neighborCellPos];
+        if (PropagationMode == PropagationModes::Faces && !isSelf && neighborIdx != CellIdx_INVALID)
+            GetSideFaces(neighborIdx)[GetOpposite(std::get<2>(neighbors[neighborI]))] = SideFace_Any;
 
-            int originalNPossibilities = neighborCell.NPossibilities;
-            neighborCell.NPossibilities = 0;
+        //Neighbors that are already set weren't affected by this action,
+        //    and their stored possibilities are stale, so leave them alone.
+        if (neighborIdx != CellIdx_INVALID && (isSelf || !GetCell(neighborIdx).IsSet()))
+        {
+            auto& neighborCell = GetCell(neighborIdx);
 
-            for (int tileI = 0; tileI < InputTiles.size(); ++tileI)
+            auto originalNPossibilities = neighborCell.NPossibilities;
+            if (PropagationMode == PropagationModes::Faces)
             {
-                auto possibilities = *(neighborPermutationsStart + tileI);
-                neighborCell.NPossibilities += possibilities.Size();
+                UpdateFromSideFaces(neighborIdx, neighborCell);
+            }
+            else
+            {
+                auto neighborPermutationsStart = historyDataStart + static_cast<ptrdiff_t>(neighborI * nTiles);
+                neighborCell.NPossibilities = 0;
 
-                //TODO: Try memcpy-ing all tile permutations at once.
-                PossiblePermutations[Vector4i{ tileI, neighborCellPos }] = possibilities;
+                std::copy_n(neighborPermutationsStart, nTiles, GetPossibilities(neighborIdx));
+                for (size_t tileI = 0; tileI < nTiles; ++tileI)
+                    neighborCell.NPossibilities += (neighborPermutationsStart + tileI)->Size();
+                RecalculateCellWeights(neighborIdx, neighborCell);
             }
 
             if (report)
@@ -580,10 +927,12 @@ void Grid::UnwindActionHistory(Report* report)
     }
 
     //Unset the cell itself.
-    auto& cell = Cells[ActionHistory.back()];
-    cell = { TileIdx_INVALID, { }, cell.NPossibilities };
+    //Its possibilities (and weight sums) were already restored as the last "neighbor" above.
+    auto& cell = GetCell(cellIdx);
+    cell.ChosenTile = TileIdx_INVALID;
+    cell.ChosenPermutation = { };
     if (report)
-        report->GotInteresting.insert(ActionHistory.back());
+        report->GotInteresting.insert(cellPos);
 
     ActionHistory.pop_back();
     StatePreActionHistory.erase(historyDataStart, historyDataEnd);
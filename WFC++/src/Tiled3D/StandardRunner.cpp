@@ -6,22 +6,79 @@ using namespace WFC::Math;
 using namespace WFC::Tiled3D;
 
 
+StandardRunner::CellHistory StandardRunner::GetHistory(const Vector3i& cell) const
+{
+    const auto* history = History.Find(Grid.GetCellIdx(cell));
+    return (history == nullptr) ? CellHistory{ } : *history;
+}
 float StandardRunner::GetTemperature(const Vector3i& cell) const
 {
-    const auto& history = History[cell];
-    float temperature = history.BaseTemperature;
+    const auto* history = History.Find(Grid.GetCellIdx(cell));
+    if (history == nullptr)
+        return 0;
+
+    float temperature = history->BaseTemperature;
 
     //Apply a cooling effect over time.
-    if (history.LastUnsolvedTime != NEVER_UNSOLVED_TIMESTAMP)
+    if (history->LastUnsolvedTime != NEVER_UNSOLVED_TIMESTAMP)
     {
-        WFCPP_ASSERT(CurrentTimestamp >= history.LastUnsolvedTime); //Hopefully it's not from the future
-        auto elapsed = CurrentTimestamp - history.LastUnsolvedTime;
+        WFCPP_ASSERT(CurrentTimestamp >= history->LastUnsolvedTime); //Hopefully it's not from the future
+        auto elapsed = CurrentTimestamp - history->LastUnsolvedTime;
         temperature -= (elapsed * CoolOffRate);
         temperature = Math::Max(temperature, 0.0f);
     }
 
     return temperature;
 }
+size_t StandardRunner::PruneHistory()
+{
+    return History.EraseIf([&](CellIdx, const CellHistory& history)
+    {
+        if (history.LastUnsolvedTime == NEVER_UNSOLVED_TIMESTAMP)
+            return history.BaseTemperature <= 0;
+
+        auto elapsed = CurrentTimestamp - history.LastUnsolvedTime;
+        return (history.BaseTemperature - (elapsed * CoolOffRate)) <= 0;
+    });
+}
+bool StandardRunner::IsNogoodActive(const Nogood& nogood) const
+{
+    return std::all_of(nogood.Context.begin(), nogood.Context.end(), [&](const CellPlacement& placement)
+    {
+        const auto& cell = Grid.Cells[placement.Cell];
+        return cell.IsSet() && cell.ChosenTile == placement.Tile &&
+               Grid.GetCanonicalPermutation(cell.ChosenTile, cell.ChosenPermutation) == placement.Permutation;
+    });
+}
+void StandardRunner::GetConflictSet(const Vector3i& cellPos, std::vector<CellPlacement>& outPlacements) const
+{
+    outPlacements.clear();
+    auto addPlacement = [&](const Vector3i& placedPos)
+    {
+        for (const auto& placement : outPlacements)
+            if (placement.Cell == placedPos)
+                return;
+
+        const auto& placedCell = Grid.Cells[placedPos];
+        outPlacements.push_back({ placedPos, placedCell.ChosenTile,
+                                  Grid.GetCanonicalPermutation(placedCell.ChosenTile, placedCell.ChosenPermutation) });
+    };
+
+    //The grid only filters a cell by its set neighbors,
+    //    so they're the only placements that could have removed its options.
+    for (int dirI = 0; dirI < N_DIRECTIONS_3D; ++dirI)
+    {
+        auto neighborPos = Grid.FilterPos(cellPos + GetFaceDirection(static_cast<Directions3D>(dirI)));
+        if (Grid.Cells.IsIndexValid(neighborPos) && Grid.Cells[neighborPos].IsSet())
+            addPlacement(neighborPos);
+    }
+
+    if (const auto* nogoods = Nogoods.Find(Grid.GetCellIdx(cellPos)))
+        for (const auto& nogood : *nogoods)
+            if (IsNogoodActive(nogood))
+                for (const auto& placement : nogood.Context)
+                    addPlacement(placement.Cell);
+}
 Region3i StandardRunner::GetClearRegion(const Vector3i& cell) const
 {
     float temperature = GetTemperature(cell);
@@ -39,13 +96,36 @@ Region3i StandardRunner::GetClearRegion(const Vector3i& cell) const
 
     //Turn the radius into a rectangular area.
     Vector3i areaMin = Math::Max(Vector3i::Zero(), cell - radius),
-             areaMax = Math::Min(History.GetDimensions(), cell + radius + 1);
+             areaMax = Math::Min(Grid.Cells.GetDimensions(), cell + radius + 1);
     return { areaMin, areaMax };
 }
 float StandardRunner::GetPriority(const Vector3i& cellPos)
 {
-    float entropy = 1.0f - ((float)Grid.Cells[cellPos].NPossibilities /
-                              Grid.NPermutedTiles);
+    const auto& cell = Grid.Cells[cellPos];
+
+    //Both heuristics are normalized so that 0 means "anything is possible"
+    //    and 1 means "only one option left".
+    float entropy;
+    switch (EntropyHeuristic)
+    {
+        case EntropyHeuristics::PossibilityCount:
+            entropy = 1.0f - ((float)cell.NPossibilities / Grid.NPermutedTiles);
+            break;
+
+        case EntropyHeuristics::WeightedShannon: {
+            float maxEntropy = Grid.GetMaxWeightedEntropy();
+            entropy = (maxEntropy > 0) ?
+                          (1.0f - (cell.GetWeightedEntropy() / maxEntropy)) :
+                          1.0f;
+            break;
+        }
+
+        default:
+            WFCPP_ASSERT(false);
+            entropy = 0;
+            break;
+    }
+
     return (PriorityWeightEntropy * entropy) +
            (PriorityWeightTemperature * GetTemperature(cellPos)) +
            (std::uniform_real_distribution<float>{0.0f, PriorityWeightRandomness}(Rand));
@@ -67,7 +147,7 @@ void StandardRunner::ClearAround(const Vector3i& centerCellPos)
     WFCPP_ASSERT(report.GotUnsolvable.size() == 0); //Removing tiles shouldn't make something unsolvable.
 
     //Update the unsolvable cell.
-    auto& cellHistory = History[centerCellPos];
+    auto& cellHistory = History[Grid.GetCellIdx(centerCellPos)];
     cellHistory.LastUnsolvedTime = CurrentTimestamp;
 
     //Update neighboring temperatures.
@@ -79,8 +159,79 @@ void StandardRunner::ClearAround(const Vector3i& centerCellPos)
     {
         Vector3i lookupIdx = Vector3i{ 2, 2, 2 } - (gridRegion.MaxExclusive - cellPos - 1);
         auto tempIncrease = TempIncreases[lookupIdx.x][lookupIdx.y][lookupIdx.z];
-        History[Grid.FilterPos(cellPos)].BaseTemperature += tempIncrease;
+        History[Grid.GetCellIdx(cellPos)].BaseTemperature += tempIncrease;
+    }
+}
+bool StandardRunner::Backjump()
+{
+    //Find the most recent culprit of any unsolvable cell.
+    //Jumping back to it can't skip past a culprit of the other unsolvable cells.
+    const auto& actionHistory = Grid.ActionHistory;
+    int maxDepth = static_cast<int>(Math::Min(actionHistory.size(), static_cast<size_t>(Math::Max(0, MaxUnwindingCount)))),
+        culpritDepth = -1; //The number of more recent placements.
+    for (const Vector3i& cellPos : unsolvableCells)
+    {
+        GetConflictSet(cellPos, buffer_backjump_conflictSet);
+        const auto& conflictSet = buffer_backjump_conflictSet;
+        for (int depth = 0; depth < maxDepth && (culpritDepth < 0 || depth < culpritDepth); ++depth)
+        {
+            const auto& placedPos = actionHistory[actionHistory.size() - 1 - depth];
+            bool isCulprit = std::any_of(conflictSet.begin(), conflictSet.end(),
+                                         [&](const CellPlacement& placement) { return placement.Cell == placedPos; });
+            if (isCulprit)
+            {
+                culpritDepth = depth;
+                std::swap(buffer_backjump_bestConflictSet, buffer_backjump_conflictSet);
+                break;
+            }
+        }
     }
+    if (culpritDepth < 0)
+        return false;
+
+    //The culprit's placement can't work alongside the rest of the conflict set.
+    //If that's too much to remember, jumping back would probably just hit the same conflict again,
+    //    so let the caller clear the area instead.
+    Vector3i culpritPos = actionHistory[actionHistory.size() - 1 - culpritDepth];
+    const auto& conflictSet = buffer_backjump_bestConflictSet;
+    if (MaxNogoodSize > 0 && MaxNogoodsPerCell > 0)
+    {
+        if (static_cast<int>(conflictSet.size()) - 1 > MaxNogoodSize)
+            return false;
+
+        Nogood nogood;
+        for (const auto& placement : conflictSet)
+        {
+            if (placement.Cell == culpritPos)
+            {
+                nogood.Tile = placement.Tile;
+                nogood.Permutation = placement.Permutation;
+            }
+            else
+            {
+                nogood.Context.push_back(placement);
+            }
+        }
+
+        auto& cellNogoods = Nogoods[Grid.GetCellIdx(culpritPos)];
+        if (cellNogoods.size() >= static_cast<size_t>(MaxNogoodsPerCell))
+            cellNogoods.erase(cellNogoods.begin());
+        cellNogoods.push_back(std::move(nogood));
+    }
+
+    //Undo everything back to the culprit.
+    //Cells that are still unsolvable, because their culprits are further back, get handled next tick.
+    auto& oldUnsolvableCells = buffer_backjump_unsolvableCells;
+    oldUnsolvableCells.assign(unsolvableCells.begin(), unsolvableCells.end());
+    unsolvableCells.clear();
+    int nToUndo = culpritDepth + 1;
+    UnwindCells(nToUndo);
+    for (const Vector3i& cellPos : oldUnsolvableCells)
+        if (!Grid.Cells[cellPos].IsSet() && Grid.Cells[cellPos].NPossibilities < 1)
+            unsolvableCells.insert(cellPos);
+
+    LastAction = StandardRunnerAction_UndoCells{ nToUndo };
+    return true;
 }
 void StandardRunner::SetCell(const Vector3i& cellPos, TileIdx tile, Transform3D permutation,
                              bool isPermanent)
@@ -104,10 +255,12 @@ void StandardRunner::SetCell(const Vector3i& cellPos, TileIdx tile, Transform3D
 
     //Update the cell history.
     //Skip this if we're redoing some unwound history; that shouldn't affect temperature.
+    //Cells without any history are already at 0 temperature.
     if (CurrentUnwindingCount < 1)
     {
-        auto& history = History[cellPos];
-        history.BaseTemperature = Math::Max(0.0f, history.BaseTemperature - CoolOffFromSetting);
+        auto* history = History.Find(Grid.GetCellIdx(Grid.FilterPos(cellPos)));
+        if (history != nullptr)
+            history->BaseTemperature = Math::Max(0.0f, history->BaseTemperature - CoolOffFromSetting);
     }
 }
 void StandardRunner::UnwindCells(int n)
@@ -244,7 +397,11 @@ bool StandardRunner::Tick()
     bool hasUnsolvable = unsolvableCells.size() > 0;
     if (hasUnsolvable)
     {
-        bool usedUnwinding = [&]() {
+        //Backjumping keeps track of which cells are still unsolvable afterwards.
+        if (RecoveryStrategy == RecoveryStrategies::Backjumping && Backjump())
+            return false;
+
+        bool usedUnwinding = (RecoveryStrategy == RecoveryStrategies::Heuristic) && [&]() {
             if (CurrentUnwindingCount < 1)
                 CurrentUnwindingCount = InitialUnwindingCount;
             //If we were redoing previously-undone cells,
@@ -285,14 +442,13 @@ bool StandardRunner::Tick()
         //Look for any cells with less than full range of possibilities,
         //    and track how many are set.
         size_t nSetCells = 0;
-        for (const Vector3i& cellPos : Region3i(Grid.Cells.GetDimensions()))
+        Grid.Cells.ForEach([&](const Vector3i& cellPos, const Grid::CellState& cell)
         {
-            const auto& cell = Grid.Cells[cellPos];
             if (cell.IsSet())
                 nSetCells += 1;
             else if (cell.NPossibilities < Grid.NPermutedTiles)
                 nextCells.insert(cellPos);
-        }
+        });
 
         //If every cell was set, then the algorithm is done.
         if (nSetCells == Grid.Cells.GetNumbElements())
@@ -329,7 +485,7 @@ bool StandardRunner::Tick()
     WFCPP_ASSERT(!Grid.Cells[cellPos].IsSet());
     TileIdx tileIdx;
     Transform3D tilePermutation;
-    auto tryRandomTile = RandomTile(&Grid.PossiblePermutations[{ 0, cellPos }]);
+    auto tryRandomTile = RandomTile(GetAllowedPermutations(cellPos));
     if (tryRandomTile.has_value())
     {
         std::tie(tileIdx, tilePermutation) = *tryRandomTile;
@@ -357,6 +513,21 @@ bool StandardRunner::TickN(int n)
     return false;
 }
 
+const TransformSet* StandardRunner::GetAllowedPermutations(const Vector3i& cellPos)
+{
+    const auto* possibilities = Grid.GetPossiblePermutations(cellPos);
+    const auto* nogoods = Nogoods.Find(Grid.GetCellIdx(cellPos));
+    if (nogoods == nullptr)
+        return possibilities;
+
+    auto& allowed = buffer_nogoods_possibilities;
+    allowed.assign(possibilities, possibilities + Grid.InputTiles.size());
+    for (const auto& nogood : *nogoods)
+        if (IsNogoodActive(nogood))
+            allowed[nogood.Tile].Remove(nogood.Permutation);
+    return allowed.data();
+}
+
 std::optional<std::tuple<TileIdx, Transform3D>> StandardRunner::RandomTile(const TransformSet* allowedPerTile)
 {
     auto& distributionWeights = buffer_randomTile_weights;
@@ -365,23 +536,46 @@ std::optional<std::tuple<TileIdx, Transform3D>> StandardRunner::RandomTile(const
     //     (and of course the user's own weights).
     distributionWeights.clear();
     for (int tileI = 0; tileI < static_cast<int>(Grid.InputTiles.size()); ++tileI)
-        distributionWeights.push_back(static_cast<float>(allowedPerTile[tileI].Size() * Grid.InputTiles[tileI].Weight));
+        distributionWeights.push_back(Grid.GetPermutationWeight(static_cast<TileIdx>(tileI), allowedPerTile[tileI]));
     auto chosenTileI = PickWeightedRandomIndex(Rand, distributionWeights);
     if (chosenTileI < 0)
         return { };
+    auto chosenTile = static_cast<TileIdx>(chosenTileI);
 
     //Pick a permutation for the tile.
+    //Each one stands in for a group of permutations that produce the same cube,
+    //    so weight it by the size of that group.
     const auto& permutations = allowedPerTile[chosenTileI];
     WFCPP_ASSERT(permutations.Size() > 0);
-    distributionWeights.resize(static_cast<size_t>(N_TRANSFORMS));
-    std::fill(distributionWeights.begin(), distributionWeights.end(), 0.0f);
-    for (Transform3D tr : permutations)
-        distributionWeights[TransformSet::ToBitIdx(tr)] = 1;
-    ptrdiff_t chosenTransformI = PickWeightedRandomIndex(Rand, distributionWeights);
-    WFCPP_ASSERT(chosenTransformI >= 0);
-
-    return std::make_tuple(
-        static_cast<TileIdx>(chosenTileI),
-        TransformSet::FromBit(static_cast<uint_fast8_t>(chosenTransformI))
-    );
+    int chosenPermutationI;
+    if (Grid.HasUniformGroups(chosenTile))
+    {
+        //Every permutation has the same weight, so there's no need to list them.
+        //Make the same random draw 'PickWeightedRandomIndex()' would, and jump straight to that element.
+        auto nPermutations = permutations.Size();
+        float permutationBudget = std::uniform_real_distribution<float>(0, static_cast<float>(nPermutations))(Rand);
+        chosenPermutationI = static_cast<int>(std::ceil(permutationBudget)) - 1;
+        chosenPermutationI = std::clamp(chosenPermutationI, 0, static_cast<int>(nPermutations) - 1);
+    }
+    else
+    {
+        distributionWeights.clear();
+        permutations.ForEach([&](Transform3D permutation)
+        {
+            distributionWeights.push_back(static_cast<float>(Grid.GetEquivalentPermutations(chosenTile, permutation).Size()));
+        });
+        chosenPermutationI = static_cast<int>(PickWeightedRandomIndex(Rand, distributionWeights));
+        WFCPP_ASSERT(chosenPermutationI >= 0);
+    }
+    auto chosenPermutation = permutations.NthElement(static_cast<uint_fast8_t>(chosenPermutationI));
+
+    //Expand the chosen permutation back out into one of the concrete permutations it stands in for.
+    const auto& equivalents = Grid.GetEquivalentPermutations(chosenTile, chosenPermutation);
+    if (equivalents.Size() > 1)
+    {
+        auto equivalentI = std::uniform_int_distribution<int>(0, equivalents.Size() - 1)(Rand);
+        chosenPermutation = equivalents.NthElement(static_cast<uint_fast8_t>(equivalentI));
+    }
+
+    return std::make_tuple(chosenTile, chosenPermutation);
 }
\ No newline at end of file
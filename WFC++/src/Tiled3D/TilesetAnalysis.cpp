@@ -0,0 +1,121 @@
+#include "../../include/Tiled3D/TilesetAnalysis.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace WFC;
+using namespace WFC::Math;
+using namespace WFC::Tiled3D;
+
+
+TilesetAnalysis::TilesetAnalysis(const std::vector<Tile>& tiles)
+    : DeadPermutations(tiles.size()),
+      MinNeighborOptionsPerTile(tiles.size(), 0)
+{
+    //Cache the faces of every tile permutation, indexed by tile, then permutation bit, then side.
+    std::vector<std::array<std::array<FacePermutation, N_DIRECTIONS_3D>, N_TRANSFORMS>> faces(tiles.size());
+    for (size_t tileI = 0; tileI < tiles.size(); ++tileI)
+        tiles[tileI].Permutations.ForEach([&](Transform3D permutation)
+        {
+            for (int dirI = 0; dirI < N_DIRECTIONS_3D; ++dirI)
+            {
+                auto dir = static_cast<Directions3D>(dirI);
+                faces[tileI][TransformSet::ToBitIdx(permutation)][dirI] = GetFace(tiles[tileI].Data, permutation, dir);
+            }
+        });
+
+    //Counts how many live tile permutations have each face.
+    std::vector<TransformSet> livePermutations;
+    for (const auto& tile : tiles)
+        livePermutations.push_back(tile.Permutations);
+    std::unordered_map<FacePermutation, int> faceCounts;
+    auto countFaces = [&]()
+    {
+        faceCounts.clear();
+        for (size_t tileI = 0; tileI < tiles.size(); ++tileI)
+            livePermutations[tileI].ForEach([&](Transform3D permutation)
+            {
+                for (const auto& face : faces[tileI][TransformSet::ToBitIdx(permutation)])
+                    faceCounts[face] += 1;
+            });
+    };
+    //Gets how many live tile permutations can sit against the given face.
+    auto getNNeighborOptions = [&](const FacePermutation& face)
+    {
+        auto found = faceCounts.find(face.Flipped());
+        return (found == faceCounts.end()) ? 0 : found->second;
+    };
+
+    //Find the faces that nothing can connect to, before anything is pruned.
+    countFaces();
+    NFaces = static_cast<int>(faceCounts.size());
+    for (const auto& [face, count] : faceCounts)
+        if (getNNeighborOptions(face) == 0)
+            NUnmatchedFaces += 1;
+
+    //Kill every permutation with an unmatched face, until there's nothing left to kill.
+    while (true)
+    {
+        bool anyDied = false;
+        for (size_t tileI = 0; tileI < tiles.size(); ++tileI)
+            livePermutations[tileI].ForEach([&](Transform3D permutation)
+            {
+                const auto& permutationFaces = faces[tileI][TransformSet::ToBitIdx(permutation)];
+                bool isDead = std::any_of(permutationFaces.begin(), permutationFaces.end(),
+                                          [&](const FacePermutation& face) { return getNNeighborOptions(face) == 0; });
+                if (isDead)
+                {
+                    DeadPermutations[tileI].Add(permutation);
+                    anyDied = true;
+                }
+            });
+        if (!anyDied)
+            break;
+
+        NPruningRounds += 1;
+        for (size_t tileI = 0; tileI < tiles.size(); ++tileI)
+            livePermutations[tileI].Remove(DeadPermutations[tileI]);
+        countFaces();
+    }
+
+    //Gather statistics on the permutations that are left.
+    int64_t nNeighborOptionsSum = 0,
+            nLiveFaces = 0;
+    MinNeighborOptions = std::numeric_limits<int>::max();
+    for (size_t tileI = 0; tileI < tiles.size(); ++tileI)
+    {
+        int tileMin = std::numeric_limits<int>::max();
+        livePermutations[tileI].ForEach([&](Transform3D permutation)
+        {
+            for (const auto& face : faces[tileI][TransformSet::ToBitIdx(permutation)])
+            {
+                auto nOptions = getNNeighborOptions(face);
+                tileMin = Math::Min(tileMin, nOptions);
+                MaxNeighborOptions = Math::Max(MaxNeighborOptions, nOptions);
+                nNeighborOptionsSum += nOptions;
+                nLiveFaces += 1;
+            }
+        });
+        MinNeighborOptionsPerTile[tileI] = (livePermutations[tileI].Size() > 0) ? tileMin : 0;
+        MinNeighborOptions = Math::Min(MinNeighborOptions, tileMin);
+
+        NDeadPermutations += DeadPermutations[tileI].Size();
+        if (livePermutations[tileI].Size() == 0 && tiles[tileI].Permutations.Size() > 0)
+            NDeadTiles += 1;
+    }
+    if (nLiveFaces > 0)
+    {
+        AverageNeighborOptions = static_cast<float>(static_cast<double>(nNeighborOptionsSum) / nLiveFaces);
+    }
+    else
+    {
+        MinNeighborOptions = 0;
+    }
+}
+
+void TilesetAnalysis::Prune(std::vector<Tile>& tiles) const
+{
+    WFCPP_ASSERT(tiles.size() == DeadPermutations.size());
+    for (size_t tileI = 0; tileI < tiles.size(); ++tileI)
+        tiles[tileI].Permutations.Remove(DeadPermutations[tileI]);
+}
@@ -1,7 +1,9 @@
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <string>
 #include <algorithm>
+#include <charconv>
 
 #include <Simple/State.h>
 
@@ -13,6 +15,19 @@
 //If "-shellMode" argument is passed, then nothing is printed to standard output
 //    except for the final resulting image.
 
+//Large images are much faster to load and save in binary form:
+//  * "-inputFile path" reads the input image from a file instead of standard input.
+//    The rest of the settings are still read from standard input.
+//  * "-outputFile path" writes the final image to a file instead of standard output.
+//    A file ending in ".pam" is written as a Netpbm PAM image; anything else is raw.
+//A raw image file is the width and height as little-endian uint32's,
+//    followed by every pixel as a little-endian uint32, row by row.
+//In a PAM image, each pixel's samples (up to 4, with a max value of at most 255)
+//    are packed into one pixel value, with the first sample in the lowest byte.
+//An output PAM image has the same depth as the input one, or 4 if the input was raw.
+
+//To print a one-line summary every N iterations, pass "-progress N".
+
 //The program settings are read from standard input.
 //The resulting image is sent to standard output as a series of rows separated by line breaks.
 //Each output row is a set of pixels separated by single spaces.
@@ -47,15 +62,15 @@ true                <----- Display each step of the process? (not needed if in s
 // 0: success
 // 1: input image is badly-formed
 // 2: the WFC constraint was violated and Violation Clear Size was 0
+// 3: an image file couldn't be read or written
 
 
 //Parses a pixel, expected to be a uint.
 //Returns whether or not the parse succeeded.
 bool TryParsePixel(const std::string& pixel, WFC::Simple::Pixel& outValue)
 {
-    std::stringstream converter(pixel);
-    return !(converter >> outValue).fail() &&
-            (converter >> std::ws).eof();
+    auto result = std::from_chars(pixel.data(), pixel.data() + pixel.size(), outValue);
+    return result.ec == std::errc() && result.ptr == pixel.data() + pixel.size();
 }
 //Parses a row of pixels, where each pixel is a uint separated by at least one space each.
 //Returns whether or not the parse succeeded.
@@ -100,14 +115,160 @@ bool TryParsePixelRow(const std::string& rowAsString, std::vector<WFC::Simple::P
 }
 
 
-//The following two functions get data from the given input stream.
-//If the given output stream isn't null, it writes instructions to the user as it gets input.
+//Reads an entire file into memory at once.
+//Returns whether or not it succeeded.
+bool ReadWholeFile(const std::string& path, std::vector<char>& outBytes)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    outBytes.resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read(outBytes.data(), outBytes.size());
+    return !file.fail();
+}
 
-WFC::Simple::InputData GetDataFromStream(std::istream& input, std::ostream* output)
+//Parses a binary image file (see the top of this file).
+//"outPamDepth" is set to the PAM image's depth, or 0 if it was a raw image.
+//Returns whether or not the parse succeeded.
+bool TryParseBinaryImage(const std::vector<char>& bytes,
+                         WFC::Array2D<WFC::Simple::Pixel>& outPixels, int& outPamDepth)
 {
-    //Let input stream parse "true" as true and "false" as false.
-    std::boolalpha(input);
+    size_t nPixels;
+    size_t byteI = 0;
+    auto bytesLeft = [&]() { return bytes.size() - byteI; };
+    auto readUint32 = [&]()
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i)
+            value |= (uint32_t)(unsigned char)bytes[byteI++] << (8 * i);
+        return value;
+    };
+
+    //PAM header:
+    if (bytes.size() >= 3 && bytes[0] == 'P' && bytes[1] == '7' && bytes[2] == '\n')
+    {
+        byteI = 3;
+        int width = -1, height = -1, maxValue = -1;
+        outPamDepth = -1;
+
+        std::string line;
+        while (line != "ENDHDR")
+        {
+            auto lineEnd = std::find(bytes.begin() + byteI, bytes.end(), '\n');
+            if (lineEnd == bytes.end())
+                return false;
+            line.assign(bytes.begin() + byteI, lineEnd);
+            byteI = (lineEnd - bytes.begin()) + 1;
+
+            std::stringstream lineStream(line);
+            std::string key;
+            lineStream >> key;
+            if (key == "WIDTH")
+                lineStream >> width;
+            else if (key == "HEIGHT")
+                lineStream >> height;
+            else if (key == "DEPTH")
+                lineStream >> outPamDepth;
+            else if (key == "MAXVAL")
+                lineStream >> maxValue;
+            else if (key != "TUPLTYPE" && key != "ENDHDR" && !key.empty() && key[0] != '#')
+                return false;
+            if (lineStream.fail())
+                return false;
+        }
+
+        if (width < 1 || height < 1 || outPamDepth < 1 || outPamDepth > 4 ||
+            maxValue < 1 || maxValue > 255)
+        {
+            return false;
+        }
+        nPixels = (size_t)width * (size_t)height;
+        if (bytesLeft() != nPixels * outPamDepth)
+            return false;
+
+        outPixels.Reset(width, height);
+        for (auto pos : WFC::Region2i(outPixels.GetDimensions()))
+        {
+            WFC::Simple::Pixel pixel = 0;
+            for (int sampleI = 0; sampleI < outPamDepth; ++sampleI)
+                pixel |= (WFC::Simple::Pixel)(unsigned char)bytes[byteI++] << (8 * sampleI);
+            outPixels[pos] = pixel;
+        }
+    }
+    //Raw header:
+    else
+    {
+        outPamDepth = 0;
+        if (bytesLeft() < 8)
+            return false;
+
+        uint32_t width = readUint32(),
+                 height = readUint32();
+        nPixels = (size_t)width * (size_t)height;
+        if (nPixels == 0 || bytesLeft() != nPixels * 4)
+            return false;
+
+        outPixels.Reset((int)width, (int)height);
+        for (auto pos : WFC::Region2i(outPixels.GetDimensions()))
+            outPixels[pos] = readUint32();
+    }
+
+    return true;
+}
+
+//Writes the given output into a binary image file (see the top of this file).
+//Unset pixels are written as 0.
+//If "pamDepth" is 0, a raw image is written.
+//Returns whether or not it succeeded.
+bool WriteBinaryImage(const WFC::Simple::State& state, int pamDepth, const std::string& path)
+{
+    static const char* pamTupleTypes[] = { "GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA" };
+
+    //Build the whole file in memory, then write it at once.
+    std::string bytes;
+    auto writeUint32 = [&](uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+            bytes += (char)((value >> (8 * i)) & 0xff);
+    };
 
+    WFC::Vector2i size = state.Output.GetDimensions();
+    int bytesPerPixel = (pamDepth > 0) ? pamDepth : 4;
+    if (pamDepth > 0)
+    {
+        bytes += "P7\nWIDTH " + std::to_string(size.x) +
+                 "\nHEIGHT " + std::to_string(size.y) +
+                 "\nDEPTH " + std::to_string(pamDepth) +
+                 "\nMAXVAL 255\nTUPLTYPE " + pamTupleTypes[pamDepth - 1] +
+                 "\nENDHDR\n";
+    }
+    else
+    {
+        writeUint32((uint32_t)size.x);
+        writeUint32((uint32_t)size.y);
+    }
+
+    bytes.reserve(bytes.size() + ((size_t)size.x * (size_t)size.y * bytesPerPixel));
+    for (auto pos : WFC::Region2i(size))
+    {
+        WFC::Simple::Pixel pixel = state.Output[pos].Value.value_or(0);
+        for (int i = 0; i < bytesPerPixel; ++i)
+            bytes += (char)((pixel >> (8 * i)) & 0xff);
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(bytes.data(), bytes.size());
+    return !file.fail();
+}
+
+
+//The following functions get data from the given input stream.
+//If the given output stream isn't null, it writes instructions to the user as it gets input.
+
+WFC::Array2D<WFC::Simple::Pixel> GetImageFromStream(std::istream& input, std::ostream* output)
+{
     const size_t maxUint = std::numeric_limits<size_t>().max();
 
     //Get the input image data.
@@ -179,6 +340,14 @@ WFC::Simple::InputData GetDataFromStream(std::istream& input, std::ostream* outp
             inputPixels[inputPos] = pixelsByRow[inputPos.y][inputPos.x];
     }
 
+    return inputPixels;
+}
+WFC::Simple::InputData GetDataFromStream(const WFC::Array2D<WFC::Simple::Pixel>& inputPixels,
+                                         std::istream& input, std::ostream* output)
+{
+    //Let input stream parse "true" as true and "false" as false.
+    std::boolalpha(input);
+
     WFC::Vector2i patternSize;
     if (output != nullptr)
         *output << "Enter the width of each pattern:\n";
@@ -260,16 +429,19 @@ void PrintOutput(const WFC::Simple::State& state, std::ostream& stream)
         {
             elementStr = std::to_string(*pixel.Value);
         }
-        else if (pixel.ColorFrequencies.size() == 0)
+        else if (pixel.Entropy == 0)
         {
             elementStr = "x";
         }
         else
         {
-            for (const auto& kvp : pixel.ColorFrequencies)
+            const size_t* frequencies = state.GetColorFrequencies(pos);
+            for (size_t colorI = 0; colorI < state.Input.GetPalette().size(); ++colorI)
             {
+                if (frequencies[colorI] == 0)
+                    continue;
                 elementStr += "|";
-                elementStr += std::to_string(kvp.second);
+                elementStr += std::to_string(frequencies[colorI]);
             }
         }
 
@@ -310,16 +482,50 @@ int main(int argc, char* argv[])
 {
     //Parse command-line options.
     bool shellMode = false;
+    std::string inputFilePath, outputFilePath;
+    size_t progressInterval = 0;
     for (int i = 1; i < argc; ++i)
     {
         if (std::string(argv[i]) == "-shellMode")
             shellMode = true;
+        else if (std::string(argv[i]) == "-inputFile" && i < argc - 1)
+            inputFilePath = argv[++i];
+        else if (std::string(argv[i]) == "-outputFile" && i < argc - 1)
+            outputFilePath = argv[++i];
+        else if (std::string(argv[i]) == "-progress" && i < argc - 1)
+            progressInterval = std::strtoull(argv[++i], nullptr, 10);
     }
 
     auto outputStream = (shellMode ? nullptr : &std::cout);
 
+    //Get the input image:
+    WFC::Array2D<WFC::Simple::Pixel> inputPixels;
+    int pamDepth = 4;
+    if (inputFilePath.empty())
+    {
+        inputPixels = GetImageFromStream(std::cin, outputStream);
+    }
+    else
+    {
+        std::vector<char> inputBytes;
+        if (!ReadWholeFile(inputFilePath, inputBytes))
+        {
+            if (!shellMode)
+                std::cout << "Unable to read \"" << inputFilePath << "\"\n";
+            return 3;
+        }
+        if (!TryParseBinaryImage(inputBytes, inputPixels, pamDepth))
+        {
+            if (!shellMode)
+                std::cout << "Input image \"" << inputFilePath << "\" is badly formed\n";
+            return 1;
+        }
+        if (pamDepth == 0)
+            pamDepth = 4;
+    }
+
     //Get input data:
-    auto inputData = GetDataFromStream(std::cin, shellMode ? nullptr : &std::cout);
+    auto inputData = GetDataFromStream(inputPixels, std::cin, outputStream);
     if (!shellMode)
         std::cout << "\n\n";
     auto wfcState = InitializeStateFromStream(inputData, std::cin, shellMode ? nullptr : &std::cout);
@@ -384,11 +590,30 @@ int main(int argc, char* argv[])
                 PrintOutput(wfcState, std::cout);
                 std::cout << "\n\n";
             }
+            //Print a summary of the progress so far.
+            if (progressInterval > 0 && (iterationCount % progressInterval) == 0)
+            {
+                size_t nSetPixels = 0;
+                for (WFC::Vector2i pos : WFC::Region2i(wfcState.Output.GetDimensions()))
+                    nSetPixels += wfcState.Output[pos].Value.has_value() ? 1 : 0;
+                (shellMode ? std::cerr : std::cout) <<
+                    "#" << iterationCount << ": " << nSetPixels << " of " <<
+                    wfcState.Output.GetNumbElements() << " pixels set\n";
+            }
         }
     }
 
-    //Print the final output.
-    PrintOutput(wfcState, std::cout);
+    //Output the final image.
+    if (outputFilePath.empty())
+    {
+        PrintOutput(wfcState, std::cout);
+    }
+    else if (!WriteBinaryImage(wfcState, (outputFilePath.ends_with(".pam") ? pamDepth : 0), outputFilePath))
+    {
+        if (!shellMode)
+            std::cout << "Unable to write \"" << outputFilePath << "\"\n";
+        errorCode = 3;
+    }
 
     if (!shellMode)
     {
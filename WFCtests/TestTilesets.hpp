@@ -3,8 +3,10 @@
 #include <UnitTest++.h>
 
 #include <Simple/State.h>
+#include <Simple/WaveState.h>
 #include <Tiled/State.h>
 #include <Tiled3D/StandardRunner.h>
+#include <Tiled3D/TilesetAnalysis.h>
 #include <Helpers/WFCppStreamPrinting.hpp>
 
 
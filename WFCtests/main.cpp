@@ -323,16 +323,542 @@ SUITE(Utils)
         CHECK_EQUAL(0, PositiveModulo(-6, 2));
         CHECK_EQUAL(3, PositiveModulo(-13, 4));
     }
+
+    TEST(BrickedArrays)
+    {
+        using namespace WFC;
+
+        //Use sizes that aren't a multiple of the brick size, to test the padding.
+        Array3D<int> arr3(ArrayLayouts::Bricked, { 5, 3, 9 }, -1);
+        CHECK_EQUAL(5 * 3 * 9, arr3.GetNumbElements());
+        CHECK_EQUAL(2 * 1 * 3 * Bricks::NElements, arr3.GetNumbStoredElements());
+        std::unordered_set<int> usedIndices;
+        for (Vector3i p : Region3i(arr3.GetDimensions()))
+        {
+            int i = arr3.GetIndex(p.x, p.y, p.z);
+            CHECK(i >= 0 && i < arr3.GetNumbStoredElements());
+            CHECK(usedIndices.insert(i).second);
+            CHECK_EQUAL(p, arr3.GetLocation(i));
+        }
+        //ForEach should visit every element once, in memory order.
+        int nVisited = 0, lastIndex = -1;
+        arr3.ForEach([&](const Vector3i& p, int& value)
+        {
+            int i = arr3.GetIndex(p.x, p.y, p.z);
+            CHECK(i > lastIndex);
+            lastIndex = i;
+            nVisited += 1;
+            value = p.x + (p.y * 100) + (p.z * 10000);
+        });
+        CHECK_EQUAL(arr3.GetNumbElements(), nVisited);
+        for (Vector3i p : Region3i(arr3.GetDimensions()))
+            CHECK_EQUAL(p.x + (p.y * 100) + (p.z * 10000), arr3[p]);
+
+        //In 4D, only the last three axes are bricked.
+        Array4D<int> arr4(ArrayLayouts::Bricked, { 3, 5, 6, 2 }, -1);
+        usedIndices.clear();
+        for (Vector4i p : Region4i(arr4.GetDimensions()))
+        {
+            int i = arr4.GetIndex(p.x, p.y, p.z, p.w);
+            CHECK(i >= 0 && i < arr4.GetNumbStoredElements());
+            CHECK(usedIndices.insert(i).second);
+            CHECK_EQUAL(p, arr4.GetLocation(i));
+            if (p.x > 0)
+                CHECK_EQUAL(i - 1, arr4.GetIndex(p.x - 1, p.y, p.z, p.w));
+        }
+        nVisited = 0;
+        lastIndex = -1;
+        arr4.ForEach([&](const Vector4i& p, int& value)
+        {
+            int i = arr4.GetIndex(p.x, p.y, p.z, p.w);
+            CHECK(i > lastIndex);
+            lastIndex = i;
+            nVisited += 1;
+        });
+        CHECK_EQUAL(arr4.GetNumbElements(), nVisited);
+    }
+
+    TEST(SparseIndexMap)
+    {
+        using namespace WFC;
+
+        SparseIndexMap<int> map;
+        CHECK(map.IsEmpty());
+        CHECK(map.Find(3) == nullptr);
+
+        //Insert enough to force a few rehashes, using clustered keys.
+        for (uint32_t key = 0; key < 1000; key += 2)
+            map[key] = static_cast<int>(key) * 10;
+        CHECK_EQUAL(500, map.GetSize());
+        for (uint32_t key = 0; key < 1000; ++key)
+        {
+            const auto* value = map.Find(key);
+            if (key % 2 == 0)
+            {
+                CHECK(value != nullptr);
+                if (value != nullptr)
+                    CHECK_EQUAL(static_cast<int>(key) * 10, *value);
+            }
+            else
+            {
+                CHECK(value == nullptr);
+            }
+        }
+
+        //Accessing an existing key shouldn't add anything.
+        map[4] += 1;
+        CHECK_EQUAL(41, *map.Find(4));
+        CHECK_EQUAL(500, map.GetSize());
+
+        CHECK_EQUAL(250, map.EraseIf([](uint32_t key, int) { return key % 4 == 0; }));
+        CHECK_EQUAL(250, map.GetSize());
+        CHECK(map.Find(4) == nullptr);
+        CHECK(map.Find(6) != nullptr);
+
+        int nVisited = 0;
+        map.ForEach([&](uint32_t key, int& value) { CHECK_EQUAL(static_cast<int>(key) * 10, value); nVisited += 1; });
+        CHECK_EQUAL(250, nVisited);
+
+        map.Clear();
+        CHECK(map.IsEmpty());
+        CHECK(map.Find(6) == nullptr);
+    }
+
+    TEST(DynamicBitset)
+    {
+        using namespace WFC;
+
+        //Use a capacity that isn't a multiple of the word size.
+        DynamicBitset set(130), full(130, true);
+        CHECK_EQUAL(0, set.Size());
+        CHECK_EQUAL(130, full.Size());
+        CHECK_EQUAL(130, set.First());
+        CHECK(full.Contains(129));
+
+        CHECK(!set.Add(3));
+        CHECK(set.Add(3));
+        set.Add(64);
+        set.Add(129);
+        CHECK_EQUAL(3, set.Size());
+        CHECK_EQUAL(3, set.First());
+
+        std::vector<size_t> elements;
+        for (size_t i : set)
+            elements.push_back(i);
+        CHECK_EQUAL(3, elements.size());
+        if (elements.size() == 3)
+        {
+            CHECK_EQUAL(3, elements[0]);
+            CHECK_EQUAL(64, elements[1]);
+            CHECK_EQUAL(129, elements[2]);
+        }
+
+        CHECK_EQUAL(3, full.Remove(set));
+        CHECK_EQUAL(127, full.Size());
+        CHECK(!full.Contains(64));
+        CHECK_EQUAL(127, full.Intersect(set));
+        CHECK(full.IsEmpty());
+
+        CHECK(set.Remove(64));
+        CHECK(!set.Remove(64));
+        CHECK_EQUAL(2, set.Size());
+
+        CHECK_EQUAL(2, full.Add(set));
+        CHECK(full == set);
+        full.SetWords(DynamicBitset(130, true).GetWords().data());
+        CHECK_EQUAL(130, full.Size());
+        CHECK_EQUAL(0, full.Add(set));
+
+        set.Clear();
+        CHECK(set.IsEmpty());
+        CHECK(set.begin() == set.end());
+    }
 }
 
 SUITE(WFC_Simple)
 {
     using namespace Tilesets::Simple;
+
+    TEST(InputDataPatterns)
+    {
+        //Stripes along X, so every 2x2 chunk is one of two patterns.
+        Array2D<Pixel> inputPixels(6, 5);
+        for (Vector2i pos : Region2i(inputPixels.GetDimensions()))
+            inputPixels[pos] = (pos.x % 2 == 0) ? 10 : 20;
+        InputData input(inputPixels, { 2, 2 }, false, false, false, false);
+
+        const auto& patterns = input.GetPatterns();
+        CHECK_EQUAL(2, patterns.size());
+        if (patterns.size() != 2)
+            return;
+
+        //The first chunk's pattern comes first.
+        CHECK_EQUAL(10, patterns[0][Vector2i(0, 1)]);
+        CHECK_EQUAL(20, patterns[0][Vector2i(1, 1)]);
+        CHECK_EQUAL(20, patterns[1][Vector2i(0, 0)]);
+        CHECK(!patterns[0].HasSameData(patterns[1]));
+
+        //There are 5x4 chunks; 3 of each row start on an even column.
+        CHECK_EQUAL(12, patterns[0].Frequency);
+        CHECK_EQUAL(8, patterns[1].Frequency);
+
+        //Colors are indexed in the order they first appear.
+        CHECK_EQUAL(2, input.GetPalette().size());
+        CHECK_EQUAL(0, input.GetPaletteIndex(10));
+        CHECK_EQUAL(1, input.GetPaletteIndex(20));
+        //Each pattern has two pixels of each color.
+        CHECK_EQUAL(2 * (12 + 8), input.GetColorFrequencies()[0]);
+        CHECK_EQUAL(2 * (12 + 8), input.GetColorFrequencies()[1]);
+    }
+    TEST(WaveStateSolve)
+    {
+        //A grid of lines, with a different color where they cross.
+        Array2D<Pixel> inputPixels(8, 8);
+        for (Vector2i pos : Region2i(inputPixels.GetDimensions()))
+        {
+            bool lineX = (pos.x % 4 == 0),
+                 lineY = (pos.y % 4 == 0);
+            inputPixels[pos] = (lineX && lineY) ? 2 : ((lineX || lineY) ? 1 : 0);
+        }
+        InputData input(inputPixels, { 3, 3 }, true, true, false, false);
+
+        const Vector2i outputSize(20, 16);
+        WaveState state(input, outputSize, 4321, true, false, 2);
+        std::vector<Vector2i> failedAt;
+        std::optional<bool> result;
+        for (int i = 0; i < 10000 && !result.has_value(); ++i)
+            result = state.Iterate(failedAt);
+        CHECK(result.has_value() && *result);
+        if (!result.has_value() || !*result)
+            return;
+
+        //Every cell that can hold a pattern should have exactly one,
+        //    and the output should match it.
+        for (Vector2i cellPos : Region2i(outputSize))
+        {
+            const auto& patterns = state.GetPossiblePatterns(cellPos);
+            CHECK(state.Output[cellPos].has_value());
+            if (cellPos.y > outputSize.y - 3)
+            {
+                CHECK(patterns.IsEmpty());
+                continue;
+            }
+
+            CHECK_EQUAL(1, patterns.Size());
+            const auto& pattern = input.GetPatterns()[patterns.First()];
+            for (Vector2i patternPos : Region2i(pattern.InputDataRegion.GetSize()))
+            {
+                Vector2i outputPos = cellPos + patternPos;
+                outputPos.x %= outputSize.x;
+                CHECK_EQUAL(pattern[patternPos], *state.Output[outputPos]);
+            }
+        }
+    }
+    TEST(WaveStateKeepsSetPixels)
+    {
+        //Lines whose spacing doesn't evenly divide the output,
+        //    so the algorithm runs into violations and has to clear areas.
+        Array2D<Pixel> inputPixels(9, 9);
+        for (Vector2i pos : Region2i(inputPixels.GetDimensions()))
+            inputPixels[pos] = (pos.x % 3 == 0 || pos.y % 4 == 0) ? 1 : ((pos.x + pos.y) % 5 == 0 ? 2 : 0);
+        InputData input(inputPixels, { 3, 3 }, false, false, true, true);
+
+        //Clearing an area around the set pixels shouldn't undo them.
+        const Vector2i outputSize(24, 24),
+                       setMin(6, 6), inputMin(1, 1);
+        for (unsigned int seed : { 1, 2 })
+        {
+            WaveState state(input, outputSize, seed, true, true, 1);
+            for (Vector2i pos : Region2i(Vector2i(4, 4)))
+                CHECK(state.SetPixel(setMin + pos, inputPixels[inputMin + pos]));
+
+            std::vector<Vector2i> failedAt;
+            std::optional<bool> result;
+            for (int i = 0; i < 10000 && !result.has_value(); ++i)
+                result = state.Iterate(failedAt);
+            CHECK(result.has_value() && *result);
+
+            for (Vector2i pos : Region2i(Vector2i(4, 4)))
+                CHECK(state.Output[setMin + pos] == std::optional<Pixel>(inputPixels[inputMin + pos]));
+        }
+
+        //If the set pixels can't be satisfied, the algorithm should fail instead of clearing forever.
+        //The "2" color never touches itself in the input.
+        WaveState state(input, outputSize, 3, true, true, 1);
+        state.SetPixel({ 3, 3 }, 2);
+        CHECK(!state.SetPixel({ 4, 3 }, 2));
+        std::vector<Vector2i> failedAt;
+        std::optional<bool> result;
+        for (int i = 0; i < 100 && !result.has_value(); ++i)
+            result = state.Iterate(failedAt);
+        CHECK(result.has_value() && !*result);
+        CHECK(!failedAt.empty());
+    }
+    TEST(StateThreadedRecalculation)
+    {
+        Array2D<Pixel> inputPixels(6, 6);
+        for (Vector2i pos : Region2i(inputPixels.GetDimensions()))
+            inputPixels[pos] = ((pos.x % 3 == 0) || (pos.y % 2 == 0)) ? 7 : 3;
+        InputData input(inputPixels, { 2, 2 }, true, true, true, false);
+
+        //Recalculating with several threads should give exactly the same results as with one.
+        State serialState(input, { 8, 8 }, 55, true, true, 1),
+              threadedState(input, { 8, 8 }, 55, true, true, 1);
+        threadedState.NThreads = 4;
+        for (auto* state : { &serialState, &threadedState })
+        {
+            state->SetPixel({ 1, 1 }, 7);
+            state->SetPixel({ 2, 1 }, 3);
+            state->SetPixel({ 7, 5 }, 3);
+        }
+
+        for (Vector2i pos : Region2i(serialState.Output.GetDimensions()))
+        {
+            CHECK_EQUAL(serialState.Output[pos].Entropy, threadedState.Output[pos].Entropy);
+            for (size_t colorI = 0; colorI < input.GetPalette().size(); ++colorI)
+                CHECK_EQUAL(serialState.GetColorFrequencies(pos)[colorI],
+                            threadedState.GetColorFrequencies(pos)[colorI]);
+        }
+    }
+    TEST(StateMaskedPatternFit)
+    {
+        //Non-square patterns with rotations but no reflections,
+        //    so the rotated patterns are a different shape from the original ones.
+        Array2D<Pixel> inputPixels(6, 6);
+        for (Vector2i pos : Region2i(inputPixels.GetDimensions()))
+            inputPixels[pos] = static_cast<Pixel>(((pos.x * 5) + (pos.y * pos.y)) % 3);
+        InputData input(inputPixels, { 2, 3 }, false, false, true, false);
+        CHECK_EQUAL(Vector2i(3, 3), input.MaxPatternSize);
+
+        for (bool periodic : { false, true })
+        {
+            const Vector2i outputSize(10, 10);
+            State state(input, outputSize, 91, periodic, periodic, 1);
+            for (int i = 0; i < 12; ++i)
+                state.SetPixel({ (i * 7) % outputSize.x, (i * 3) % outputSize.y },
+                               static_cast<Pixel>(i % 3));
+
+            //Test every pattern the way the state does, against a masked copy of each pixel's neighborhood,
+            //    and compare with testing it against the output directly.
+            for (Vector2i pixelPos : Region2i(outputSize))
+            {
+                Region2i neighborhood(pixelPos - input.MaxPatternSize + 1,
+                                      pixelPos + input.MaxPatternSize);
+                Vector2i neighborhoodSize = neighborhood.GetSize();
+                std::vector<Pixel> values(neighborhoodSize.x * neighborhoodSize.y),
+                                   masks(values.size());
+                state.GetNeighborhood(neighborhood, values.data(), masks.data());
+
+                for (Vector2i minCorner : Region2i(pixelPos - input.MaxPatternSize + 1, pixelPos + 1))
+                {
+                    Vector2i neighborhoodPos = minCorner - neighborhood.MinInclusive;
+                    size_t i = neighborhoodPos.x + (neighborhoodPos.y * neighborhoodSize.x);
+                    for (const auto& pattern : input.GetPatterns())
+                        CHECK_EQUAL(pattern.DoesFit(minCorner, state),
+                                    pattern.DoesFit(&values[i], &masks[i], neighborhoodSize.x));
+                }
+            }
+        }
+    }
+    TEST(StateSmallPeriodicOutput)
+    {
+        //An output narrower than a pattern,
+        //    so the area around a pixel wraps around and includes the pixel more than once.
+        Array2D<Pixel> inputPixels(6, 6);
+        for (Vector2i pos : Region2i(inputPixels.GetDimensions()))
+            inputPixels[pos] = static_cast<Pixel>(((pos.x * 5) + (pos.y * pos.y)) % 3);
+        InputData input(inputPixels, { 3, 3 }, true, true, true, false);
+        const auto& palette = input.GetPalette();
+
+        //Compares each pixel's color frequencies with testing patterns against the output directly,
+        //    placing each candidate color into the output itself.
+        auto checkFrequencies = [&](State& state)
+        {
+            for (Vector2i pixelPos : Region2i(state.Output.GetDimensions()))
+            {
+                if (state.Output[pixelPos].Value.has_value())
+                    continue;
+
+                std::vector<bool> badColors(palette.size(), false);
+                for (size_t colorI = 0; colorI < palette.size(); ++colorI)
+                {
+                    state.Output[pixelPos].Value = palette[colorI];
+                    for (Vector2i minCorner : Region2i(pixelPos - input.MaxPatternSize + 1, pixelPos + 1))
+                        if (std::none_of(input.GetPatterns().begin(), input.GetPatterns().end(),
+                                         [&](const Pattern& pattern) { return pattern.DoesFit(minCorner, state); }))
+                            badColors[colorI] = true;
+                    state.Output[pixelPos].Value = std::nullopt;
+                }
+
+                std::vector<size_t> expectedFrequencies(palette.size(), 0);
+                for (const auto& pattern : input.GetPatterns())
+                {
+                    Vector2i patternSize = pattern.InputDataRegion.GetSize();
+                    for (Vector2i minCorner : Region2i(pixelPos - patternSize + 1, pixelPos + 1))
+                    {
+                        size_t colorI = input.GetPaletteIndex(pattern[pixelPos - minCorner]);
+                        if (badColors[colorI] && pattern.DoesFit(minCorner, state))
+                            expectedFrequencies[colorI] += pattern.Frequency;
+                    }
+                }
+
+                for (size_t colorI = 0; colorI < palette.size(); ++colorI)
+                    CHECK_EQUAL(expectedFrequencies[colorI], state.GetColorFrequencies(pixelPos)[colorI]);
+            }
+        };
+
+        //The starting frequencies aren't calculated, so only check after each iteration.
+        for (Vector2i outputSize : { Vector2i(2, 3), Vector2i(3, 2) })
+            for (unsigned int seed = 1; seed <= 4; ++seed)
+            {
+                State state(input, outputSize, seed, true, true, 1);
+                std::vector<Vector2i> failedAt;
+                std::optional<bool> result;
+                for (int i = 0; i < 12 && !result.has_value(); ++i)
+                {
+                    result = state.Iterate(failedAt);
+                    checkFrequencies(state);
+                }
+            }
+    }
+    TEST(StateEntropyBuckets)
+    {
+        Array2D<Pixel> inputPixels(6, 6);
+        for (Vector2i pos : Region2i(inputPixels.GetDimensions()))
+            inputPixels[pos] = static_cast<Pixel>(((pos.x * 5) + (pos.y * pos.y)) % 3);
+        InputData input(inputPixels, { 2, 2 }, true, true, true, true);
+
+        const Vector2i outputSize(12, 9);
+        State state(input, outputSize, 1234, true, false, 1);
+
+        //The buckets should always give the same pixels as scanning the whole output.
+        auto sortPoses = [](std::vector<Vector2i>& poses)
+        {
+            std::sort(poses.begin(), poses.end(),
+                      [](Vector2i a, Vector2i b) { return (a.y < b.y) || (a.y == b.y && a.x < b.x); });
+        };
+        auto checkBestPixels = [&]()
+        {
+            std::vector<Vector2i> expected;
+            size_t minEntropy = std::numeric_limits<size_t>::max();
+            for (Vector2i pixelPos : Region2i(outputSize))
+            {
+                const auto& pixel = state.Output[pixelPos];
+                if (pixel.Value.has_value() || pixel.Entropy > minEntropy)
+                    continue;
+                if (pixel.Entropy < minEntropy)
+                    expected.clear();
+                minEntropy = pixel.Entropy;
+                expected.push_back(pixelPos);
+            }
+
+            std::vector<Vector2i> actual = state.GetBestPixels();
+            sortPoses(expected);
+            sortPoses(actual);
+            CHECK_EQUAL(expected.size(), actual.size());
+            CHECK(expected == actual);
+        };
+
+        //Mix up setting pixels, clearing areas, and running the algorithm.
+        checkBestPixels();
+        std::vector<Vector2i> failedAt;
+        for (int i = 0; i < 60; ++i)
+        {
+            Vector2i pos((i * 7) % outputSize.x, (i * 5) % outputSize.y);
+            switch (i % 3)
+            {
+                case 0: state.SetPixel(pos, static_cast<Pixel>(i % 3)); break;
+                case 1: state.ClearArea(pos); break;
+                case 2: state.Iterate(failedAt); break;
+            }
+            checkBestPixels();
+        }
+    }
 }
 
 SUITE(WFC_Tiled)
 {
     using namespace Tilesets::Tiled;
+
+    TEST(StateWeightedChoice)
+    {
+        //Every tile fits anywhere, but only one of them has any weight.
+        std::vector<Tile> tiles(3);
+        tiles[0].Weight = 0;
+        tiles[1].Weight = 5;
+        tiles[2].Weight = 0;
+        InputData input(tiles);
+        CHECK_EQUAL(5, input.GetMaxWeight());
+
+        State state(input, { 8, 8 }, 12345, false, false, 1, true);
+        std::vector<Vector2i> failedAt;
+        std::optional<bool> result;
+        for (int i = 0; i < 1000 && !result.has_value(); ++i)
+            result = state.Iterate(failedAt);
+
+        CHECK(result.has_value() && *result);
+        for (Vector2i pos : Region2i(state.Output.GetDimensions()))
+            CHECK_EQUAL(1, *state.Output[pos].Value);
+    }
+    TEST(StateWeightedEntropyLargeWeights)
+    {
+        //Weights this large can't each get their own entropy bucket.
+        std::vector<Tile> tiles(3);
+        tiles[0].Weight = 4000000000u;
+        tiles[1].Weight = 1;
+        tiles[2].Weight = 2000000000u;
+        InputData input(tiles);
+
+        State state(input, { 8, 8 }, 321, false, false, 1, true);
+        std::vector<Vector2i> failedAt;
+        std::optional<bool> result;
+        for (int i = 0; i < 1000 && !result.has_value(); ++i)
+            result = state.Iterate(failedAt);
+        CHECK(result.has_value() && *result);
+    }
+    TEST(StatePeriodicOneAxis)
+    {
+        //Tiles with every combination of two edge types,
+        //    except the ones with the same edge on all four sides.
+        std::vector<Tile> tiles;
+        for (int i = 1; i < 15; ++i)
+        {
+            Tile tile;
+            for (int edgeI = 0; edgeI < 4; ++edgeI)
+                tile.Edges[edgeI] = (i >> edgeI) & 1;
+            tiles.push_back(tile);
+        }
+        InputData input(tiles);
+
+        //Only wrap along X.
+        const Vector2i size(9, 6);
+        State state(input, size, 98765, true, false, 1);
+        state.MaxBacktracks = 4;
+        std::vector<Vector2i> failedAt;
+        std::optional<bool> result;
+        for (int i = 0; i < 10000 && !result.has_value(); ++i)
+            result = state.Iterate(failedAt);
+        CHECK(result.has_value() && *result);
+        if (!result.has_value() || !*result)
+            return;
+
+        for (Vector2i pos : Region2i(size))
+        {
+            const auto& tile = tiles[*state.Output[pos].Value];
+            const auto& right = tiles[*state.Output[Vector2i((pos.x + 1) % size.x, pos.y)].Value];
+            CHECK_EQUAL(tile.Edges[MaxX], right.Edges[MinX]);
+            if (pos.y + 1 < size.y)
+            {
+                const auto& below = tiles[*state.Output[pos.MoreY()].Value];
+                CHECK_EQUAL(tile.Edges[MaxY], below.Edges[MinY]);
+            }
+        }
+
+        //Positions past the non-wrapping axis don't exist.
+        CHECK(state[Vector2i(-1, 0)] != nullptr);
+        CHECK(state[Vector2i(0, -1)] == nullptr);
+        CHECK(state[Vector2i(0, size.y)] == nullptr);
+    }
 }
 
 SUITE(WFC_Tiled3D)
@@ -459,6 +985,28 @@ SUITE(WFC_Tiled3D)
         //TODO: Come up with some complex ones involving inversion; use Blender to visualize
     }
 
+    TEST(TransformLookupTables)
+    {
+        //The compile-time tables should agree with actually transforming points.
+        Vector3i testPos(1, 3, 5);
+        for (int trI = 0; trI < N_TRANSFORMS; ++trI)
+        {
+            auto tr = Transform3D::FromIndex(trI);
+            CHECK_EQUAL(trI, tr.GetIndex());
+
+            for (auto side : ALL_DIRECTIONS_3D)
+                CHECK_EQUAL(GetFaceDirection(tr.ApplyToSide(side)),
+                            tr.ApplyToPos(GetFaceDirection(side)));
+
+            for (int tr2I = 0; tr2I < N_TRANSFORMS; ++tr2I)
+            {
+                auto tr2 = Transform3D::FromIndex(tr2I);
+                CHECK_EQUAL(tr2.ApplyToPos(tr.ApplyToPos(testPos)),
+                            tr.Then(tr2).ApplyToPos(testPos));
+            }
+        }
+    }
+
     // NOTE: Tests of Tiled3D::GetFace() would be nice,
     //     but the asserts practically make it self-testing so it's not high-priority.
 
@@ -614,6 +1162,33 @@ SUITE(WFC_Tiled3D)
         CHECK_EQUAL(Transform3D{ WFC_CONCAT(true, Rotations3D::EdgesYa) }, vec[2]);
     }
 
+    TEST(TransformSetPart4)
+    {
+        //Test the bit-scanning helpers against plain iteration.
+        TransformSet set;
+        set.Add(Transform3D{ false, Rotations3D::AxisY_180 });
+        set.Add(Transform3D{ false, Rotations3D::EdgesZb });
+        set.Add(Transform3D{ true });
+        set.Add(Transform3D{ true, Rotations3D::CornerAAA_120 });
+        auto vec = ReadSet(set);
+        CHECK_EQUAL(4, vec.size());
+
+        std::vector<Transform3D> visited;
+        set.ForEach([&](Transform3D tr) { visited.push_back(tr); });
+        CHECK(visited == vec);
+
+        for (uint_fast8_t i = 0; i < set.Size(); ++i)
+        {
+            CHECK_EQUAL(vec[i], set.NthElement(i));
+            CHECK_EQUAL(i, set.Rank(vec[i]));
+        }
+        CHECK_EQUAL(0, set.Rank(Transform3D{ }));
+        CHECK_EQUAL(2, set.Rank(Transform3D{ false, Rotations3D::CornerAAA_120 }));
+
+        //'Combine()' shouldn't count duplicates.
+        CHECK_EQUAL(4, TransformSet::Combine(std::vector<Transform3D>{ vec[0], vec[1], vec[0], vec[2], vec[3] }).Size());
+    }
+
     TEST(ImplicitTransformSet)
     {
         ImplicitTransformSet s1;
@@ -714,6 +1289,46 @@ SUITE(WFC_Tiled3D)
             CHECK_EQUAL(4, cell.NPossibilities);
         }
     }
+    TEST(GridSymmetricPermutations)
+    {
+        //In SymmetricRods, the last tile looks the same under any rotation around Z,
+        //    while the first two tiles are changed by a 90-degree rotation but not a 180-degree one.
+        auto tileset = SymmetricRods::Create(Transform3D{ },
+                                             Transform3D{ false, Rotations3D::AxisZ_90 },
+                                             Transform3D{ false, Rotations3D::AxisZ_180 },
+                                             Transform3D{ false, Rotations3D::AxisZ_270 });
+        Grid grid(tileset.Tiles, { 3, 3, 3 });
+
+        CHECK_EQUAL(2, grid.GetCanonicalPermutations(0).Size());
+        CHECK_EQUAL(1, grid.GetCanonicalPermutations(2).Size());
+        CHECK_EQUAL(grid.GetCanonicalPermutations(0).Size() +
+                      grid.GetCanonicalPermutations(1).Size() +
+                      grid.GetCanonicalPermutations(2).Size(),
+                    grid.NPermutedTiles);
+        CHECK_EQUAL(TransformSet::Combine(WFC_CONCAT(Transform3D{ false, Rotations3D::AxisZ_90 },
+                                                     Transform3D{ false, Rotations3D::AxisZ_270 })),
+                    grid.GetEquivalentPermutations(0, Transform3D{ WFC_CONCAT(false, Rotations3D::AxisZ_270) }));
+        CHECK_EQUAL(Transform3D{ WFC_CONCAT(false, Rotations3D::AxisZ_90) },
+                    grid.GetCanonicalPermutation(0, Transform3D{ WFC_CONCAT(false, Rotations3D::AxisZ_270) }));
+        CHECK_EQUAL(tileset.Tiles[2].Permutations, grid.GetEquivalentPermutations(2, Transform3D{ }));
+        CHECK_EQUAL(grid.NPermutedTiles, grid.Cells[Vector3i(1, 1, 1)].NPossibilities);
+
+        //Each group is weighted by its size, so probabilities are the same as without grouping.
+        for (TileIdx tileI = 0; tileI < 3; ++tileI)
+            CHECK_CLOSE(4.0f * tileset.Tiles[tileI].Weight,
+                        grid.GetPermutationWeight(tileI, grid.GetCanonicalPermutations(tileI)),
+                        0.001f);
+
+        //Any member of a group can be placed, and is reported as-is.
+        Transform3D placed{ false, Rotations3D::AxisZ_180 };
+        CHECK(grid.IsLegalPlacement(Vector3i(1, 1, 1), 2, placed));
+        grid.SetCell({ 1, 1, 1 }, 2, placed, false);
+        CHECK_EQUAL(placed, grid.Cells[Vector3i(1, 1, 1)].ChosenPermutation);
+
+        //Forbidding one member of a group forbids the whole group.
+        grid.SetCellNot({ 0, 0, 0 }, 2, TransformSet::Combine(placed));
+        CHECK_EQUAL(TransformSet{ }, grid.PossiblePermutations[WFC_CONCAT({ 2, { 0, 0, 0 } })]);
+    }
     TEST(GridModification)
     {
         //Use two permutations of the single-tile tileset
@@ -855,6 +1470,135 @@ SUITE(WFC_Tiled3D)
         CHECK_EQUAL(0, report.GotInteresting.size());
         CHECK_EQUAL(0, report.GotUnsolvable.size());
     }
+    TEST(GridUndoNextToSetCell)
+    {
+        //Undoing a cell shouldn't touch its neighbors that were already set.
+        auto tileset = SymmetricRods::Create(Transform3D{ }, Transform3D{ false, Rotations3D::AxisZ_90 });
+        Grid grid(tileset.Tiles, { 4, 4, 4 });
+        const Vector3i firstCell(1, 1, 1),
+                       secondCell(1, 1, 2);
+
+        grid.SetCell(firstCell, 0, Transform3D{ }, false, nullptr, false);
+        grid.SetCell(secondCell, 0, Transform3D{ }, false, nullptr, false);
+        grid.UnwindActionHistory();
+        CHECK(grid.Cells[firstCell].IsSet());
+        CHECK(!grid.Cells[secondCell].IsSet());
+        CHECK_EQUAL(1, grid.Cells[firstCell].NPossibilities);
+
+        //Clearing the first cell should then free up it and its neighbors.
+        grid.ClearCells(Region3i(firstCell, firstCell + 1));
+        CHECK(!grid.Cells[firstCell].IsSet());
+        CHECK_EQUAL(grid.NPermutedTiles, grid.Cells[firstCell].NPossibilities);
+        CHECK_EQUAL(grid.NPermutedTiles, grid.Cells[secondCell].NPossibilities);
+        CHECK_EQUAL(grid.NPermutedTiles, grid.Cells[firstCell.LessZ()].NPossibilities);
+    }
+    TEST(GridNeighborIndices)
+    {
+        //The precomputed neighbor tables should agree with plain position math,
+        //    for every layout and periodicity.
+        auto tiles = OneTileArmy(Transform3D{ });
+        const Vector3i gridSize{ 5, 1, 6 };
+        for (auto layout : { ArrayLayouts::RowMajor, ArrayLayouts::Bricked })
+            for (int periodicity = 0; periodicity < 8; ++periodicity)
+            {
+                Grid grid(tiles, gridSize,
+                          (periodicity & 1) != 0, (periodicity & 2) != 0, (periodicity & 4) != 0,
+                          layout);
+                for (Vector3i cellPos : Region3i(gridSize))
+                    for (int dirI = 0; dirI < N_DIRECTIONS_3D; ++dirI)
+                    {
+                        auto dir = static_cast<Directions3D>(dirI);
+                        auto neighborPos = grid.FilterPos(cellPos + GetFaceDirection(dir));
+                        auto expected = grid.Cells.IsIndexValid(neighborPos) ?
+                                            grid.GetCellIdx(neighborPos) :
+                                            CellIdx_INVALID;
+                        CHECK_EQUAL(expected, grid.GetNeighborIdx(grid.GetCellIdx(cellPos), dir));
+                    }
+            }
+    }
+
+    TEST(GridDirtyReset)
+    {
+        //Resetting only the changed cells should give the same result as a fresh grid.
+        auto tileset = SymmetricRods::Create(Transform3D{ false, Rotations3D::None });
+        const Vector3i gridSize{ 9, 6, 5 };
+        for (auto layout : { ArrayLayouts::RowMajor, ArrayLayouts::Bricked })
+        {
+            StandardRunner state(tileset.Tiles, gridSize, false, false, false,
+                                 { 0x3c6ef372fe94f82b }, layout);
+            Grid fresh(tileset.Tiles, gridSize, false, false, false, layout);
+
+            //Give both grids the same permanent constraint.
+            state.SetCellConstraintNot({ 7, 1, 2 }, 0);
+            fresh.SetCellNot({ 7, 1, 2 }, 0);
+            fresh.Reset();
+
+            //Only touch part of the grid before resetting.
+            state.Reset();
+            state.TickN(30);
+            state.Grid.Reset();
+
+            for (Vector3i cellPos : Region3i(gridSize))
+            {
+                const auto& cell = state.Grid.Cells[cellPos];
+                const auto& expected = fresh.Cells[cellPos];
+                CHECK_EQUAL(expected.ChosenTile, cell.ChosenTile);
+                CHECK_EQUAL(expected.NPossibilities, cell.NPossibilities);
+                CHECK_EQUAL(expected.WeightSum, cell.WeightSum);
+                CHECK_EQUAL(expected.WeightLogWeightSum, cell.WeightLogWeightSum);
+                for (int tileI = 0; tileI < (int)tileset.Tiles.size(); ++tileI)
+                    CHECK(fresh.PossiblePermutations[Vector4i(tileI, cellPos)] ==
+                            state.Grid.PossiblePermutations[Vector4i(tileI, cellPos)]);
+            }
+            CHECK(state.Grid.ActionHistory.empty());
+        }
+    }
+
+    TEST(GridWeightedEntropy)
+    {
+        //SymmetricRods has tiles of uneven weight.
+        auto tileset = SymmetricRods::Create(Transform3D{ }, Transform3D{ false, Rotations3D::AxisZ_90 });
+        Grid grid(tileset.Tiles, { 4, 4, 4 });
+
+        //Computes the weighted entropy of a cell from scratch.
+        auto expectedEntropy = [&](Vector3i cellPos)
+        {
+            double weightSum = 0, weightLogWeightSum = 0;
+            //Each permutation in a cell stands in for every permutation that produces the same cube.
+            for (int tileI = 0; tileI < (int)grid.InputTiles.size(); ++tileI)
+                for (Transform3D permutation : grid.PossiblePermutations[Vector4i{ tileI, cellPos }])
+                {
+                    double w = grid.InputTiles[tileI].Weight *
+                               grid.GetEquivalentPermutations((TileIdx)tileI, permutation).Size();
+                    weightSum += w;
+                    weightLogWeightSum += w * std::log(w);
+                }
+            return (weightSum <= 0) ? 0.0 : (std::log(weightSum) - (weightLogWeightSum / weightSum));
+        };
+        auto checkAllCells = [&]()
+        {
+            for (Vector3i cellPos : Region3i(grid.Cells.GetDimensions()))
+                if (!grid.Cells[cellPos].IsSet())
+                    CHECK_CLOSE(expectedEntropy(cellPos), grid.Cells[cellPos].GetWeightedEntropy(), 0.0001);
+        };
+
+        CHECK_CLOSE(expectedEntropy(Vector3i(0, 0, 0)), grid.GetMaxWeightedEntropy(), 0.0001);
+        checkAllCells();
+
+        //Narrow down some cells, then undo and clear them,
+        //    and check that the running sums stay in sync the whole time.
+        grid.SetCell({ 1, 1, 1 }, 2, Transform3D{ }, false, nullptr, false);
+        grid.SetCell({ 1, 1, 2 }, 0, Transform3D{ }, false, nullptr, false);
+        checkAllCells();
+        CHECK(grid.Cells[Vector3i(1, 1, 0)].GetWeightedEntropy() < grid.GetMaxWeightedEntropy());
+
+        grid.UnwindActionHistory();
+        checkAllCells();
+
+        grid.ClearCells(Region3i(grid.Cells.GetDimensions()));
+        checkAllCells();
+        CHECK_CLOSE(grid.GetMaxWeightedEntropy(), grid.Cells[Vector3i(1, 1, 0)].GetWeightedEntropy(), 0.0001);
+    }
 
     TEST(StandardRunnerTick)
     {
@@ -955,6 +1699,239 @@ SUITE(WFC_Tiled3D)
 
         //TODO: Check the result is valid, using 'tileset.FaceGroups'.
     }
+    TEST(TilesetAnalysisPruning)
+    {
+        //Add two tiles to the single-tile tileset:
+        //    one with a MinX face that nothing matches,
+        //    and one whose MinX face only matches the first one's MaxX face.
+        auto tiles = OneTileArmy(Transform3D{ });
+        Tile doomedTile = tiles[0],
+             dependentTile = tiles[0];
+        doomedTile.Data.Faces[MinX].Points = { { 9, 9, 9, 9 }, { 0, 0, 0, 0 } };
+        doomedTile.Data.Faces[MaxX].Points = { { 7, 7, 7, 7 }, { 0, 0, 0, 0 } };
+        dependentTile.Data.Faces[MinX].Points = { { 7, 7, 7, 7 }, { 0, 0, 0, 0 } };
+        tiles.push_back(doomedTile);
+        tiles.push_back(dependentTile);
+
+        TilesetAnalysis analysis(tiles);
+        CHECK_EQUAL(2, analysis.NPruningRounds);
+        CHECK_EQUAL(2, analysis.NDeadPermutations);
+        CHECK_EQUAL(2, analysis.NDeadTiles);
+        CHECK_EQUAL(1, analysis.NUnmatchedFaces);
+        CHECK_EQUAL(TransformSet{ }, analysis.DeadPermutations[0]);
+        CHECK_EQUAL(tiles[1].Permutations, analysis.DeadPermutations[1]);
+        CHECK_EQUAL(tiles[2].Permutations, analysis.DeadPermutations[2]);
+        //The surviving tile can only sit against itself.
+        CHECK_EQUAL(1, analysis.MinNeighborOptionsPerTile[0]);
+        CHECK_EQUAL(0, analysis.MinNeighborOptionsPerTile[1]);
+        CHECK_EQUAL(1, analysis.MinNeighborOptions);
+        CHECK_EQUAL(1, analysis.MaxNeighborOptions);
+        CHECK_CLOSE(1.0f, analysis.AverageNeighborOptions, 0.0001f);
+
+        //The pruned tileset should never place the dead tiles.
+        analysis.Prune(tiles);
+        CHECK_EQUAL(3, tiles.size());
+        CHECK_EQUAL(1, tiles[0].Permutations.Size());
+        CHECK_EQUAL(0, tiles[1].Permutations.Size());
+        CHECK_EQUAL(0, tiles[2].Permutations.Size());
+        StandardRunner state(tiles, { 3, 3, 3 }, { 0x510e527fade682d1 });
+        CHECK(state.TickN(state.Grid.Cells.GetNumbElements() * 10));
+        for (Vector3i cellPos : Region3i(state.Grid.Cells.GetDimensions()))
+            CHECK_EQUAL(0, state.Grid.Cells[cellPos].ChosenTile);
+
+        //Without any rotations, SymmetricRods' last two tiles can only sit along the edges of a grid,
+        //    so they count as dead.
+        auto rods = SymmetricRods::Create(Transform3D{ });
+        TilesetAnalysis rodsAnalysis(rods.Tiles);
+        CHECK_EQUAL(2, rodsAnalysis.NDeadTiles);
+        CHECK_EQUAL(TransformSet{ }, rodsAnalysis.DeadPermutations[0]);
+    }
+
+    TEST(StandardRunnerWeightedEntropy)
+    {
+        auto tileset = SymmetricRods::Create(Transform3D{ false, Rotations3D::None });
+
+        StandardRunner state(
+            tileset.Tiles, { 4, 4, 8 },
+            { 0x2b9a67ef01c3d455 }
+        );
+        state.EntropyHeuristic = EntropyHeuristics::WeightedShannon;
+        state.ClearRegionGrowthRateT = 0.001f;
+        state.PriorityWeightRandomness = 0;
+        state.Reset();
+
+        bool finished = state.TickN(state.Grid.Cells.GetNumbElements() * 2000);
+        CHECK(finished);
+    }
+    TEST(StandardRunnerBrickedLayout)
+    {
+        //The memory layout shouldn't change anything about the algorithm.
+        auto tileset = SymmetricRods::Create(Transform3D{ false, Rotations3D::None });
+        const Vector3i gridSize{ 6, 5, 7 };
+        StandardRunner rowMajor(tileset.Tiles, gridSize, false, false, false,
+                                { 0x6a09e667f3bcc908 }, ArrayLayouts::RowMajor),
+                       bricked(tileset.Tiles, gridSize, false, false, false,
+                               { 0x6a09e667f3bcc908 }, ArrayLayouts::Bricked);
+        CHECK(bricked.Grid.Cells.GetLayout() == ArrayLayouts::Bricked);
+        CHECK(bricked.Grid.PossiblePermutations.GetLayout() == ArrayLayouts::Bricked);
+
+        for (auto* state : { &rowMajor, &bricked })
+        {
+            state->ClearRegionGrowthRateT = 0.001f;
+            state->PriorityWeightRandomness = 0;
+            state->Reset();
+        }
+
+        bool finished1 = rowMajor.TickN(gridSize.x * gridSize.y * gridSize.z * 2000),
+             finished2 = bricked.TickN(gridSize.x * gridSize.y * gridSize.z * 2000);
+        CHECK(finished1);
+        CHECK(finished2);
+        CHECK_EQUAL(rowMajor.CurrentTimestamp, bricked.CurrentTimestamp);
+        for (Vector3i cellPos : Region3i(gridSize))
+        {
+            CHECK_EQUAL(rowMajor.Grid.Cells[cellPos].ChosenTile, bricked.Grid.Cells[cellPos].ChosenTile);
+            CHECK_EQUAL(rowMajor.Grid.Cells[cellPos].ChosenPermutation, bricked.Grid.Cells[cellPos].ChosenPermutation);
+        }
+    }
+
+    TEST(StandardRunnerFaceDomains)
+    {
+        //Tracking side faces instead of permutations shouldn't change anything about the algorithm.
+        auto tileset = SymmetricRods::Create(Transform3D{ false, Rotations3D::None },
+                                             Transform3D{ false, Rotations3D::AxisZ_90 });
+        const Vector3i gridSize{ 6, 5, 7 };
+        StandardRunner permutations(tileset.Tiles, gridSize, true, false, false,
+                                    { 0x3c6ef372fe94f82b }, ArrayLayouts::RowMajor,
+                                    PropagationModes::Permutations),
+                       faces(tileset.Tiles, gridSize, true, false, false,
+                             { 0x3c6ef372fe94f82b }, ArrayLayouts::RowMajor,
+                             PropagationModes::Faces);
+        CHECK(faces.Grid.GetPropagationMode() == PropagationModes::Faces);
+
+        for (auto* state : { &permutations, &faces })
+        {
+            state->SetCellConstraintNot({ 2, 2, 2 }, 0);
+            state->ClearRegionGrowthRateT = 0.001f;
+            state->Reset();
+        }
+
+        //Partway through, every unset cell should have the same possibilities.
+        permutations.TickN(60);
+        faces.TickN(60);
+        for (Vector3i cellPos : Region3i(gridSize))
+        {
+            const auto& expected = permutations.Grid.Cells[cellPos];
+            const auto& actual = faces.Grid.Cells[cellPos];
+            CHECK_EQUAL(expected.ChosenTile, actual.ChosenTile);
+            CHECK_EQUAL(expected.NPossibilities, actual.NPossibilities);
+            CHECK_CLOSE(expected.GetWeightedEntropy(), actual.GetWeightedEntropy(), 0.0001f);
+            if (!expected.IsSet())
+            {
+                const auto* expectedPossibilities = permutations.Grid.GetPossiblePermutations(cellPos);
+                const auto* actualPossibilities = faces.Grid.GetPossiblePermutations(cellPos);
+                for (size_t tileI = 0; tileI < tileset.Tiles.size(); ++tileI)
+                    CHECK(expectedPossibilities[tileI] == actualPossibilities[tileI]);
+            }
+        }
+        CHECK(faces.Grid.StatePreActionHistory.empty());
+
+        bool finished1 = permutations.TickN(gridSize.x * gridSize.y * gridSize.z * 2000),
+             finished2 = faces.TickN(gridSize.x * gridSize.y * gridSize.z * 2000);
+        CHECK(finished1);
+        CHECK(finished2);
+        CHECK_EQUAL(permutations.CurrentTimestamp, faces.CurrentTimestamp);
+        for (Vector3i cellPos : Region3i(gridSize))
+        {
+            CHECK_EQUAL(permutations.Grid.Cells[cellPos].ChosenTile, faces.Grid.Cells[cellPos].ChosenTile);
+            CHECK_EQUAL(permutations.Grid.Cells[cellPos].ChosenPermutation, faces.Grid.Cells[cellPos].ChosenPermutation);
+        }
+    }
+
+    TEST(StandardRunnerBackjumping)
+    {
+        //Use two permutations of a single tile, which are compatible along Z but not X or Y.
+        TransformSet usedTransforms;
+        usedTransforms.Add(Transform3D{ });
+        usedTransforms.Add(Transform3D{ false, Rotations3D::AxisZ_90 });
+        StandardRunner state(OneTileArmy(usedTransforms), { 3, 1, 2 }, { 0x510e527fade682d1 });
+        state.RecoveryStrategy = RecoveryStrategies::Backjumping;
+        state.Reset();
+
+        //Make the middle cell unsolvable, then place an unrelated cell afterwards.
+        state.SetCell({ 0, 0, 0 }, 0, Transform3D{ });
+        state.SetCell({ 2, 0, 0 }, 0, Transform3D{ false, Rotations3D::AxisZ_90 });
+        state.SetCell({ 0, 0, 1 }, 0, Transform3D{ });
+        CHECK(state.GetUnsolvableCells().contains({ 1, 0, 0 }));
+
+        //It should jump straight back to the most recent culprit,
+        //    and remember that it can't be used alongside the other one.
+        state.Tick();
+        CHECK(state.LastAction == StandardRunnerAction{ StandardRunnerAction_UndoCells{ 2 } });
+        CHECK(state.GetUnsolvableCells().empty());
+        CHECK(state.Grid.Cells[Vector3i(0, 0, 0)].IsSet());
+        CHECK(!state.Grid.Cells[Vector3i(2, 0, 0)].IsSet());
+        CHECK(!state.Grid.Cells[Vector3i(0, 0, 1)].IsSet());
+        CHECK(state.Grid.Cells[Vector3i(1, 0, 0)].NPossibilities > 0);
+
+        const auto* nogoods = state.Nogoods.Find(state.Grid.GetCellIdx({ 2, 0, 0 }));
+        CHECK(nogoods != nullptr);
+        if (nogoods != nullptr)
+        {
+            CHECK_EQUAL(1, nogoods->size());
+            const auto& nogood = nogoods->front();
+            CHECK_EQUAL(state.Grid.GetCanonicalPermutation(0, Transform3D{ false, Rotations3D::AxisZ_90 }),
+                        nogood.Permutation);
+            CHECK_EQUAL(1, nogood.Context.size());
+            CHECK_EQUAL(Vector3i(0, 0, 0), nogood.Context[0].Cell);
+            CHECK(state.IsNogoodActive(nogood));
+        }
+
+        CHECK(state.TickN(1000));
+        state.Reset();
+        CHECK(state.Nogoods.IsEmpty());
+
+        //Backjumping should also solve a bigger grid.
+        auto tileset = SymmetricRods::Create(Transform3D{ false, Rotations3D::None },
+                                             Transform3D{ false, Rotations3D::AxisZ_90 });
+        const Vector3i gridSize{ 6, 5, 7 };
+        StandardRunner bigState(tileset.Tiles, gridSize, { 0x9b05688c2b3e6c1f });
+        bigState.RecoveryStrategy = RecoveryStrategies::Backjumping;
+        bigState.Reset();
+        CHECK(bigState.TickN(gridSize.x * gridSize.y * gridSize.z * 2000));
+        for (Vector3i cellPos : Region3i(gridSize))
+        {
+            const auto& cell = bigState.Grid.Cells[cellPos];
+            CHECK(cell.IsSet());
+            CHECK(bigState.Grid.IsLegalPlacement(cellPos, cell.ChosenTile, cell.ChosenPermutation));
+        }
+    }
+
+    TEST(StandardRunnerSparseHistory)
+    {
+        auto tileset = SymmetricRods::Create(Transform3D{ false, Rotations3D::None });
+        const Vector3i gridSize{ 6, 5, 7 };
+        StandardRunner state(tileset.Tiles, gridSize, { 0xbb67ae8584caa73b });
+        state.ClearRegionGrowthRateT = 0.001f;
+        state.Reset();
+        CHECK(state.History.IsEmpty());
+
+        bool finished = state.TickN(gridSize.x * gridSize.y * gridSize.z * 2000);
+        CHECK(finished);
+        CHECK(state.History.GetSize() <= static_cast<size_t>(state.Grid.Cells.GetNumbElements()));
+
+        //Pruning shouldn't change any temperatures.
+        Array3D<float> temperatures(gridSize);
+        for (Vector3i cellPos : Region3i(gridSize))
+            temperatures[cellPos] = state.GetTemperature(cellPos);
+        size_t nBefore = state.History.GetSize(),
+               nPruned = state.PruneHistory();
+        CHECK_EQUAL(nBefore - nPruned, state.History.GetSize());
+        for (Vector3i cellPos : Region3i(gridSize))
+            CHECK_EQUAL(temperatures[cellPos], state.GetTemperature(cellPos));
+
+        state.Reset();
+        CHECK(state.History.IsEmpty());
+    }
 
     TEST(StandardRunnerTickN)
     {
@@ -44,10 +44,90 @@ CmdArgs::CmdArgs(int nArgs, char** argData,
                 return;
             }
         }
+        else if (argData[i] == std::string("-batch"))
+        {
+            if (i >= nArgs - 1)
+            {
+                outErrMsg = "No number given after -batch argument!";
+                outErrCode = 7;
+                return;
+            }
+
+            i += 1;
+            std::string batchStr = argData[i];
+            if (!Utils::TryParse(batchStr, BatchSize) || BatchSize == 0)
+            {
+                outErrCode = 7;
+                outErrMsg = "-batch argument \"" + batchStr +
+                                "\" isn't a valid positive integer";
+                return;
+            }
+        }
+        else if (argData[i] == std::string("-seeds"))
+        {
+            if (i >= nArgs - 1)
+            {
+                outErrMsg = "No list of seeds given after -seeds argument!";
+                outErrCode = 7;
+                return;
+            }
+
+            i += 1;
+            std::vector<std::string> seedStrs;
+            Utils::Split(argData[i], seedStrs, [](char c) { return c == ','; });
+            for (const auto& seedStr : seedStrs)
+            {
+                size_t seed;
+                if (!Utils::TryParse(seedStr, seed))
+                {
+                    outErrCode = 7;
+                    outErrMsg = "-seeds argument \"" + seedStr +
+                                    "\" isn't a valid non-negative integer";
+                    return;
+                }
+                Seeds.push_back(seed);
+            }
+        }
+        else if (argData[i] == std::string("-outdir"))
+        {
+            if (i >= nArgs - 1)
+            {
+                outErrMsg = "No path given after -outdir argument!";
+                outErrCode = 7;
+                return;
+            }
+
+            i += 1;
+            OutputDir = argData[i];
+        }
+        else if (argData[i] == std::string("-threads"))
+        {
+            if (i >= nArgs - 1)
+            {
+                outErrMsg = "No number given after -threads argument!";
+                outErrCode = 7;
+                return;
+            }
+
+            i += 1;
+            std::string threadsStr = argData[i];
+            if (!Utils::TryParse(threadsStr, NThreads))
+            {
+                outErrCode = 7;
+                outErrMsg = "-threads argument \"" + threadsStr +
+                                "\" isn't a valid non-negative integer";
+                return;
+            }
+        }
         else if (argData[i] == std::string("-pgm"))
         {
             PgmMode = true;
         }
+        else if (argData[i] == std::string("-pgm5"))
+        {
+            PgmMode = true;
+            BinaryPgm = true;
+        }
         else
         {
             outErrMsg = std::string("Unexpected argument: ") + argData[i];
@@ -55,6 +135,13 @@ CmdArgs::CmdArgs(int nArgs, char** argData,
             return;
         }
     }
+
+    if (BatchSize > 0 && !Seeds.empty() && BatchSize != Seeds.size())
+    {
+        outErrMsg = "-batch and -seeds disagree on the number of outputs";
+        outErrCode = 7;
+        return;
+    }
 }
 
 bool CmdArgs::ReadDataFile(const std::string& name, std::string& outContents) const
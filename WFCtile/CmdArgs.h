@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include <filesystem>
 namespace fs = std::filesystem;
@@ -11,6 +12,17 @@ struct CmdArgs
     fs::path DataDir;
     size_t ProgressInterval = 0;
     bool PgmMode = false;
+    //If true, PGM output uses the binary format (P5) instead of text (P2).
+    bool BinaryPgm = false;
+
+    //Batch mode: generates several outputs from one run, each with its own seed,
+    //    and writes them to numbered files in 'OutputDir' instead of stdout.
+    //The seeds are either listed explicitly, or counted up from OUTPUT.txt's seed.
+    size_t BatchSize = 0;
+    std::vector<size_t> Seeds;
+    fs::path OutputDir = ".";
+    //The number of threads to use; 0 means one per CPU core.
+    size_t NThreads = 0;
 
     CmdArgs() { }
     CmdArgs(int nArgs, char** argData,
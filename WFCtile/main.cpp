@@ -8,10 +8,19 @@
 #include <functional>
 #include <unordered_set>
 #include <array>
+#include <thread>
+#include <atomic>
+#include <charconv>
 
 #include <filesystem>
 namespace fs = std::filesystem;
 
+#ifdef _WIN32
+    #include <cstdio>
+    #include <io.h>
+    #include <fcntl.h>
+#endif
+
 #include "Utils.h"
 #include "CmdArgs.h"
 #include "InputFile.h"
@@ -42,7 +51,16 @@ namespace WFCT = WFC::Tiled;
 
 //You can also make the program log its progress every N iterations with -progress N
 
-//Finally, you can change the output format from binary to a PGM image file with "-pgm".
+//Finally, you can change the output format from binary to a PGM image file with "-pgm",
+//    or to a binary PGM image file (smaller and faster to write) with "-pgm5".
+
+//To generate many outputs from one run, use "-batch N" to count N seeds up from OUTPUT.txt's seed,
+//    and/or "-seeds A,B,C" to list them explicitly.
+//The outputs are generated in parallel ("-threads N" to limit it),
+//    and each one is written to its own file in the current directory ("-outdir path" to change it),
+//    named "output_0", "output_1", etc.
+//The extension is ".pgm" in PGM mode, or ".bin" otherwise, but a failed output doesn't get a file.
+//In batch mode, error code 15 means that at least one output failed.
 
 
 //Returns the following error codes:
@@ -186,11 +204,250 @@ std::tuple<WFCT::TilePermutator, WFCT::InputData>
 }
 
 
+//Applies each permuted tile's transformation to its root tile's pixels ahead of time,
+//    so that the output image can be assembled by copying whole rows of pixels.
+std::vector<WFC::Array2D<Pixel_t>> BakeTilePixels(const WFCT::TilePermutator& permutator,
+                                                  const std::vector<TileFile>& tiles,
+                                                  WFC::Vector2i tileSize)
+{
+    std::vector<WFC::Array2D<Pixel_t>> bakedTiles(permutator.GetTiles().size());
+    for (TileID_t tileID = 0; tileID < bakedTiles.size(); ++tileID)
+    {
+        //Get the pixel array of the original, un-transformed version of this tile.
+        const auto& tilePixels = tiles[permutator.GetTileRoot(tileID)].Pixels;
+
+        //Look up each pixel with this tile's transformation.
+        auto transform = WFC::Invert(permutator.GetMyPermutation(tileID));
+        auto& bakedPixels = bakedTiles[tileID];
+        bakedPixels.Reset(tileSize.x, tileSize.y);
+        for (WFC::Vector2i tilePos : WFC::Region2i(tileSize))
+            bakedPixels[tilePos] = tilePixels[tilePos.Transform(transform, tilePixels.GetDimensions())];
+    }
+
+    return bakedTiles;
+}
+
+//Assembles a finished output's tiles into one image, with the rows split across threads.
+WFC::Array2D<Pixel_t> RenderOutput(const WFCT::State& state,
+                                   const std::vector<WFC::Array2D<Pixel_t>>& bakedTiles,
+                                   WFC::Vector2i tileSize, int nThreads)
+{
+    WFC::Array2D<Pixel_t> image(state.Output.GetDimensions() * tileSize);
+    auto renderRows = [&](int startY, int endY)
+    {
+        for (int pY = startY; pY < endY; ++pY)
+        {
+            int tY = pY / tileSize.y;
+            int tpY = pY % tileSize.y;
+
+            Pixel_t* imageRow = &image[WFC::Vector2i(0, pY)];
+            for (int tX = 0; tX < state.Output.GetWidth(); ++tX)
+            {
+                const auto& bakedTile = bakedTiles[*state.Output[WFC::Vector2i(tX, tY)].Value];
+                std::copy_n(&bakedTile[WFC::Vector2i(0, tpY)], tileSize.x,
+                            imageRow + (tX * tileSize.x));
+            }
+        }
+    };
+
+    nThreads = std::clamp(nThreads, 1, std::max(1, image.GetHeight()));
+    std::vector<std::thread> threads;
+    for (int threadI = 1; threadI < nThreads; ++threadI)
+        threads.emplace_back(renderRows,
+                             (image.GetHeight() * threadI) / nThreads,
+                             (image.GetHeight() * (threadI + 1)) / nThreads);
+    renderRows(0, image.GetHeight() / nThreads);
+    for (auto& thread : threads)
+        thread.join();
+
+    return image;
+}
+
+//Converts a finished output image to the format chosen on the command line.
+std::string EncodeOutput(const WFC::Array2D<Pixel_t>& image, Pixel_t maxVal, const CmdArgs& args)
+{
+    std::string bytes;
+
+    //Output the results header.
+    if (args.PgmMode)
+    {
+        bytes += args.BinaryPgm ? "P5\n" : "P2\n";
+        bytes += std::to_string(image.GetWidth()) + " " + std::to_string(image.GetHeight()) + "\n";
+        bytes += std::to_string((int)maxVal) + (args.BinaryPgm ? "\n" : "\n\n");
+    }
+    else
+    {
+        bytes += (char)1;
+    }
+
+    //Output the results data.
+    if (args.PgmMode && !args.BinaryPgm)
+    {
+        char numberStr[4];
+        for (int y = 0; y < image.GetHeight(); ++y)
+        {
+            const Pixel_t* row = &image[WFC::Vector2i(0, y)];
+            for (int x = 0; x < image.GetWidth(); ++x)
+            {
+                auto numberEnd = std::to_chars(numberStr, numberStr + 4, (int)row[x]).ptr;
+                bytes.append(numberStr, numberEnd);
+                bytes += ' ';
+            }
+            bytes += '\n';
+        }
+    }
+    else
+    {
+        const Pixel_t* pixels = &image[WFC::Vector2i(0, 0)];
+        bytes.append((const char*)pixels, (size_t)image.GetNumbElements());
+    }
+
+    return bytes;
+}
+
+//Prints a finished output image as evenly-spaced numbers, for the log.
+std::string PrintOutput(const WFC::Array2D<Pixel_t>& image)
+{
+    std::string text;
+    char numberStr[4];
+    for (int y = 0; y < image.GetHeight(); ++y)
+    {
+        for (int x = 0; x < image.GetWidth(); ++x)
+        {
+            Pixel_t pixel = image[WFC::Vector2i(x, y)];
+            auto numberEnd = std::to_chars(numberStr, numberStr + 4, (int)pixel).ptr;
+            text.append(numberStr, numberEnd);
+            text += ' ';
+
+            //Add padding spaces so that all the numbers line up.
+            if (pixel < 10)
+                text += "  ";
+            else if (pixel < 100)
+                text += ' ';
+        }
+
+        //Line break between rows.
+        text += '\n';
+    }
+
+    return text;
+}
+
+
+//Runs the algorithm once for each of the given seeds, spread across threads,
+//    and writes each finished output to its own numbered file.
+//Returns the number of outputs that failed.
+size_t RunBatch(const std::vector<size_t>& seeds, const CmdArgs& args,
+                const InputFile& inputData, const OutputFile& outData,
+                const std::vector<TileFile>& tiles, const EdgeData& tileset,
+                const WFCT::TilePermutator& algoTilePermutator, const WFCT::InputData& algoInput)
+{
+    Pixel_t maxVal = 0;
+    for (auto& tile : tiles)
+        for (auto tilePos : WFC::Region2i(tile.Pixels.GetDimensions()))
+            maxVal = std::max(maxVal, tile.Pixels[tilePos]);
+
+    WFC::Vector2i tileSize((int)inputData.Width, (int)inputData.Height);
+    auto bakedTiles = BakeTilePixels(algoTilePermutator, tiles, tileSize);
+
+    //Each thread takes the next output that nobody has started yet.
+    //Messages are saved up and printed in order at the end.
+    std::vector<std::string> logs(seeds.size());
+    std::atomic<size_t> nextOutputI = 0,
+                        nFailed = 0;
+    auto runOutputs = [&]()
+    {
+        for (size_t outputI = nextOutputI++; outputI < seeds.size(); outputI = nextOutputI++)
+        {
+            auto& log = logs[outputI];
+            log = "Output " + std::to_string(outputI) + " (seed " + std::to_string(seeds[outputI]) + "): ";
+
+            WFCT::State algoState(algoInput,
+                                  WFC::Vector2i((int)outData.Width, (int)outData.Height),
+                                  (unsigned int)seeds[outputI],
+                                  outData.PeriodicX, outData.PeriodicY,
+                                  outData.ClearSize);
+
+            //Apply any hard-coded output values.
+            auto placementFailed = std::find_if(outData.InitialPlacements.begin(), outData.InitialPlacements.end(),
+                [&](const OutputFile::Placements& placement)
+                {
+                    return !placement.Apply(algoTilePermutator, algoInput, tiles, tileset, algoState);
+                });
+            if (placementFailed != outData.InitialPlacements.end())
+            {
+                log += "Unable to find tile \"" + placementFailed->TileName + "\" with transform " +
+                       WFC::ToString(placementFailed->TilePermutation) + " to execute an Init command";
+                nFailed += 1;
+                continue;
+            }
+
+            //Run the algorithm.
+            std::optional<bool> isFinished;
+            std::vector<WFC::Vector2i> failedPoses;
+            size_t iterI = 0;
+            while (iterI < outData.NIterations && !isFinished.has_value())
+            {
+                isFinished = algoState.Iterate(failedPoses);
+                iterI += 1;
+            }
+            if (!isFinished.has_value())
+            {
+                log += "Ran out of iterations before finishing!";
+                nFailed += 1;
+                continue;
+            }
+            else if (!*isFinished)
+            {
+                log += "Failed at " + std::to_string(failedPoses.size()) + " positions";
+                nFailed += 1;
+                continue;
+            }
+
+            //Write the result.
+            auto image = RenderOutput(algoState, bakedTiles, tileSize, 1);
+            std::string outputBytes = EncodeOutput(image, maxVal, args);
+            fs::path outputPath = args.OutputDir / ("output_" + std::to_string(outputI) +
+                                                    (args.PgmMode ? ".pgm" : ".bin"));
+            std::ofstream outputFile(outputPath, std::ios::binary);
+            outputFile.write(outputBytes.data(), outputBytes.size());
+            if (!outputFile)
+            {
+                log += "I/O error writing " + outputPath.string();
+                nFailed += 1;
+                continue;
+            }
+
+            log += "Completed successfully in " + std::to_string(iterI) + " iterations; wrote " +
+                   outputPath.string();
+        }
+    };
+
+    size_t nThreads = (args.NThreads > 0) ? args.NThreads : std::thread::hardware_concurrency();
+    nThreads = std::clamp(nThreads, size_t{ 1 }, seeds.size());
+    std::vector<std::thread> threads;
+    for (size_t threadI = 1; threadI < nThreads; ++threadI)
+        threads.emplace_back(runOutputs);
+    runOutputs();
+    for (auto& thread : threads)
+        thread.join();
+
+    for (const auto& log : logs)
+        std::cerr << log << "\n";
+    return nFailed;
+}
+
+
 int main(int argc, char* argv[])
 {
     int errCode;
     std::string errMsg;
 
+    //The output is binary, so stop Windows from turning every '\n' byte into "\r\n".
+    #ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+    #endif
+
     #define CHECK_ERR { \
         if (errCode != 0) { \
             std::cerr << errMsg << "\n"; \
@@ -270,6 +527,20 @@ int main(int argc, char* argv[])
         return errCode;
     }
 
+    //In batch mode, generate every output from the data that was just loaded.
+    if (args.BatchSize > 0 || !args.Seeds.empty())
+    {
+        std::vector<size_t> seeds = args.Seeds;
+        for (size_t i = 0; seeds.size() < args.BatchSize; ++i)
+            seeds.push_back(outData.Seed + i);
+
+        std::cerr << "Generating " << seeds.size() << " outputs...\n";
+        size_t nFailed = RunBatch(seeds, args, inputData, outData, tiles, tileset,
+                                  algoTilePermutator, algoInput);
+        std::cerr << (seeds.size() - nFailed) << " of " << seeds.size() << " outputs succeeded\n";
+        return (nFailed == 0) ? 0 : 15;
+    }
+
     //Set up the WFC algorithm itself.
     WFCT::State algoState(algoInput,
                           WFC::Vector2i((int)outData.Width, (int)outData.Height),
@@ -314,68 +585,20 @@ int main(int argc, char* argv[])
     {
         std::cerr << "Completed successfully in " << iterI << " iterations! Writing result...\n";
 
-        //Output the results header.
-        if (args.PgmMode)
-        {
-            std::cout << "P2\n" << (outData.Width * inputData.Width) << " " <<
-                                   (outData.Height * inputData.Height) << "\n";
-
-            Pixel_t maxVal = 0;
-            for (auto& tile : tiles)
-                for (auto tilePos : WFC::Region2i(tile.Pixels.GetDimensions()))
-                    maxVal = std::max(maxVal, tile.Pixels[tilePos]);
-
-            std::cout << (int)maxVal << "\n\n";
-        }
-        else
-        {
-            std::cout << (unsigned char)1;
-        }
-
-        //Output the results data.
-        std::function<void(Pixel_t)> outputPixel;
-        if (args.PgmMode)
-            outputPixel = [](Pixel_t p) { std::cout << (int)p << ' '; };
-        else
-            outputPixel = [](Pixel_t p) { std::cout << p; };
-        for (int pY = 0; pY < algoState.Output.GetHeight() * inputData.Height; ++pY)
-        {
-            int tY = pY / (int)inputData.Height;
-            int tpY = pY % (int)inputData.Height;
+        Pixel_t maxVal = 0;
+        for (auto& tile : tiles)
+            for (auto tilePos : WFC::Region2i(tile.Pixels.GetDimensions()))
+                maxVal = std::max(maxVal, tile.Pixels[tilePos]);
 
-            for (int pX = 0; pX < algoState.Output.GetWidth() * inputData.Width; ++pX)
-            {
-                int tX = pX / (int)inputData.Width;
-                int tpX = pX % (int)inputData.Width;
-
-                //Get the pixel array of the original, un-transformed version of this tile.
-                auto tileID = *algoState.Output[WFC::Vector2i(tX, tY)].Value;
-                auto tileParentID = algoTilePermutator.GetTileRoot(tileID);
-                const auto& parentTile = tiles[tileParentID];
-                const auto& tilePixels = tiles[tileParentID].Pixels;
-
-                //Look up the correct pixel with the current transformed version.
-                auto transform = WFC::Invert(algoTilePermutator.GetMyPermutation(tileID));
-                auto pixel = tilePixels[WFC::Vector2i(tpX, tpY)
-                                            .Transform(transform,
-                                                       tilePixels.GetDimensions())];
-
-                //Output.
-                outputPixel(pixel);
-                std::cerr << (int)pixel << ' ';
-
-                //For the log, add padding spaces so that all the numbers line up.
-                if (pixel < 10)
-                    std::cerr << "  ";
-                else if (pixel < 100)
-                    std::cerr << ' ';
-            }
+        WFC::Vector2i tileSize((int)inputData.Width, (int)inputData.Height);
+        auto bakedTiles = BakeTilePixels(algoTilePermutator, tiles, tileSize);
+        auto image = RenderOutput(algoState, bakedTiles, tileSize,
+                                  (int)std::thread::hardware_concurrency());
 
-            //Line break between rows.
-            std::cerr << '\n';
-            if (args.PgmMode)
-                std::cout << '\n';
-        }
+        //Write everything at once.
+        std::string outputBytes = EncodeOutput(image, maxVal, args);
+        std::cout.write(outputBytes.data(), outputBytes.size());
+        std::cerr << PrintOutput(image);
 
         return 0;
     }
@@ -0,0 +1,664 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <unordered_map>
+#include <functional>
+#include <optional>
+
+#include <Tiled3D/StandardRunner.h>
+#include <Tiled3D/TilesetAnalysis.h>
+#include <Helpers/WFCppStreamPrinting.hpp>
+namespace WFCT3 = WFC::Tiled3D;
+
+
+//Runs the Tiled3D algorithm headlessly on a tileset described in a text file,
+//    for benchmarking and regression-testing tilesets outside of a game engine.
+//The resulting grid is sent to standard output (or to a file with "-out path").
+//Progress messages and a summary of stats are sent to standard error.
+
+//Command-line arguments:
+//  * "-tileset path": the tileset file (required; see below for its format).
+//  * "-size X Y Z": the size of the output grid. Defaults to 8x8x8.
+//  * "-periodic axes": the axes along which the output wraps around, e.x. "-periodic xz".
+//  * "-seed N": the PRNG seed. Defaults to 0.
+//  * "-batch N": run N times, counting the seed up from "-seed".
+//  * "-seeds A,B,C": run once for each of the given seeds. Overrides "-seed" and "-batch".
+//  * "-maxTicks N": give up on a run after N ticks.
+//        Defaults to 100 ticks per grid cell, so that a tileset which can't be solved doesn't run forever.
+//  * "-timeLimit S": give up on a run after S seconds (fractions are allowed).
+//  * "-noGrid": don't output the resulting grids, only the stats.
+//  * "-analyze": print an analysis of how the tileset's faces connect, then exit without running.
+//  * "-prune": print the analysis, then remove any tile permutations that can never be placed before running
+//        (see 'TilesetAnalysis' for details).
+//  * "-faceDomains": have the grid track the faces along each cell's sides instead of its tile permutations
+//        (see 'PropagationModes::Faces'), which is faster for tilesets with many tiles but few distinct faces.
+//The 'StandardRunner' can be tuned with the following arguments,
+//    each of which sets the field of the same name:
+//  * "-clearGrowth T" (ClearRegionGrowthRateT)
+//  * "-coolOff R" (CoolOffRate)
+//  * "-coolOffFromSetting R" (CoolOffFromSetting)
+//  * "-unwinding N" (InitialUnwindingCount)
+//  * "-maxUnwinding N" (MaxUnwindingCount)
+//  * "-weightTemperature W" (PriorityWeightTemperature)
+//  * "-weightEntropy W" (PriorityWeightEntropy)
+//  * "-weightRandomness W" (PriorityWeightRandomness)
+//  * "-entropy count|shannon" (EntropyHeuristic)
+//  * "-recovery heuristic|backjump" (RecoveryStrategy)
+//  * "-maxNogoodSize N" (MaxNogoodSize)
+//  * "-maxNogoodsPerCell N" (MaxNogoodsPerCell)
+
+//The tileset file is a list of tiles, each one starting with a "Tile:" line.
+//Lines starting with "//" are comments, and blank lines are ignored.
+/*
+    [File start on next line]
+Tile: Straight            <----- Starts a new tile, with the given name (no spaces).
+Weight: 100               <----- (optional) The tile's weight. Defaults to 100.
+Permutations: None AxisZ_90 Invert=>None
+                          <----- (optional) The allowed permutations, separated by spaces.
+                          <----- Each one is a rotation name from 'Rotations3D',
+                          <----- optionally prefixed with "Invert=>".
+                          <----- "All" means every permutation, "Rotations" means every un-inverted one.
+                          <----- Defaults to "None".
+MinX: 1 1 1 1 / 0 0 0 0   <----- The face's 4 corner IDs, then its 4 edge IDs ('FaceIdentifiers').
+MaxX: 1 1 1 1 / 0 0 0 0   <----- Points are in the order AA, AB, BA, BB.
+MinY: 2 2 2 2 / 0 0 0 0   <----- Faces that aren't given have all their IDs set to 0.
+MaxY: 2 2 2 2 / 0 0 0 0
+MinZ: 1 1 1 1 / 0 0 0 0
+MaxZ: 1 1 1 1 / 0 0 0 0
+    [File end on previous line]
+*/
+
+//The grid is output as one block per Z slice, starting with a line "Z = [z]".
+//Each row of a slice is one Y value, and each cell in the row is written
+//    as "[tile name]@[permutation]", or "-" if the cell wasn't set.
+//When running more than one seed, each grid is preceded by a line "Seed: [seed]".
+
+//Returns the following error codes:
+// 0: Success.
+// 1: Invalid command-line arguments.
+// 2: Unable to read the tileset file.
+// 3: Tileset file is badly formed.
+// 4: Unable to write the output file.
+// 5: At least one run didn't finish, because it hit the tick or time limit.
+
+
+//The default tick limit for one run, per cell in the grid.
+//A run that finishes normally takes a little more than one tick per cell.
+constexpr uint64_t DefaultMaxTicksPerCell = 100;
+
+struct CmdArgs
+{
+    std::string TilesetPath, OutputPath;
+    WFC::Vector3i GridSize{ 8, 8, 8 };
+    bool PeriodicX = false, PeriodicY = false, PeriodicZ = false;
+    std::vector<uint64_t> Seeds;
+    uint64_t MaxTicks = 0; //If not given, this is set from 'DefaultMaxTicksPerCell'.
+    double TimeLimitSeconds = -1;
+    bool WriteGrid = true;
+    bool AnalyzeOnly = false,
+         PruneTileset = false;
+    WFCT3::PropagationModes PropagationMode = WFCT3::PropagationModes::Permutations;
+
+    //The tuning parameters, applied to a default 'StandardRunner' after it's created.
+    std::vector<std::function<void(WFCT3::StandardRunner&)>> Tunings;
+};
+
+//Parses a number, which must take up the entire string.
+//Returns whether or not the parse succeeded.
+template<typename T>
+bool TryParseNumber(const std::string& str, T& outValue)
+{
+    auto result = std::from_chars(str.data(), str.data() + str.size(), outValue);
+    return result.ec == std::errc() && result.ptr == str.data() + str.size();
+}
+
+//Returns whether or not the arguments were valid.
+//If not, "outErrMsg" describes the problem.
+bool ParseCmdArgs(int argc, char* argv[], CmdArgs& outArgs, std::string& outErrMsg)
+{
+    uint64_t firstSeed = 0,
+             batchSize = 1;
+    std::optional<uint64_t> maxTicks;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        //Gets the next argument, or sets an error message if there isn't one.
+        auto nextArg = [&](std::string& outValue)
+        {
+            if (i >= argc - 1)
+            {
+                outErrMsg = "Missing value after " + arg;
+                return false;
+            }
+            outValue = argv[++i];
+            return true;
+        };
+        //Parses the next argument as a number.
+        auto nextNumber = [&](auto& outValue)
+        {
+            std::string str;
+            if (!nextArg(str))
+                return false;
+            if (!TryParseNumber(str, outValue))
+            {
+                outErrMsg = "Invalid value for " + arg + ": \"" + str + "\"";
+                return false;
+            }
+            return true;
+        };
+        //Parses the next argument as a number, and applies it to a 'StandardRunner' field.
+        auto nextTuning = [&]<typename T>(T WFCT3::StandardRunner::* field)
+        {
+            T value;
+            if (!nextNumber(value))
+                return false;
+            outArgs.Tunings.push_back([field, value](WFCT3::StandardRunner& runner) { runner.*field = value; });
+            return true;
+        };
+
+        bool success;
+        std::string str;
+        if (arg == "-tileset")
+            success = nextArg(outArgs.TilesetPath);
+        else if (arg == "-out")
+            success = nextArg(outArgs.OutputPath);
+        else if (arg == "-size")
+            success = nextNumber(outArgs.GridSize.x) && nextNumber(outArgs.GridSize.y) && nextNumber(outArgs.GridSize.z);
+        else if (arg == "-periodic")
+        {
+            success = nextArg(str);
+            for (char c : str)
+            {
+                switch (std::tolower(c))
+                {
+                    case 'x': outArgs.PeriodicX = true; break;
+                    case 'y': outArgs.PeriodicY = true; break;
+                    case 'z': outArgs.PeriodicZ = true; break;
+                    default:
+                        outErrMsg = "Invalid axes for -periodic: \"" + str + "\"";
+                        success = false;
+                        break;
+                }
+            }
+        }
+        else if (arg == "-seed")
+            success = nextNumber(firstSeed);
+        else if (arg == "-batch")
+            success = nextNumber(batchSize);
+        else if (arg == "-seeds")
+        {
+            success = nextArg(str);
+            std::stringstream seedsStream(str);
+            std::string seedStr;
+            while (success && std::getline(seedsStream, seedStr, ','))
+            {
+                uint64_t seed;
+                success = TryParseNumber(seedStr, seed);
+                if (success)
+                    outArgs.Seeds.push_back(seed);
+                else
+                    outErrMsg = "Invalid seed: \"" + seedStr + "\"";
+            }
+        }
+        else if (arg == "-maxTicks")
+            success = nextNumber(maxTicks.emplace());
+        else if (arg == "-timeLimit")
+            success = nextNumber(outArgs.TimeLimitSeconds);
+        else if (arg == "-noGrid")
+        {
+            outArgs.WriteGrid = false;
+            success = true;
+        }
+        else if (arg == "-analyze")
+        {
+            outArgs.AnalyzeOnly = true;
+            success = true;
+        }
+        else if (arg == "-prune")
+        {
+            outArgs.PruneTileset = true;
+            success = true;
+        }
+        else if (arg == "-faceDomains")
+        {
+            outArgs.PropagationMode = WFCT3::PropagationModes::Faces;
+            success = true;
+        }
+        else if (arg == "-clearGrowth")
+            success = nextTuning(&WFCT3::StandardRunner::ClearRegionGrowthRateT);
+        else if (arg == "-coolOff")
+            success = nextTuning(&WFCT3::StandardRunner::CoolOffRate);
+        else if (arg == "-coolOffFromSetting")
+            success = nextTuning(&WFCT3::StandardRunner::CoolOffFromSetting);
+        else if (arg == "-unwinding")
+            success = nextTuning(&WFCT3::StandardRunner::InitialUnwindingCount);
+        else if (arg == "-maxUnwinding")
+            success = nextTuning(&WFCT3::StandardRunner::MaxUnwindingCount);
+        else if (arg == "-weightTemperature")
+            success = nextTuning(&WFCT3::StandardRunner::PriorityWeightTemperature);
+        else if (arg == "-weightEntropy")
+            success = nextTuning(&WFCT3::StandardRunner::PriorityWeightEntropy);
+        else if (arg == "-weightRandomness")
+            success = nextTuning(&WFCT3::StandardRunner::PriorityWeightRandomness);
+        else if (arg == "-entropy")
+        {
+            success = nextArg(str) && (str == "count" || str == "shannon");
+            auto heuristic = (str == "count") ?
+                                 WFCT3::EntropyHeuristics::PossibilityCount :
+                                 WFCT3::EntropyHeuristics::WeightedShannon;
+            if (success)
+                outArgs.Tunings.push_back([heuristic](WFCT3::StandardRunner& runner) { runner.EntropyHeuristic = heuristic; });
+        }
+        else if (arg == "-recovery")
+        {
+            success = nextArg(str) && (str == "heuristic" || str == "backjump");
+            auto strategy = (str == "heuristic") ?
+                                WFCT3::RecoveryStrategies::Heuristic :
+                                WFCT3::RecoveryStrategies::Backjumping;
+            if (success)
+                outArgs.Tunings.push_back([strategy](WFCT3::StandardRunner& runner) { runner.RecoveryStrategy = strategy; });
+        }
+        else if (arg == "-maxNogoodSize")
+            success = nextTuning(&WFCT3::StandardRunner::MaxNogoodSize);
+        else if (arg == "-maxNogoodsPerCell")
+            success = nextTuning(&WFCT3::StandardRunner::MaxNogoodsPerCell);
+        else
+        {
+            outErrMsg = "Unknown argument \"" + arg + "\"";
+            return false;
+        }
+
+        if (!success)
+        {
+            if (outErrMsg.empty())
+                outErrMsg = "Invalid value for " + arg;
+            return false;
+        }
+    }
+
+    if (outArgs.TilesetPath.empty())
+    {
+        outErrMsg = "No tileset given (use -tileset path)";
+        return false;
+    }
+    if (outArgs.GridSize.x < 1 || outArgs.GridSize.y < 1 || outArgs.GridSize.z < 1)
+    {
+        outErrMsg = "Grid size must be at least 1 along each axis";
+        return false;
+    }
+
+    if (outArgs.Seeds.empty())
+        for (uint64_t i = 0; i < batchSize; ++i)
+            outArgs.Seeds.push_back(firstSeed + i);
+
+    outArgs.MaxTicks = maxTicks.value_or(DefaultMaxTicksPerCell *
+                                         static_cast<uint64_t>(outArgs.GridSize.x) *
+                                         static_cast<uint64_t>(outArgs.GridSize.y) *
+                                         static_cast<uint64_t>(outArgs.GridSize.z));
+
+    return true;
+}
+
+
+//Gets the name of a transform, as printed by 'WFCppStreamPrinting.hpp'.
+std::string ToString(WFCT3::Transform3D tr)
+{
+    std::stringstream str;
+    str << tr;
+    return str.str();
+}
+
+//Parses a tileset file (see the top of this file).
+//Returns whether or not the parse succeeded.
+//If not, "outErrMsg" describes the problem.
+bool TryParseTileset(std::istream& file,
+                     std::vector<WFCT3::Tile>& outTiles, std::vector<std::string>& outNames,
+                     std::string& outErrMsg)
+{
+    //Look up each transform by its printed name.
+    std::unordered_map<std::string, WFCT3::Transform3D> transformsByName;
+    for (auto tr : WFCT3::TransformSet::All())
+        transformsByName[ToString(tr)] = tr;
+
+    const std::unordered_map<std::string, WFCT3::Directions3D> facesByName = {
+        { "MinX", WFCT3::MinX }, { "MaxX", WFCT3::MaxX },
+        { "MinY", WFCT3::MinY }, { "MaxY", WFCT3::MaxY },
+        { "MinZ", WFCT3::MinZ }, { "MaxZ", WFCT3::MaxZ }
+    };
+
+    std::string line;
+    int lineI = 0;
+    while (std::getline(file, line))
+    {
+        lineI += 1;
+        auto fail = [&](const std::string& msg)
+        {
+            outErrMsg = "Line " + std::to_string(lineI) + ": " + msg;
+            return false;
+        };
+
+        //Skip blank lines and comments.
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        auto firstChar = line.find_first_not_of(" \t");
+        if (firstChar == std::string::npos || line.compare(firstChar, 2, "//") == 0)
+            continue;
+
+        //Split the line into a field name and its values.
+        auto colonI = line.find(':');
+        if (colonI == std::string::npos)
+            return fail("Expected \"[field]: [value]\"");
+        std::string field = line.substr(firstChar, colonI - firstChar);
+        field.erase(field.find_last_not_of(" \t") + 1);
+        std::stringstream values(line.substr(colonI + 1));
+
+        if (field == "Tile")
+        {
+            outTiles.emplace_back();
+            outNames.emplace_back();
+            if (!(values >> outNames.back()))
+                return fail("Tile needs a name");
+            continue;
+        }
+        if (outTiles.empty())
+            return fail("Expected a \"Tile:\" line before any tile data");
+        auto& tile = outTiles.back();
+
+        if (field == "Weight")
+        {
+            if (!(values >> tile.Weight))
+                return fail("Weight must be a non-negative integer");
+        }
+        else if (field == "Permutations")
+        {
+            tile.Permutations.Clear();
+            std::string name;
+            while (values >> name)
+            {
+                if (name == "All")
+                {
+                    tile.Permutations = WFCT3::TransformSet::All();
+                }
+                else if (name == "Rotations")
+                {
+                    for (int rotI = 0; rotI < WFCT3::N_ROTATIONS_3D; ++rotI)
+                        tile.Permutations.Add(WFCT3::Transform3D{ false, (WFCT3::Rotations3D)rotI });
+                }
+                else
+                {
+                    auto found = transformsByName.find(name);
+                    if (found == transformsByName.end())
+                        return fail("Unknown permutation \"" + name + "\"");
+                    tile.Permutations.Add(found->second);
+                }
+            }
+        }
+        else if (facesByName.contains(field))
+        {
+            auto dir = facesByName.at(field);
+            auto& face = tile.Data.Faces[dir];
+            face.Side = dir;
+
+            std::string separator;
+            bool success = true;
+            for (auto& corner : face.Points.Corners)
+                success = success && (values >> corner);
+            success = success && (values >> separator) && separator == "/";
+            for (auto& edge : face.Points.Edges)
+                success = success && (values >> edge);
+            if (!success)
+                return fail("Face should be 4 corner IDs, a '/', then 4 edge IDs");
+        }
+        else
+        {
+            return fail("Unknown field \"" + field + "\"");
+        }
+
+        //Nothing should be left over on the line.
+        std::string leftover;
+        if (values >> leftover)
+            return fail("Unexpected \"" + leftover + "\"");
+    }
+
+    if (outTiles.empty())
+    {
+        outErrMsg = "No tiles were defined";
+        return false;
+    }
+    for (size_t tileI = 0; tileI < outTiles.size(); ++tileI)
+    {
+        if (outTiles[tileI].Permutations.Size() == 0)
+        {
+            outErrMsg = "Tile \"" + outNames[tileI] + "\" has no permutations";
+            return false;
+        }
+    }
+    if (outTiles.size() >= WFCT3::TileIdx_INVALID)
+    {
+        outErrMsg = "Too many tiles";
+        return false;
+    }
+
+    return true;
+}
+
+
+//Writes a summary of the tileset analysis.
+void PrintAnalysis(const WFCT3::TilesetAnalysis& analysis, const std::vector<std::string>& tileNames,
+                   std::ostream& output)
+{
+    output << "Tileset analysis:\n" <<
+              "  " << analysis.NFaces << " distinct faces, " <<
+                  analysis.NUnmatchedFaces << " of which nothing can sit against\n" <<
+              "  " << analysis.NDeadPermutations << " dead permutations found in " <<
+                  analysis.NPruningRounds << " rounds, killing " << analysis.NDeadTiles << " tiles entirely\n";
+    for (size_t tileI = 0; tileI < tileNames.size(); ++tileI)
+    {
+        if (analysis.DeadPermutations[tileI].Size() == 0)
+            continue;
+        output << "    " << tileNames[tileI] << ":";
+        for (auto permutation : analysis.DeadPermutations[tileI])
+            output << ' ' << permutation;
+        output << "\n";
+    }
+    output << "  Neighbor options per face: min " << analysis.MinNeighborOptions <<
+                  ", average " << analysis.AverageNeighborOptions <<
+                  ", max " << analysis.MaxNeighborOptions << "\n" <<
+              "  Fewest neighbor options per tile:\n";
+    for (size_t tileI = 0; tileI < tileNames.size(); ++tileI)
+        output << "    " << tileNames[tileI] << ": " << analysis.MinNeighborOptionsPerTile[tileI] << "\n";
+}
+
+
+//The outcome of one run of the algorithm.
+struct RunStats
+{
+    bool Finished = false,
+         HitTickLimit = false;
+    uint64_t NTicks = 0,
+             NCellsSet = 0,
+             NFailedCells = 0,
+             NClears = 0,
+             NUndos = 0;
+    double Seconds = 0;
+
+    void Add(const RunStats& stats)
+    {
+        NTicks += stats.NTicks;
+        NCellsSet += stats.NCellsSet;
+        NFailedCells += stats.NFailedCells;
+        NClears += stats.NClears;
+        NUndos += stats.NUndos;
+        Seconds += stats.Seconds;
+    }
+
+    std::string ToString() const
+    {
+        std::stringstream str;
+        str << NTicks << " ticks, " << NCellsSet << " cells set, " <<
+               NFailedCells << " failed cells, " << NClears << " clears, " <<
+               NUndos << " undos, " << (Seconds * 1000.0) << "ms";
+        return str.str();
+    }
+};
+
+//Ticks the runner until it finishes or hits one of the limits, and counts what it did.
+RunStats Run(WFCT3::StandardRunner& runner, const CmdArgs& args)
+{
+    using Clock = std::chrono::steady_clock;
+    auto startTime = Clock::now();
+    auto deadline = (args.TimeLimitSeconds > 0) ?
+                        (startTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(args.TimeLimitSeconds))) :
+                        Clock::time_point::max();
+
+    RunStats stats;
+    while (!stats.Finished && stats.NTicks < args.MaxTicks && Clock::now() < deadline)
+    {
+        stats.Finished = runner.Tick();
+        stats.NTicks += 1;
+
+        if (std::holds_alternative<WFCT3::StandardRunnerAction_SetCell>(runner.LastAction))
+            stats.NCellsSet += 1;
+        else if (std::holds_alternative<WFCT3::StandardRunnerAction_FailedOnCell>(runner.LastAction))
+            stats.NFailedCells += 1;
+        else if (std::holds_alternative<WFCT3::StandardRunnerAction_ClearCells>(runner.LastAction))
+            stats.NClears += 1;
+        else if (std::holds_alternative<WFCT3::StandardRunnerAction_UndoCells>(runner.LastAction))
+            stats.NUndos += 1;
+    }
+
+    stats.Seconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+    stats.HitTickLimit = !stats.Finished && (stats.NTicks >= args.MaxTicks);
+    return stats;
+}
+
+//Writes the grid's cells as text (see the top of this file).
+void PrintGrid(const WFCT3::Grid& grid, const std::vector<std::string>& tileNames, std::ostream& output)
+{
+    const auto& cells = grid.Cells;
+    for (int z = 0; z < cells.GetDepth(); ++z)
+    {
+        output << "Z = " << z << "\n";
+        for (int y = 0; y < cells.GetHeight(); ++y)
+        {
+            for (int x = 0; x < cells.GetWidth(); ++x)
+            {
+                const auto& cell = cells[{ x, y, z }];
+                if (x > 0)
+                    output << ' ';
+                if (cell.IsSet())
+                    output << tileNames[cell.ChosenTile] << '@' << cell.ChosenPermutation;
+                else
+                    output << '-';
+            }
+            output << "\n";
+        }
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    CmdArgs args;
+    std::string errMsg;
+    if (!ParseCmdArgs(argc, argv, args, errMsg))
+    {
+        std::cerr << errMsg << "\n";
+        return 1;
+    }
+
+    //Read the tileset.
+    std::vector<WFCT3::Tile> tiles;
+    std::vector<std::string> tileNames;
+    {
+        std::ifstream tilesetFile(args.TilesetPath);
+        if (!tilesetFile)
+        {
+            std::cerr << "Unable to read \"" << args.TilesetPath << "\"\n";
+            return 2;
+        }
+        if (!TryParseTileset(tilesetFile, tiles, tileNames, errMsg))
+        {
+            std::cerr << "Error in \"" << args.TilesetPath << "\": " << errMsg << "\n";
+            return 3;
+        }
+    }
+    std::cerr << "Read " << tiles.size() << " tiles from \"" << args.TilesetPath << "\"\n";
+
+    //Analyze the tileset, and optionally prune it.
+    if (args.AnalyzeOnly || args.PruneTileset)
+    {
+        WFCT3::TilesetAnalysis analysis(tiles);
+        PrintAnalysis(analysis, tileNames, std::cerr);
+        if (args.AnalyzeOnly)
+            return 0;
+
+        if (analysis.NDeadTiles == static_cast<int>(tiles.size()))
+        {
+            std::cerr << "Error in \"" << args.TilesetPath << "\": every tile permutation is dead\n";
+            return 3;
+        }
+        analysis.Prune(tiles);
+    }
+
+    //Set up the output.
+    std::ofstream outputFile;
+    std::ostream* output = &std::cout;
+    if (!args.OutputPath.empty())
+    {
+        outputFile.open(args.OutputPath);
+        if (!outputFile)
+        {
+            std::cerr << "Unable to open \"" << args.OutputPath << "\" for writing\n";
+            return 4;
+        }
+        output = &outputFile;
+    }
+
+    //Run the algorithm once per seed.
+    RunStats totalStats;
+    size_t nUnfinished = 0;
+    for (uint64_t seed : args.Seeds)
+    {
+        WFCT3::StandardRunner runner(tiles, args.GridSize,
+                                     args.PeriodicX, args.PeriodicY, args.PeriodicZ,
+                                     WFC::PRNG{ seed }, WFC::ArrayLayouts::RowMajor,
+                                     args.PropagationMode);
+        for (const auto& tuning : args.Tunings)
+            tuning(runner);
+
+        auto stats = Run(runner, args);
+        totalStats.Add(stats);
+        nUnfinished += stats.Finished ? 0 : 1;
+
+        std::cerr << "Seed " << seed << ": " <<
+                     (stats.Finished ? "finished" :
+                        (stats.HitTickLimit ? "DID NOT FINISH (hit the tick limit)" :
+                                              "DID NOT FINISH (hit the time limit)")) <<
+                     "; " << stats.ToString() << "\n";
+
+        if (args.WriteGrid)
+        {
+            if (args.Seeds.size() > 1)
+                *output << "Seed: " << seed << "\n";
+            PrintGrid(runner.Grid, tileNames, *output);
+        }
+    }
+
+    std::cerr << "\nFinished " << (args.Seeds.size() - nUnfinished) << "/" << args.Seeds.size() <<
+                 " runs; total " << totalStats.ToString() << "\n";
+
+    output->flush();
+    if (!*output)
+    {
+        std::cerr << "I/O error writing the output\n";
+        return 4;
+    }
+
+    return (nUnfinished > 0) ? 5 : 0;
+}